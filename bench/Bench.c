@@ -0,0 +1,510 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
+#include "Decompose.h"
+#include "Library.h"
+#include "File.h"
+#include "Batch.h"
+#include "Recompose/Recompose.h"
+
+// Runs of every phase over the corpus that are thrown away, to fill the caches and the heap first.
+#ifndef BENCH_WARM_UP
+#define BENCH_WARM_UP 1
+#endif
+
+// Timed runs of every phase, the fastest is reported: noise only ever makes a run slower.
+#ifndef BENCH_REPETITIONS
+#define BENCH_REPETITIONS 5
+#endif
+
+// Seconds a timed run lasts at least, a run goes over the corpus as many times as it takes so that small corpora still
+// give stable rates.
+#ifndef BENCH_RUN_SECONDS
+#define BENCH_RUN_SECONDS 0.25
+#endif
+
+#define BENCH_PHASES 4
+
+typedef struct {
+    char *         input;
+    char *         tokenFile;
+    char *         recomposed;
+    char *         roundTrip;
+    size_t         size;
+    size_t         tokenCount;
+    bool           decomposed;
+    tokenList_t    tokens;        // Of the last decompose phase, for the export phase
+    symbolTable_t  symbolTable;
+} benchFile_t;
+
+typedef struct {
+    benchFile_t *  files;
+    size_t         count;
+    size_t         capacity;
+    uint64_t       bytes;
+    uint64_t       tokens;
+} corpus_t;
+
+typedef struct {
+    const char *  name;
+    void          ( *run )( benchFile_t * file );
+    double        seconds;     // Of the fastest repetition
+    double        spread;      // Median repetition over the fastest
+} phase_t;
+
+static tokenFileOptions_t  fileOptions = { .revision = 2, .threads = 1 };
+
+double Seconds() {
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+char * FormatPath( const char * format, const char * directory, size_t index ) {
+    char * path = malloc( strlen( directory ) + 32 );
+
+    if ( path == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    sprintf( path, format, directory, index );
+
+    return path;
+}
+
+void AddFile( corpus_t * corpus, char * input, lexerContext_t * context, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= AddFile
+=
+= Adds a source file to the corpus if it lexes without errors, every phase stops at the first error. Its tokens are
+= counted here, outside of the timed runs.
+=
+====================
+*/
+
+    size_t        length;
+    char *        source = ReadBinaryFile( input, &length );
+    benchFile_t   file = { 0 };
+
+    if ( LexBuffer( context, source, length, false, false, diagnostics ) != LEXER_SUCCESS ) {
+        PrintDiagnostics( stderr, input, diagnostics );
+        fprintf( stderr, "%s: Left out of the corpus.\n", input );
+        free( source );
+        return;
+    }
+
+    for ( size_t position = 0; position < context->tokens.size; position += TokenWords( &( context->tokens ), position ) ) {
+        file.tokenCount++;
+    }
+
+    free( source );
+
+    if ( ( file.input = malloc( strlen( input ) + 1 ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    strcpy( file.input, input );
+    file.size = length;
+
+    if ( corpus->count == corpus->capacity ) {
+        corpus->capacity = corpus->capacity == 0 ? 256 : corpus->capacity * 2;
+
+        if ( ( corpus->files = realloc( corpus->files, corpus->capacity * sizeof( benchFile_t ) ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    corpus->files[ corpus->count++ ] = file;
+    corpus->bytes += file.size;
+    corpus->tokens += file.tokenCount;
+}
+
+void AddPath( corpus_t * corpus, char * path, lexerContext_t * context, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= AddPath
+=
+= Adds a source file to the corpus, or every .c and .h file under a directory.
+=
+====================
+*/
+
+    struct stat      status;
+    DIR *            stream;
+    struct dirent *  entry;
+    char *           child;
+    size_t           length;
+
+    if ( stat( path, &status ) == -1 ) {
+        perror( path );
+        exit( 1 );
+    }
+
+    if ( !S_ISDIR( status.st_mode ) ) {
+        AddFile( corpus, path, context, diagnostics );
+        return;
+    }
+
+    if ( ( stream = opendir( path ) ) == NULL ) {
+        perror( path );
+        exit( 1 );
+    }
+
+    while ( ( entry = readdir( stream ) ) != NULL ) {
+        length = strlen( entry->d_name );
+
+        if ( entry->d_name[ 0 ] == '.' ) {
+            continue;
+        }
+
+        if ( ( child = malloc( strlen( path ) + length + 2 ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+
+        sprintf( child, "%s/%s", path, entry->d_name );
+
+        if ( stat( child, &status ) == 0 && ( S_ISDIR( status.st_mode ) || ( length > 2 && entry->d_name[ length - 2 ] == '.' && ( entry->d_name[ length - 1 ] == 'c' || entry->d_name[ length - 1 ] == 'h' ) ) ) ) {
+            AddPath( corpus, child, context, diagnostics );
+        }
+
+        free( child );
+    }
+
+    closedir( stream );
+}
+
+int CompareFiles( const void * a, const void * b ) {
+    return strcmp( ( ( const benchFile_t * )a )->input, ( ( const benchFile_t * )b )->input );
+}
+
+int CompareSeconds( const void * a, const void * b ) {
+    double first = *( const double * )a;
+    double second = *( const double * )b;
+
+    return ( first > second ) - ( first < second );
+}
+
+void DecomposePhase( benchFile_t * file ) {
+    if ( file->decomposed ) {
+        DestroySymbolTable( file->symbolTable );
+        DestroyTokenList( file->tokens );
+    }
+
+    Decompose( file->input, false, &( file->tokens ), &( file->symbolTable ) );
+    file->decomposed = true;
+}
+
+void ExportPhase( benchFile_t * file ) {
+    ExportTokenFile( file->tokenFile, &( file->tokens ), &( file->symbolTable ), &fileOptions );
+}
+
+void RecomposePhase( benchFile_t * file ) {
+    RecomposeFromFile( file->tokenFile, file->recomposed, false, 1, &fileOptions );
+}
+
+void RoundTripPhase( benchFile_t * file ) {
+/*
+====================
+=
+= RoundTripPhase
+=
+= Decomposes a file and recomposes it straight from memory, as -rt does.
+=
+====================
+*/
+
+    tokenList_t    tokens;
+    symbolTable_t  symbolTable;
+
+    Decompose( file->input, false, &tokens, &symbolTable );
+    RecomposeWithSymbols( &tokens, &symbolTable, file->roundTrip );
+
+    DestroySymbolTable( symbolTable );
+    DestroyTokenList( tokens );
+}
+
+void RunPhases( corpus_t * corpus, phase_t * phases ) {
+/*
+====================
+=
+= RunPhases
+=
+= Runs every phase over the whole corpus, BENCH_WARM_UP times untimed and then BENCH_REPETITIONS times timed. The
+= phases run in order in every repetition, each works on what the one before it left. A timed run goes over the
+= corpus until BENCH_RUN_SECONDS have passed and counts the time of one pass.
+=
+====================
+*/
+
+    double  seconds[ BENCH_PHASES ][ BENCH_REPETITIONS ];
+    double  start;
+    double  elapsed;
+    int     passes;
+
+    for ( int run = -BENCH_WARM_UP; run < BENCH_REPETITIONS; run++ ) {
+        for ( int phase = 0; phase < BENCH_PHASES; phase++ ) {
+            start = Seconds();
+            passes = 0;
+
+            do {
+                for ( size_t i = 0; i < corpus->count; i++ ) {
+                    phases[ phase ].run( &( corpus->files[ i ] ) );
+                }
+
+                passes++;
+                elapsed = Seconds() - start;
+            } while ( run >= 0 && elapsed < BENCH_RUN_SECONDS );
+
+            if ( run >= 0 ) {
+                seconds[ phase ][ run ] = elapsed / passes;
+            }
+        }
+    }
+
+    for ( int phase = 0; phase < BENCH_PHASES; phase++ ) {
+        qsort( seconds[ phase ], BENCH_REPETITIONS, sizeof( double ), CompareSeconds );
+
+        phases[ phase ].seconds = seconds[ phase ][ 0 ];
+        phases[ phase ].spread = seconds[ phase ][ BENCH_REPETITIONS / 2 ] / seconds[ phase ][ 0 ];
+    }
+}
+
+bool SameFiles( char * first, char * second ) {
+    size_t  firstLength;
+    size_t  secondLength;
+    char *  firstData = ReadBinaryFile( first, &firstLength );
+    char *  secondData = ReadBinaryFile( second, &secondLength );
+    bool    same = firstLength == secondLength && !memcmp( firstData, secondData, firstLength );
+
+    free( firstData );
+    free( secondData );
+
+    return same;
+}
+
+void WriteResults( char * filename, corpus_t * corpus, phase_t * phases ) {
+/*
+====================
+=
+= WriteResults
+=
+= Writes the results as tab separated values, one phase per line after a header, for later runs to compare against.
+= The rates are of the corpus: its source bytes and its tokens over the time the phase took on all of it.
+=
+====================
+*/
+
+    FILE * file = fopen( filename, "w" );
+
+    if ( file == NULL ) {
+        perror( filename );
+        exit( 1 );
+    }
+
+    fputs( "phase\tfiles\tbytes\ttokens\tseconds\tMB/s\ttokens/s\tns/token\n", file );
+
+    for ( int phase = 0; phase < BENCH_PHASES; phase++ ) {
+        fprintf( file, "%s\t%zu\t%" PRIu64 "\t%" PRIu64 "\t%.6f\t%.3f\t%.0f\t%.3f\n", phases[ phase ].name, corpus->count, corpus->bytes, corpus->tokens,
+                 phases[ phase ].seconds, corpus->bytes / phases[ phase ].seconds / 1e6, corpus->tokens / phases[ phase ].seconds, phases[ phase ].seconds * 1e9 / corpus->tokens );
+    }
+
+    fclose( file );
+}
+
+int CompareBaseline( char * filename, double threshold, corpus_t * corpus, phase_t * phases ) {
+/*
+====================
+=
+= CompareBaseline
+=
+= Compares the tokens per second of every phase to a baseline written by WriteResults, and returns the number of
+= phases that got slower by more than threshold percent. A missing baseline or phase is only reported.
+=
+====================
+*/
+
+    FILE *    file = fopen( filename, "r" );
+    char      line[ 256 ];
+    char      name[ 32 ];
+    uint64_t  bytes = 0;
+    double    rate;
+    double    baseline[ BENCH_PHASES ] = { 0 };
+    double    change;
+    int       regressions = 0;
+
+    if ( file == NULL ) {
+        printf( "\nNo baseline at %s, make bench-baseline stores these results as one.\n", filename );
+        return 0;
+    }
+
+    while ( fgets( line, sizeof( line ), file ) != NULL ) {
+        if ( sscanf( line, "%31s %*s %" SCNu64 " %*s %*s %*s %lf", name, &bytes, &rate ) != 3 ) {
+            continue;
+        }
+
+        for ( int phase = 0; phase < BENCH_PHASES; phase++ ) {
+            if ( !strcmp( name, phases[ phase ].name ) ) {
+                baseline[ phase ] = rate;
+            }
+        }
+
+    }
+
+    fclose( file );
+
+    if ( bytes != corpus->bytes ) {
+        printf( "\nThe baseline was taken on a different corpus (%" PRIu64 " bytes), the rates may not compare.\n", bytes );
+    }
+
+    printf( "\n%-10s %14s %14s %9s\n", "phase", "baseline", "tokens/s", "change" );
+
+    for ( int phase = 0; phase < BENCH_PHASES; phase++ ) {
+        rate = corpus->tokens / phases[ phase ].seconds;
+
+        if ( baseline[ phase ] <= 0 ) {
+            printf( "%-10s %14s %14.0f\n", phases[ phase ].name, "-", rate );
+            continue;
+        }
+
+        change = ( rate / baseline[ phase ] - 1 ) * 100;
+
+        printf( "%-10s %14.0f %14.0f %+8.1f%%%s\n", phases[ phase ].name, baseline[ phase ], rate, change, change < -threshold ? "  REGRESSION" : "" );
+
+        regressions += change < -threshold;
+    }
+
+    return regressions;
+}
+
+int main( int argc, char * argv[] ) {
+/*
+====================
+=
+= main
+=
+= Benchmarks the decompose, export, recompose and round trip phases over a corpus of source files and directories:
+=
+=   bench [-o results.tsv] [-baseline baseline.tsv] [-threshold percent] [-work directory] [-rev revision] paths...
+=
+= Prints the MB/s, tokens/s and ns/token of every phase, writes them to the results file and fails if a phase got
+= slower than the baseline by more than the threshold, 10% by default.
+=
+====================
+*/
+
+    corpus_t          corpus = { NULL, 0, 0, 0, 0 };
+    lexerContext_t    context = InitializeLexerContext();
+    diagnosticList_t  diagnostics = InitializeDiagnosticList();
+    char *            results = "bench.tsv";
+    char *            baseline = NULL;
+    char *            work = "bench-work";
+    double            threshold = 10;
+    int               regressions = 0;
+    phase_t           phases[ BENCH_PHASES ] = {
+        { "decompose", DecomposePhase, 0, 0 },
+        { "export", ExportPhase, 0, 0 },
+        { "recompose", RecomposePhase, 0, 0 },
+        { "roundtrip", RoundTripPhase, 0, 0 },
+    };
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( !strcmp( argv[ i ], "-o" ) && i + 1 < argc ) {
+            results = argv[ ++i ];
+        } else if ( !strcmp( argv[ i ], "-baseline" ) && i + 1 < argc ) {
+            baseline = argv[ ++i ];
+        } else if ( !strcmp( argv[ i ], "-threshold" ) && i + 1 < argc ) {
+            threshold = strtod( argv[ ++i ], NULL );
+        } else if ( !strcmp( argv[ i ], "-work" ) && i + 1 < argc ) {
+            work = argv[ ++i ];
+        } else if ( !strcmp( argv[ i ], "-rev" ) && i + 1 < argc ) {
+            fileOptions.revision = strtol( argv[ ++i ], NULL, 10 );
+        } else {
+            AddPath( &corpus, argv[ i ], &context, &diagnostics );
+        }
+    }
+
+    DestroyDiagnosticList( diagnostics );
+    DestroyLexerContext( &context );
+
+    if ( corpus.count == 0 || corpus.tokens == 0 ) {
+        fputs( "The corpus is empty, give source files or directories to benchmark on.\n", stderr );
+        return 1;
+    }
+
+    // Sorted so that the order, and the heap it leaves, never depends on the file system.
+    qsort( corpus.files, corpus.count, sizeof( benchFile_t ), CompareFiles );
+
+    for ( size_t i = 0; i < corpus.count; i++ ) {
+        corpus.files[ i ].tokenFile = FormatPath( "%s/%zu.tok", work, i );
+        corpus.files[ i ].recomposed = FormatPath( "%s/%zu.c", work, i );
+        corpus.files[ i ].roundTrip = FormatPath( "%s/%zu.rt.c", work, i );
+    }
+
+    MakeParentDirectories( corpus.files[ 0 ].tokenFile );
+
+    RunPhases( &corpus, phases );
+
+    printf( "%zu files, %.3f MB, %" PRIu64 " tokens, fastest of %d runs after %d warm-up\n\n", corpus.count, corpus.bytes / 1e6, corpus.tokens, BENCH_REPETITIONS, BENCH_WARM_UP );
+    printf( "%-10s %10s %10s %14s %10s %8s\n", "phase", "seconds", "MB/s", "tokens/s", "ns/token", "spread" );
+
+    for ( int phase = 0; phase < BENCH_PHASES; phase++ ) {
+        printf( "%-10s %10.4f %10.2f %14.0f %10.2f %7.1f%%\n", phases[ phase ].name, phases[ phase ].seconds, corpus.bytes / phases[ phase ].seconds / 1e6,
+                corpus.tokens / phases[ phase ].seconds, phases[ phase ].seconds * 1e9 / corpus.tokens, ( phases[ phase ].spread - 1 ) * 100 );
+    }
+
+    // Both recomposed the same tokens, a difference is a bug and not a slowdown.
+    for ( size_t i = 0; i < corpus.count; i++ ) {
+        if ( !SameFiles( corpus.files[ i ].recomposed, corpus.files[ i ].roundTrip ) ) {
+            fprintf( stderr, "%s: The recompose and round trip phases disagree.\n", corpus.files[ i ].input );
+            return 1;
+        }
+    }
+
+    WriteResults( results, &corpus, phases );
+
+    if ( baseline != NULL ) {
+        regressions = CompareBaseline( baseline, threshold, &corpus, phases );
+    }
+
+    for ( size_t i = 0; i < corpus.count; i++ ) {
+        remove( corpus.files[ i ].tokenFile );
+        remove( corpus.files[ i ].recomposed );
+        remove( corpus.files[ i ].roundTrip );
+
+        free( corpus.files[ i ].input );
+        free( corpus.files[ i ].tokenFile );
+        free( corpus.files[ i ].recomposed );
+        free( corpus.files[ i ].roundTrip );
+
+        DestroySymbolTable( corpus.files[ i ].symbolTable );
+        DestroyTokenList( corpus.files[ i ].tokens );
+    }
+
+    free( corpus.files );
+
+    if ( regressions > 0 ) {
+        fprintf( stderr, "\n%d phases got slower than the baseline by more than %.1f%%.\n", regressions, threshold );
+        return 1;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,622 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
+#include "Decompose.h"
+#include "TokenCache.h"
+#include "Ring.h"
+#include "Batch.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define MakeDirectory( path ) _mkdir( path )
+#else
+#include <unistd.h>
+#define MakeDirectory( path ) mkdir( path, 0777 )
+#endif
+
+typedef struct {
+    char *  input;
+    char *  output;
+    long    size;
+    char    key[ TOKEN_CACHE_KEY_SIZE ];
+} batchJob_t;
+
+typedef struct {
+    batchJob_t **    jobs;
+    size_t           first;
+    size_t           last;
+    pthread_mutex_t  lock;
+} jobQueue_t;
+
+typedef struct {
+    jobQueue_t *         queues;
+    int                  queueCount;
+    int                  index;
+    bool                 punchCardExtension;
+    bool                 recover;
+    tokenFileOptions_t * options;
+    tokenCache_t *       cache;
+    size_t               failures;
+} batchWorker_t;
+
+typedef struct {
+    batchJob_t *  jobs;
+    size_t        count;
+    size_t        capacity;
+} jobList_t;
+
+// Files a pipeline stage may run ahead of the next one.
+#define PIPELINE_DEPTH 2
+
+// Files in a pipeline at once: one in each stage and the rings between them full.
+#define PIPELINE_FILES ( 2 * PIPELINE_DEPTH + 3 )
+
+typedef struct {
+    batchJob_t *      job;
+    char *            source;
+    int               length;
+    lexerContext_t    context;
+    lexerStatus_t     status;
+    diagnosticList_t  diagnostics;
+} pipelineFile_t;
+
+typedef struct {
+    batchWorker_t *  worker;
+    ring_t           free;
+    ring_t           read;
+    ring_t           lexed;
+} pipeline_t;
+
+void PushJob( jobList_t * list, char * input, char * outputDirectory, char * relativePath ) {
+/*
+====================
+=
+= PushJob
+=
+= Adds a file to the batch, its output goes to outputDirectory/relativePath.tok.
+=
+====================
+*/
+
+    struct stat  status;
+    batchJob_t   job;
+    char *       character;
+
+    if ( stat( input, &status ) == -1 ) {
+        perror( input );
+        exit( 1 );
+    }
+
+    if ( ( job.input = malloc( strlen( input ) + 1 ) ) == NULL || ( job.output = malloc( strlen( outputDirectory ) + strlen( relativePath ) + 6 ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    strcpy( job.input, input );
+    sprintf( job.output, "%s/%s.tok", outputDirectory, relativePath );
+    job.size = status.st_size;
+
+    // Keep the outputs inside the output directory.
+    for ( character = job.output + strlen( outputDirectory ) + 1; *character != '\0'; character++ ) {
+        if ( character[ 0 ] == '.' && character[ 1 ] == '.' && ( character[ 2 ] == '/' || character[ 2 ] == '\\' ) ) {
+            character[ 0 ] = character[ 1 ] = '_';
+        }
+    }
+
+    if ( list->count == list->capacity ) {
+        list->capacity = list->capacity == 0 ? 256 : list->capacity * 2;
+
+        if ( ( list->jobs = realloc( list->jobs, list->capacity * sizeof( batchJob_t ) ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    list->jobs[ list->count++ ] = job;
+}
+
+void CollectDirectory( jobList_t * list, char * directory, char * outputDirectory, size_t rootLength ) {
+/*
+====================
+=
+= CollectDirectory
+=
+= Adds every .c and .h file under directory to the batch, recursively.
+=
+====================
+*/
+
+    DIR *            stream = opendir( directory );
+    struct dirent *  entry;
+    struct stat      status;
+    char *           path;
+    size_t           length;
+
+    if ( stream == NULL ) {
+        perror( directory );
+        exit( 1 );
+    }
+
+    while ( ( entry = readdir( stream ) ) != NULL ) {
+        if ( !strcmp( entry->d_name, "." ) || !strcmp( entry->d_name, ".." ) ) {
+            continue;
+        }
+
+        if ( ( path = malloc( strlen( directory ) + strlen( entry->d_name ) + 2 ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+
+        sprintf( path, "%s/%s", directory, entry->d_name );
+        length = strlen( entry->d_name );
+
+        if ( stat( path, &status ) == 0 ) {
+            if ( S_ISDIR( status.st_mode ) ) {
+                CollectDirectory( list, path, outputDirectory, rootLength );
+            } else if ( length > 2 && entry->d_name[ length - 2 ] == '.' && ( entry->d_name[ length - 1 ] == 'c' || entry->d_name[ length - 1 ] == 'h' ) ) {
+                PushJob( list, path, outputDirectory, path + rootLength + 1 );
+            }
+        }
+
+        free( path );
+    }
+
+    closedir( stream );
+}
+
+void CollectFileList( jobList_t * list, char * filename, char * outputDirectory ) {
+/*
+====================
+=
+= CollectFileList
+=
+= Adds the files listed in a text file, one path per line, to the batch.
+=
+====================
+*/
+
+    FILE *  file = fopen( filename, "r" );
+    char    line[ 4096 ];
+    char *  path;
+
+    if ( file == NULL ) {
+        perror( filename );
+        exit( 1 );
+    }
+
+    while ( fgets( line, sizeof( line ), file ) != NULL ) {
+        line[ strcspn( line, "\r\n" ) ] = '\0';
+
+        if ( line[ 0 ] == '\0' ) {
+            continue;
+        }
+
+        // Absolute paths are placed relative to the output directory.
+        for ( path = line; *path == '/' || *path == '\\'; path++ );
+
+        PushJob( list, line, outputDirectory, path );
+    }
+
+    fclose( file );
+}
+
+void MakeParentDirectories( char * path ) {
+/*
+====================
+=
+= MakeParentDirectories
+=
+= Creates every missing directory on the way to path.
+=
+====================
+*/
+
+    for ( char * separator = path + 1; *separator != '\0'; separator++ ) {
+        if ( *separator == '/' || *separator == '\\' ) {
+            char saved = *separator;
+
+            *separator = '\0';
+
+            if ( MakeDirectory( path ) == -1 && errno != EEXIST ) {
+                perror( path );
+                exit( 1 );
+            }
+
+            *separator = saved;
+        }
+    }
+}
+
+int CompareJobs( const void * a, const void * b ) {
+    const batchJob_t *  jobA = a;
+    const batchJob_t *  jobB = b;
+
+    // Largest first, then by name so that the order never depends on the file system.
+    if ( jobA->size != jobB->size ) {
+        return jobA->size < jobB->size ? 1 : -1;
+    }
+
+    return strcmp( jobA->input, jobB->input );
+}
+
+void PublishJob( batchWorker_t * worker, batchJob_t * job, lexerStatus_t status ) {
+/*
+====================
+=
+= PublishJob
+=
+= Adds the token file of a job to the token cache of the batch, if it has one. Files with errors are left out, so that
+= their diagnostics are printed again the next time.
+=
+====================
+*/
+
+    if ( worker->cache != NULL && status == LEXER_SUCCESS ) {
+        PublishTokenFile( worker->cache, job->key, job->output );
+    }
+}
+
+batchJob_t * TakeJob( batchWorker_t * worker ) {
+/*
+====================
+=
+= TakeJob
+=
+= Takes the next job of a worker: the largest job left in its own queue or, once it is empty, the largest job left in
+= the queue of another worker.
+=
+= Returns NULL when every queue is empty.
+=
+====================
+*/
+
+    batchJob_t *  job = NULL;
+
+    for ( int i = 0; i < worker->queueCount && job == NULL; i++ ) {
+        jobQueue_t * queue = &( worker->queues[ ( worker->index + i ) % worker->queueCount ] );
+
+        pthread_mutex_lock( &( queue->lock ) );
+
+        if ( queue->first < queue->last ) {
+            job = queue->jobs[ queue->first++ ];
+        }
+
+        pthread_mutex_unlock( &( queue->lock ) );
+    }
+
+    return job;
+}
+
+void * BatchWorker( void * argument ) {
+/*
+====================
+=
+= BatchWorker
+=
+= Decomposes and exports the jobs of a batch until none are left.
+=
+====================
+*/
+
+    batchWorker_t *   worker = argument;
+    batchJob_t *      job;
+    lexerContext_t    context = InitializeLexerContext();
+    diagnosticList_t  diagnostics = InitializeDiagnosticList();
+    lexerStatus_t     status;
+
+    // The context is reused for every job, most jobs are small and would otherwise be dominated by its setup.
+    while ( ( job = TakeJob( worker ) ) != NULL ) {
+        // A file that was decomposed before with the same options is only hashed.
+        if ( worker->cache != NULL && FetchTokenFile( worker->cache, job->input, job->output, worker->punchCardExtension, worker->recover, worker->options, job->key ) ) {
+            continue;
+        }
+
+        // Streams are lexed as they are written, so they can't recover from errors.
+        if ( worker->options->revision == 3 && !worker->recover ) {
+            DecomposeToStream( job->input, job->output, worker->punchCardExtension, worker->options );
+            PublishJob( worker, job, LEXER_SUCCESS );
+            continue;
+        }
+
+        status = DecomposeInto( &context, job->input, worker->punchCardExtension, worker->recover ? &diagnostics : NULL );
+
+        if ( status != LEXER_SUCCESS ) {
+            PrintDiagnostics( stderr, job->input, &diagnostics );
+            worker->failures++;
+        }
+
+        // A file that could not be lexed to the end is left out.
+        if ( status != LEXER_ERROR ) {
+            ExportTokenFile( job->output, &( context.tokens ), &( context.symbolTable ), worker->options );
+            PublishJob( worker, job, status );
+        }
+    }
+
+    DestroyDiagnosticList( diagnostics );
+    DestroyLexerContext( &context );
+
+    return NULL;
+}
+
+void * ReadStage( void * argument ) {
+/*
+====================
+=
+= ReadStage
+=
+= First stage of a pipeline: reads the sources of the jobs of its worker and does the translation phases 1 and 2 on
+= them, in the files given back by the last stage. A NULL item ends the pipeline.
+=
+====================
+*/
+
+    pipeline_t *      pipeline = argument;
+    batchJob_t *      job;
+    pipelineFile_t *  file;
+
+    while ( ( job = TakeJob( pipeline->worker ) ) != NULL ) {
+        if ( pipeline->worker->cache != NULL && FetchTokenFile( pipeline->worker->cache, job->input, job->output, pipeline->worker->punchCardExtension, pipeline->worker->recover, pipeline->worker->options, job->key ) ) {
+            continue;
+        }
+
+        file = PopRing( &( pipeline->free ) );
+        file->job = job;
+        file->source = ReadSource( job->input, pipeline->worker->punchCardExtension, &( file->length ) );
+
+        PushRing( &( pipeline->read ), file );
+    }
+
+    PushRing( &( pipeline->read ), NULL );
+
+    return NULL;
+}
+
+void * LexStage( void * argument ) {
+/*
+====================
+=
+= LexStage
+=
+= Second stage of a pipeline: lexes the sources read by the first stage.
+=
+====================
+*/
+
+    pipeline_t *      pipeline = argument;
+    pipelineFile_t *  file;
+
+    while ( ( file = PopRing( &( pipeline->read ) ) ) != NULL ) {
+        ResetLexerContext( &( file->context ) );
+
+        if ( pipeline->worker->recover ) {
+            file->status = LexTrapped( file->source, file->length, &( file->context.tokens ), &( file->context.symbolTable ), true, &( file->diagnostics ) );
+        } else {
+            LexInto( file->source, file->length, &( file->context.tokens ), &( file->context.symbolTable ) );
+        }
+
+        free( file->source );
+
+        PushRing( &( pipeline->lexed ), file );
+    }
+
+    PushRing( &( pipeline->lexed ), NULL );
+
+    return NULL;
+}
+
+void * PipelineWorker( void * argument ) {
+/*
+====================
+=
+= PipelineWorker
+=
+= Decomposes and exports the jobs of a batch in a pipeline of three threads: one reads the next files, one lexes the
+= current file and this one exports the previous files. The stages are joined by rings of PIPELINE_DEPTH files, so a
+= stage that gets ahead waits for the next one and the pipeline runs at the speed of its slowest stage.
+=
+= The PIPELINE_FILES files go around the pipeline and back to the first stage, each keeping its lexer context.
+=
+====================
+*/
+
+    pipeline_t        pipeline;
+    pthread_t         readThread;
+    pthread_t         lexThread;
+    pipelineFile_t    files[ PIPELINE_FILES ];
+    pipelineFile_t *  file;
+
+    pipeline.worker = argument;
+    InitializeRing( &( pipeline.free ), PIPELINE_FILES );
+    InitializeRing( &( pipeline.read ), PIPELINE_DEPTH );
+    InitializeRing( &( pipeline.lexed ), PIPELINE_DEPTH );
+
+    for ( int i = 0; i < PIPELINE_FILES; i++ ) {
+        files[ i ].context = InitializeLexerContext();
+        files[ i ].status = LEXER_SUCCESS;
+        files[ i ].diagnostics = InitializeDiagnosticList();
+        PushRing( &( pipeline.free ), &files[ i ] );
+    }
+
+    if ( pthread_create( &readThread, NULL, ReadStage, &pipeline ) != 0 || pthread_create( &lexThread, NULL, LexStage, &pipeline ) != 0 ) {
+        fputs( "Could not start a thread.\n", stderr );
+        exit( 1 );
+    }
+
+    // Export stage
+    while ( ( file = PopRing( &( pipeline.lexed ) ) ) != NULL ) {
+        if ( file->status != LEXER_SUCCESS ) {
+            PrintDiagnostics( stderr, file->job->input, &( file->diagnostics ) );
+            pipeline.worker->failures++;
+        }
+
+        if ( file->status != LEXER_ERROR ) {
+            ExportTokenFile( file->job->output, &( file->context.tokens ), &( file->context.symbolTable ), pipeline.worker->options );
+            PublishJob( pipeline.worker, file->job, file->status );
+        }
+
+        PushRing( &( pipeline.free ), file );
+    }
+
+    pthread_join( readThread, NULL );
+    pthread_join( lexThread, NULL );
+
+    for ( int i = 0; i < PIPELINE_FILES; i++ ) {
+        DestroyLexerContext( &( files[ i ].context ) );
+        DestroyDiagnosticList( files[ i ].diagnostics );
+    }
+
+    DestroyRing( &( pipeline.free ) );
+    DestroyRing( &( pipeline.read ) );
+    DestroyRing( &( pipeline.lexed ) );
+
+    return NULL;
+}
+
+int ThreadCount() {
+/*
+====================
+=
+= ThreadCount
+=
+= Returns the number of processors available, for the default number of threads.
+=
+====================
+*/
+
+#ifdef _SC_NPROCESSORS_ONLN
+    long count = sysconf( _SC_NPROCESSORS_ONLN );
+
+    return count > 0 ? count : 1;
+#else
+    return 1;
+#endif
+}
+
+size_t DecomposeBatch( char * input, char * outputDirectory, int threads, bool pipeline, bool punchCardExtension, bool recover, tokenFileOptions_t * options, tokenCache_t * cache ) {
+/*
+====================
+=
+= DecomposeBatch
+=
+= Decomposes every .c and .h file under the input directory, or every file listed in the input text file, into a token
+= file under outputDirectory, on threads threads.
+=
+= The files are sorted largest first and dealt to the threads' queues in turn, a thread whose queue runs out takes the
+= largest jobs left in the others. Every output only depends on its input, so the results never depend on the order
+= the jobs run in.
+=
+= With pipeline set every queue is worked by a pipeline of three threads, see PipelineWorker, so there are a third as
+= many queues as threads.
+=
+= With recover set a file with errors doesn't stop the batch: its diagnostics are printed, the bad input is kept in error
+= tokens and the file is exported anyway, unless it could not be lexed to the end. Returns the number of files that had
+= errors.
+=
+= With a cache, which may be NULL, the files that were decomposed before with the same options are copied from it and
+= the others are added to it.
+=
+====================
+*/
+
+    jobList_t           list = { NULL, 0, 0 };
+    tokenFileOptions_t  fileOptions = *options;
+    struct stat         status;
+    jobQueue_t *        queues;
+    batchWorker_t *     workers;
+    pthread_t *         threadIds;
+    size_t              failures = 0;
+
+    if ( stat( input, &status ) == -1 ) {
+        perror( input );
+        exit( 1 );
+    }
+
+    if ( S_ISDIR( status.st_mode ) ) {
+        CollectDirectory( &list, input, outputDirectory, strlen( input ) );
+    } else {
+        CollectFileList( &list, input, outputDirectory );
+    }
+
+    qsort( list.jobs, list.count, sizeof( batchJob_t ), CompareJobs );
+
+    // The files themselves are the unit of work, each is exported on a single thread.
+    fileOptions.threads = 1;
+
+    // The directories are made up front, the threads only write files.
+    for ( size_t i = 0; i < list.count; i++ ) {
+        MakeParentDirectories( list.jobs[ i ].output );
+    }
+
+    if ( pipeline ) {
+        threads /= 3;
+    }
+
+    if ( threads < 1 ) {
+        threads = 1;
+    }
+
+    if ( ( queues = malloc( threads * sizeof( jobQueue_t ) ) ) == NULL
+      || ( workers = malloc( threads * sizeof( batchWorker_t ) ) ) == NULL
+      || ( threadIds = malloc( threads * sizeof( pthread_t ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    // Deal the jobs in turn, so that every queue starts with its share of the large files.
+    for ( int i = 0; i < threads; i++ ) {
+        if ( ( queues[ i ].jobs = malloc( ( list.count / threads + 1 ) * sizeof( batchJob_t * ) ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+
+        queues[ i ].first = 0;
+        queues[ i ].last = 0;
+        pthread_mutex_init( &( queues[ i ].lock ), NULL );
+    }
+
+    for ( size_t i = 0; i < list.count; i++ ) {
+        jobQueue_t * queue = &queues[ i % threads ];
+
+        queue->jobs[ queue->last++ ] = &( list.jobs[ i ] );
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        workers[ i ] = ( batchWorker_t ){ queues, threads, i, punchCardExtension, recover, &fileOptions, cache, 0 };
+
+        if ( pthread_create( &threadIds[ i ], NULL, pipeline ? PipelineWorker : BatchWorker, &workers[ i ] ) != 0 ) {
+            fputs( "Could not start a thread.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        pthread_join( threadIds[ i ], NULL );
+        failures += workers[ i ].failures;
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        pthread_mutex_destroy( &( queues[ i ].lock ) );
+        free( queues[ i ].jobs );
+    }
+
+    for ( size_t i = 0; i < list.count; i++ ) {
+        free( list.jobs[ i ].input );
+        free( list.jobs[ i ].output );
+    }
+
+    free( list.jobs );
+    free( queues );
+    free( workers );
+    free( threadIds );
+
+    return failures;
+}
\ No newline at end of file
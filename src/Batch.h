@@ -0,0 +1,10 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <stdbool.h>
+#include "TokenFile.h"
+#include "TokenCache.h"
+
+int ThreadCount();
+void MakeParentDirectories( char * path );
+size_t DecomposeBatch( char * input, char * outputDirectory, int threads, bool pipeline, bool punchCardExtension, bool recover, tokenFileOptions_t * options, tokenCache_t * cache );
+#endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include "TokenList.h"
+#include "Diagnostic.h"
 
 char * HandleUTF8Character( char * string, uint32_t * character ) {
 /*
@@ -182,8 +183,10 @@ char * HandleCharacterConstant( char * string, token_t * character ) {
                 return end;
                 break;
             default:
-                fprintf( stderr, "Unsupported escape sequence: \"\\%c\".", *( character + 1 ) );
-                exit( 1 );
+                RaiseError( string, UNSUPPORTED_ESCAPE_ERROR, "Unsupported escape sequence: \"\\%c\".", *( string + 1 ) );
+                *character = *( string + 1 );
+
+                return string + 2;
         }
     // Simple character
     } else {
@@ -204,6 +207,8 @@ char * HandleStringLiteral( char * string, int * length, tokenList_t * tokens )
 = Escape sequences are not resolved as they are supposed to be resolved in translation phase 5 and lexical analysis is
 = translation phase 3.
 =
+= An unterminated string literal ends with the source, at the NUL after it, instead of running past the buffer.
+=
 ====================
 */
     static_assert( sizeof( char ) == 1, "A char is not a byte." );
@@ -211,7 +216,7 @@ char * HandleStringLiteral( char * string, int * length, tokenList_t * tokens )
 
     *length = 0;
     
-    while ( *string != '\"' || *( string - 1 ) == '\\' ) {
+    while ( ( *string != '\"' || *( string - 1 ) == '\\' ) && *string != '\0' ) {
         string = HandleCharacterConstant( string, &character );
         PushToken( tokens, character );
         
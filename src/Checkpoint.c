@@ -0,0 +1,474 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "File.h"
+#include "TokenFile.h"
+#include "OutputBuffer.h"
+#include "HandleCharacters.h"
+#include "Decompose.h"
+#include "TokenCache.h"
+#include "Checkpoint.h"
+
+size_t PrepareSource( char * copy, const char * source, size_t length, bool punchCardExtension ) {
+/*
+====================
+=
+= PrepareSource
+=
+= Copies length bytes of a source file as it is on disk into copy, which must hold length + CHUNK_SLACK bytes, and does
+= the translation phases 1 and 2 on the copy like ReadSource.
+=
+= Returns the length of the copy after them.
+=
+====================
+*/
+
+    int size = length;
+
+    memcpy( copy, source, length );
+    memset( copy + length, 0, CHUNK_SLACK );
+
+    if ( punchCardExtension ) {
+        RemoveDel( copy, &size );
+    }
+
+    RemoveBackslashNewline( copy, &size );
+
+    return size;
+}
+
+uint64_t CountLines( const char * slice, const char * end ) {
+/*
+====================
+=
+= CountLines
+=
+= Returns the number of newlines between slice and end.
+=
+====================
+*/
+
+    uint64_t lines = 0;
+
+    while ( slice < end && ( slice = memchr( slice, '\n', end - slice ) ) != NULL ) {
+        lines++;
+        slice++;
+    }
+
+    return lines;
+}
+
+const char * SkipSourceLines( const char * slice, const char * end, uint64_t lines ) {
+/*
+====================
+=
+= SkipSourceLines
+=
+= Returns the position after the lines-th newline from slice, or end if there are not that many lines left.
+=
+====================
+*/
+
+    for ( ; lines > 0 && slice < end; lines-- ) {
+        if ( ( slice = memchr( slice, '\n', end - slice ) ) == NULL ) {
+            return end;
+        }
+
+        slice++;
+    }
+
+    return slice;
+}
+
+const char * NextLineSplit( const char * source, const char * slice, const char * end, bool punchCardExtension ) {
+/*
+====================
+=
+= NextLineSplit
+=
+= Returns the position after the first newline from slice that the translation phase 2 leaves in place, or end if
+= there is none. The source can be split there and both sides put through the phases 1 and 2 on their own.
+=
+====================
+*/
+
+    const char * before;
+
+    while ( slice < end && ( slice = memchr( slice, '\n', end - slice ) ) != NULL ) {
+        // The DEL characters between a backslash and a newline are gone by the phase 2 with the punch card extension.
+        for ( before = slice; punchCardExtension && before > source && before[ -1 ] == 0x7F; before-- );
+
+        if ( before == source || before[ -1 ] != '\\' ) {
+            return slice + 1;
+        }
+
+        slice++;
+    }
+
+    return end;
+}
+
+checkpointIndex_t ScanCheckpoints( const char * source, size_t length, bool punchCardExtension ) {
+/*
+====================
+=
+= ScanCheckpoints
+=
+= Takes a checkpoint of the lexer at the start of a line every CHECKPOINT_INTERVAL bytes of a source file as it is on
+= disk: where the line is and whether the lexer is inside a block comment there.
+=
+= Every stretch between two checkpoints is put through the phases 1 and 2 on its own and run through ScanChunk from the
+= state of the first one, which is much cheaper than lexing it. A stretch ScanChunk can't follow (a string literal that
+= goes on past a newline) makes its checkpoint and all the ones after it UNKNOWN_STATE, they can't be lexed from. The
+= first checkpoint is always at the start of the file. Like Decompose the scan stops at the first NUL.
+=
+====================
+*/
+
+    checkpointIndex_t  index = { NULL, 0, length, 0, punchCardExtension };
+    checkpoint_t       checkpoint = { 0, 1, NORMAL_STATE };
+    const char *       slice = source;
+    const char *       end = memchr( source, '\0', length );
+    const char *       next;
+    char *             copy = NULL;
+    size_t             copyCapacity = 0;
+    size_t             size;
+
+    if ( end == NULL ) {
+        end = source + length;
+    }
+
+    // Every stretch but the last is at least CHECKPOINT_INTERVAL bytes long.
+    if ( ( index.checkpoints = malloc( ( length / CHECKPOINT_INTERVAL + 1 ) * sizeof( checkpoint_t ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    while ( true ) {
+        index.checkpoints[ index.count++ ] = checkpoint;
+
+        if ( end - slice <= CHECKPOINT_INTERVAL || ( next = NextLineSplit( source, slice + CHECKPOINT_INTERVAL, end, punchCardExtension ) ) == end ) {
+            break;
+        }
+
+        if ( checkpoint.state != UNKNOWN_STATE ) {
+            if ( ( size_t )( next - slice ) + CHUNK_SLACK > copyCapacity ) {
+                copyCapacity = ( next - slice ) + CHUNK_SLACK;
+
+                if ( ( copy = realloc( copy, copyCapacity ) ) == NULL ) {
+                    fputs( "Out of memory.\n", stderr );
+                    exit( 1 );
+                }
+            }
+
+            size = PrepareSource( copy, slice, next - slice, punchCardExtension );
+            checkpoint.state = ScanChunk( copy, copy + size, checkpoint.state );
+        }
+
+        checkpoint.line += CountLines( slice, next );
+        checkpoint.offset = next - source;
+        slice = next;
+    }
+
+    free( copy );
+
+    return index;
+}
+
+void EncodeCheckpoints( checkpointIndex_t * index, outputBuffer_t * output ) {
+/*
+====================
+=
+= EncodeCheckpoints
+=
+= Appends the checkpoints of index to output, as the entry DecodeCheckpoints reads.
+=
+====================
+*/
+
+    char signature[ 9 ];
+
+    snprintf( signature, sizeof( signature ), "%%CKP-%03d", CHECKPOINT_FILE_REVISION );
+
+    PushBytes( output, signature, 8 );
+    PushVarint( output, index->length );
+    PushVarint( output, index->hash );
+    PushVarint( output, index->punchCardExtension );
+    PushVarint( output, index->count );
+
+    for ( size_t i = 1; i < index->count; i++ ) {
+        PushVarint( output, index->checkpoints[ i ].offset - index->checkpoints[ i - 1 ].offset );
+        PushVarint( output, index->checkpoints[ i ].line - index->checkpoints[ i - 1 ].line );
+        PushVarint( output, index->checkpoints[ i ].state );
+    }
+}
+
+bool DecodeCheckpoints( const uint8_t * data, size_t size, checkpointIndex_t * index ) {
+/*
+====================
+=
+= DecodeCheckpoints
+=
+= Reads size bytes of checkpoints written by EncodeCheckpoints into index, which must be destroyed with
+= DestroyCheckpoints.
+=
+= Returns false, with nothing to destroy, if they are not valid checkpoints. It is up to the caller to check that the
+= checkpoints belong to its version of the source file.
+=
+====================
+*/
+
+    const uint8_t *  position = data + 8;
+    const uint8_t *  end = data + size;
+    char             signature[ 9 ];
+    uint64_t         values[ 4 ] = { 0 };
+    uint64_t         deltas[ 3 ];
+    checkpoint_t     checkpoint = { 0, 1, NORMAL_STATE };
+    bool             valid;
+
+    snprintf( signature, sizeof( signature ), "%%CKP-%03d", CHECKPOINT_FILE_REVISION );
+
+    valid = size > 8 && !memcmp( data, signature, 8 );
+
+    // Length and hash of the source file, punch card extension and checkpoint count
+    for ( int i = 0; i < 4 && valid; i++ ) {
+        valid = ReadVarint( &position, end, &values[ i ] );
+    }
+
+    // The first checkpoint is the start of the file, every other one takes at least 3 bytes.
+    valid = valid && values[ 3 ] > 0 && values[ 3 ] - 1 <= ( uint64_t )( end - position ) / 3;
+
+    if ( !valid || ( index->checkpoints = malloc( values[ 3 ] * sizeof( checkpoint_t ) ) ) == NULL ) {
+        return false;
+    }
+
+    index->count = 0;
+    index->length = values[ 0 ];
+    index->hash = values[ 1 ];
+    index->punchCardExtension = values[ 2 ] != 0;
+
+    // Offsets and lines after the first checkpoint are deltas from the one before, and always grow.
+    while ( valid && index->count < values[ 3 ] ) {
+        if ( index->count > 0 ) {
+            for ( int i = 0; i < 3 && valid; i++ ) {
+                valid = ReadVarint( &position, end, &deltas[ i ] );
+            }
+
+            valid = valid && deltas[ 0 ] > 0 && deltas[ 1 ] > 0 && deltas[ 0 ] <= index->length - checkpoint.offset && deltas[ 2 ] <= ( uint64_t )UNKNOWN_STATE;
+
+            checkpoint.offset += deltas[ 0 ];
+            checkpoint.line += deltas[ 1 ];
+            checkpoint.state = deltas[ 2 ];
+        }
+
+        index->checkpoints[ index->count++ ] = checkpoint;
+    }
+
+    if ( !valid ) {
+        DestroyCheckpoints( index );
+    }
+
+    return valid;
+}
+
+checkpointIndex_t OpenCheckpoints( tokenCache_t * cache, const char * source, size_t length, bool punchCardExtension ) {
+/*
+====================
+=
+= OpenCheckpoints
+=
+= Returns the checkpoints of a source file of length bytes mapped at source. Without a cache they are taken by
+= ScanCheckpoints. With one they are looked up in it by the HashContent of the file, so they are never taken on another
+= version of it, and they are added to it on a miss for the next time.
+=
+====================
+*/
+
+    char               name[ TOKEN_CACHE_KEY_SIZE ];
+    uint64_t           hash;
+    uint8_t *          entry;
+    size_t             entryLength;
+    bool               hit = false;
+    checkpointIndex_t  index;
+    outputBuffer_t     output;
+
+    if ( cache == NULL ) {
+        return ScanCheckpoints( source, length, punchCardExtension );
+    }
+
+    hash = HashContent( source, length );
+    snprintf( name, sizeof( name ), "%016" PRIx64 "-%" PRIx64 "-p%d" CHECKPOINT_EXTENSION, hash, ( uint64_t )length, punchCardExtension );
+
+    if ( ( entry = ( uint8_t * )MapCacheEntry( cache, name, &entryLength ) ) != NULL ) {
+        hit = DecodeCheckpoints( entry, entryLength, &index );
+        UnmapFile( entry, entryLength );
+
+        if ( hit && ( index.length != length || index.hash != hash || index.punchCardExtension != punchCardExtension ) ) {
+            DestroyCheckpoints( &index );
+            hit = false;
+        }
+    }
+
+    if ( !hit ) {
+        index = ScanCheckpoints( source, length, punchCardExtension );
+        index.hash = hash;
+
+        // The checkpoints are only a cache, they are taken again if they could not be added.
+        output = InitializeOutputBuffer( NULL );
+        EncodeCheckpoints( &index, &output );
+        PublishCacheEntry( cache, name, output.data, output.size );
+        DestroyOutputBuffer( &output );
+    }
+
+    return index;
+}
+
+void LexLines( const char * source, size_t length, checkpointIndex_t * index, size_t firstLine, size_t lastLine, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= LexLines
+=
+= Lexes lines firstLine to lastLine of a source file as it is on disk, appending the tokens of every lexeme that ends
+= past the start of firstLine and starts before the end of lastLine to tokens and symbolTable, which must be initialized.
+= A lexeme that goes on past lastLine is cut there.
+=
+= Lexing starts from the last checkpoint of index at or before firstLine that is not in UNKNOWN_STATE, so only up to
+= about CHECKPOINT_INTERVAL bytes before the lines are lexed, into a throwaway list and table, whatever the size of the
+= file.
+=
+====================
+*/
+
+    size_t         low = 0;
+    size_t         high = index->count;
+    checkpoint_t   checkpoint;
+    const char *   start;
+    const char *   first;
+    const char *   last;
+    const char *   nul;
+    char *         copy;
+    char *         slice;
+    char *         boundary;
+    char *         stop;
+    char *         next;
+    tokenList_t    skipped = InitializeTokenList();
+    symbolTable_t  skippedSymbols = InitializeSymbolTable();
+
+    // Last checkpoint at or before the first line, the first checkpoint is always usable.
+    while ( high - low > 1 ) {
+        size_t middle = ( low + high ) / 2;
+
+        if ( index->checkpoints[ middle ].line <= firstLine ) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    while ( low > 0 && index->checkpoints[ low ].state == UNKNOWN_STATE ) {
+        low--;
+    }
+
+    checkpoint = index->checkpoints[ low ];
+    start = source + ( checkpoint.offset < length ? checkpoint.offset : length );
+    first = SkipSourceLines( start, source + length, firstLine - checkpoint.line );
+    last = SkipSourceLines( first, source + length, lastLine - firstLine + 1 );
+
+    // Like Decompose, stop at the first NUL.
+    if ( ( nul = memchr( start, '\0', last - start ) ) != NULL ) {
+        last = nul;
+        first = first < nul ? first : nul;
+    }
+
+    if ( ( copy = malloc( ( last - start ) + CHUNK_SLACK ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    // The lines before firstLine and the requested ones are split at a newline, so they go through the phases 1 and 2
+    // on their own and where the requested lines start in the copy is known.
+    boundary = copy + PrepareSource( copy, start, first - start, index->punchCardExtension );
+    stop = boundary + PrepareSource( boundary, first, last - first, index->punchCardExtension );
+
+    slice = copy;
+
+    // The comment the checkpoint is in was opened before it, its space is pushed if it goes on into the lines.
+    if ( checkpoint.state == COMMENT_STATE ) {
+        if ( ( slice = SkipBlockComment( copy, stop ) ) == NULL ) {
+            slice = stop;
+        }
+
+        if ( slice > boundary ) {
+            PushToken( tokens, ' ' );
+        }
+    }
+
+    while ( slice < boundary && *slice != '\0' ) {
+        next = characterFunctions[ ( unsigned char ) ( *slice ) ]( slice, &skipped, &skippedSymbols );
+
+        // A lexeme that goes on into the lines is lexed again into them.
+        if ( next > boundary ) {
+            next = characterFunctions[ ( unsigned char ) ( *slice ) ]( slice, tokens, symbolTable );
+        }
+
+        skipped.size = 0;
+        slice = next;
+    }
+
+    while ( *slice != '\0' ) {
+        slice = characterFunctions[ ( unsigned char ) ( *slice ) ]( slice, tokens, symbolTable );
+    }
+
+    DestroySymbolTable( skippedSymbols );
+    DestroyTokenList( skipped );
+    free( copy );
+}
+
+void DecomposeLines( char * inputFilename, bool punchCardExtension, size_t firstLine, size_t lastLine, tokenCache_t * cache, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= DecomposeLines
+=
+= Decomposes lines firstLine to lastLine of a C source file like LexLines, from its checkpoints, which are kept in cache
+= if it is not NULL. tokens and symbolTable are initialized by the function, as in Decompose.
+=
+= The file is mapped and not read. Once its checkpoints are cached it is only hashed, which is much cheaper than
+= scanning it, and lexed around the lines.
+=
+====================
+*/
+
+    size_t             length;
+    char *             source = MapFile( inputFilename, &length );
+    checkpointIndex_t  index = OpenCheckpoints( cache, source, length, punchCardExtension );
+
+    *tokens = InitializeTokenList();
+    *symbolTable = InitializeSymbolTable();
+
+    LexLines( source, length, &index, firstLine, lastLine, tokens, symbolTable );
+
+    DestroyCheckpoints( &index );
+    UnmapFile( source, length );
+}
+
+void DestroyCheckpoints( checkpointIndex_t * index ) {
+/*
+====================
+=
+= DestroyCheckpoints
+=
+= Frees the checkpoints of index.
+=
+====================
+*/
+
+    free( index->checkpoints );
+    index->checkpoints = NULL;
+    index->count = 0;
+}
\ No newline at end of file
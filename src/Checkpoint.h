@@ -0,0 +1,41 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "OutputBuffer.h"
+#include "TokenCache.h"
+
+// Bytes of source between two lexer checkpoints, a line range is lexed from at most this far before its first line.
+#ifndef CHECKPOINT_INTERVAL
+#define CHECKPOINT_INTERVAL ( 64 << 10 )
+#endif
+
+// Of the token cache entries that hold checkpoints.
+#define CHECKPOINT_EXTENSION ".ckpt"
+
+#define CHECKPOINT_FILE_REVISION 2
+
+typedef struct {
+    uint64_t  offset;    // Of the start of a line, in the file as it is on disk
+    uint64_t  line;      // Starting at 1
+    uint32_t  state;     // NORMAL_STATE, COMMENT_STATE or UNKNOWN_STATE
+} checkpoint_t;
+
+typedef struct {
+    checkpoint_t *  checkpoints;
+    size_t          count;
+    uint64_t        length;      // Of the file the checkpoints were taken on
+    uint64_t        hash;        // HashContent of that file
+    bool            punchCardExtension;
+} checkpointIndex_t;
+
+checkpointIndex_t ScanCheckpoints( const char * source, size_t length, bool punchCardExtension );
+void EncodeCheckpoints( checkpointIndex_t * index, outputBuffer_t * output );
+bool DecodeCheckpoints( const uint8_t * data, size_t size, checkpointIndex_t * index );
+checkpointIndex_t OpenCheckpoints( tokenCache_t * cache, const char * source, size_t length, bool punchCardExtension );
+void LexLines( const char * source, size_t length, checkpointIndex_t * index, size_t firstLine, size_t lastLine, tokenList_t * tokens, symbolTable_t * symbolTable );
+void DecomposeLines( char * inputFilename, bool punchCardExtension, size_t firstLine, size_t lastLine, tokenCache_t * cache, tokenList_t * tokens, symbolTable_t * symbolTable );
+void DestroyCheckpoints( checkpointIndex_t * index );
+#endif
\ No newline at end of file
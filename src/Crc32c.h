@@ -0,0 +1,7 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+#include <stdint.h>
+#include <stddef.h>
+
+uint32_t Crc32c( uint32_t crc, const void * data, size_t size );
+#endif
\ No newline at end of file
@@ -1,10 +1,214 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <setjmp.h>
 #include "TokenList.h"
 #include "SymbolTable.h"
 #include "File.h"
+#include "TokenFile.h"
+#include "TokenStream.h"
 #include "HandleCharacters.h"
+#include "Diagnostic.h"
+#include "Decompose.h"
+
+// Smallest chunk a file is split into for parallel lexing, smaller files are lexed by one thread.
+#ifndef PARALLEL_CHUNK_SIZE
+#define PARALLEL_CHUNK_SIZE ( 1 << 18 )
+#endif
+
+typedef struct {
+    char *         start;
+    char *         end;
+    int            endStates[ 2 ];
+    int            state;
+    tokenList_t    tokens;
+    symbolTable_t  symbolTable;
+} sourceChunk_t;
+
+typedef struct {
+    sourceChunk_t *  chunks;
+    size_t           count;
+    size_t           next;
+    bool             lex;
+    pthread_mutex_t  lock;
+} chunkWork_t;
+
+char * ReadSource( char * inputFilename, bool punchCardExtension, int * length ) {
+/*
+====================
+=
+= ReadSource
+=
+= Reads a C source file into a string and does the translation phases 1 and 2 of C on it.
+=
+= The string must be freed by the caller, length is filled with its length.
+=
+====================
+*/
+
+    // Open the file and convert it into a more manageable string.
+    char * sourceString = ReadFileIntoBuffer( inputFilename, length );
+    
+    // Translation phase 1 occurs locally when handling string literals and character constants.
+    
+    // If the punch card extention is enabled, remove all the DEL characters before parsing the file.
+    if ( punchCardExtension ) {
+        RemoveDel( sourceString, length );
+    }
+
+    // Translation phase 2. (Remove backslashes followed by newlines).
+    RemoveBackslashNewline( sourceString, length );
+
+    return sourceString;
+}
+
+void LexInto( char * sourceString, int length, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= LexInto
+=
+= Does the translation phase 3 of C (lexical analysis) on a string returned by ReadSource, appending to tokens and
+= symbolTable, which must be initialized.
+=
+====================
+*/
+
+    char * slice = sourceString;
+    
+    while ( *slice != '\0' && slice - sourceString <= length - 1 ) {
+        slice = characterFunctions[ ( unsigned char ) ( *slice ) ]( slice, tokens, symbolTable );
+    }
+}
+
+lexerStatus_t LexTrapped( char * sourceString, int length, tokenList_t * tokens, symbolTable_t * symbolTable, bool recover, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= LexTrapped
+=
+= Lexes a string like LexInto, but returns LEXER_ERROR after an error instead of ending the program, with the error
+= pushed to diagnostics if it is not NULL.
+=
+= With recover set the lexical errors are recovered from: the bad input goes into an error token, a diagnostic is
+= pushed and the lexing carries on, returning LEXER_RECOVERED in the end. One stray byte costs one diagnostic and not
+= the whole file.
+=
+====================
+*/
+
+    errorTrap_t  trap;
+
+    SetErrorTrap( &trap, sourceString, length, recover, diagnostics );
+
+    if ( setjmp( trap.jump ) != 0 ) {
+        return LEXER_ERROR;
+    }
+
+    LexInto( sourceString, length, tokens, symbolTable );
+
+    ClearErrorTrap( &trap );
+
+    return trap.recovered > 0 ? LEXER_RECOVERED : LEXER_SUCCESS;
+}
+
+void LexSource( char * sourceString, int length, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= LexSource
+=
+= Lexes a string returned by ReadSource like LexInto. tokens and symbolTable are initialized by the function, as in
+= Decompose.
+=
+====================
+*/
+
+    *tokens = InitializeTokenList();
+    *symbolTable = InitializeSymbolTable();
+
+    LexInto( sourceString, length, tokens, symbolTable );
+}
+
+lexerContext_t InitializeLexerContext() {
+/*
+====================
+=
+= InitializeLexerContext
+=
+= Initializes the lexerContext_t data structure, the tokens and symbol table of a file that are reused for the next
+= file instead of being made anew.
+=
+====================
+*/
+
+    lexerContext_t  context;
+
+    context.tokens = InitializeTokenList();
+    context.symbolTable = InitializeSymbolTable();
+
+    // Copy of the last memory buffer lexed by LexBuffer, kept to be reused.
+    context.source = NULL;
+    context.sourceCapacity = 0;
+
+    return context;
+}
+
+void ResetLexerContext( lexerContext_t * context ) {
+/*
+====================
+=
+= ResetLexerContext
+=
+= Empties a lexer context for the next file. The token list keeps its capacity and only the symbols used by the last
+= file are cleared, so the cost depends on the last file and not on the size of the symbol table.
+=
+====================
+*/
+
+    context->tokens.size = 0;
+    ResetSymbolTable( &( context->symbolTable ) );
+}
+
+void DestroyLexerContext( lexerContext_t * context ) {
+    DestroySymbolTable( context->symbolTable );
+    DestroyTokenList( context->tokens );
+    free( context->source );
+}
+
+lexerStatus_t DecomposeInto( lexerContext_t * context, char * inputFilename, bool punchCardExtension, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= DecomposeInto
+=
+= Decomposes a C source file like Decompose, into a lexer context that is reset first.
+=
+= With diagnostics set the file is lexed in recovery mode, see LexTrapped, and the status is returned. Otherwise any
+= error ends the program.
+=
+====================
+*/
+
+    int            length;
+    char *         sourceString = ReadSource( inputFilename, punchCardExtension, &length );
+    lexerStatus_t  status = LEXER_SUCCESS;
+
+    ResetLexerContext( context );
+
+    if ( diagnostics != NULL ) {
+        status = LexTrapped( sourceString, length, &( context->tokens ), &( context->symbolTable ), true, diagnostics );
+    } else {
+        LexInto( sourceString, length, &( context->tokens ), &( context->symbolTable ) );
+    }
+
+    free( sourceString );
+
+    return status;
+}
 
 void Decompose( char * inputFilename, bool punchCardExtension, tokenList_t * tokens, symbolTable_t * symbolTable ) {
 /*
@@ -28,92 +232,436 @@ void Decompose( char * inputFilename, bool punchCardExtension, tokenList_t * tok
 ====================
 */
     
-    // Open the file and convert it into a more manageable string.
-    int        length;
-    char *     sourceString;
+    int     length;
+    char *  sourceString = ReadSource( inputFilename, punchCardExtension, &length );
 
-    sourceString = ReadFileIntoBuffer( inputFilename, &length );
-    
-    // Translation phase 1 occurs locally when handling string literals and character constants.
+    LexSource( sourceString, length, tokens, symbolTable );
     
-    // If the punch card extention is enabled, remove all the DEL characters before parsing the file.
-    if ( punchCardExtension ) {
-        RemoveDel( sourceString, &length );
-    }
+    free( sourceString );
+}
 
-    // Translation phase 2. (Remove backslashes followed by newlines).
-    RemoveBackslashNewline( sourceString, &length );
+bool DecomposeRecovering( char * inputFilename, bool punchCardExtension, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= DecomposeRecovering
+=
+= Decomposes a C source file like Decompose, in recovery mode: the bad input is kept in error tokens and the diagnostics
+= are printed to stderr. A file that can't be lexed to the end still ends the program.
+=
+= Returns false if there were any diagnostics.
+=
+====================
+*/
+
+    int               length;
+    char *            sourceString = ReadSource( inputFilename, punchCardExtension, &length );
+    diagnosticList_t  diagnostics = InitializeDiagnosticList();
+    lexerStatus_t     status;
 
-    // Translation phase 3 (Lexical Analysis).
     *tokens = InitializeTokenList();
     *symbolTable = InitializeSymbolTable();
-    char * slice = sourceString;
-    
-    while ( *slice != '\0' && slice - sourceString <= length - 1 ) {
-        slice = characterFunctions[ ( unsigned char ) ( *slice ) ]( slice, tokens, symbolTable );
-    }
-    
+
+    status = LexTrapped( sourceString, length, tokens, symbolTable, true, &diagnostics );
+    PrintDiagnostics( stderr, inputFilename, &diagnostics );
+
+    DestroyDiagnosticList( diagnostics );
     free( sourceString );
+
+    if ( status == LEXER_ERROR ) {
+        exit( 1 );
+    }
+
+    return status == LEXER_SUCCESS;
 }
 
-void ExportTokenFile( char * outputFilename, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+void DecomposeToStream( char * inputFilename, char * outputFilename, bool punchCardExtension, tokenFileOptions_t * options ) {
 /*
 ====================
 =
-= ExportTokenFile
+= DecomposeToStream
+=
+= Decomposes a C source file into a %TOK-003 token stream, written to outputFilename ("-" for the standard output).
 =
-= Exports a series of tokens and a symbol table to a tokens file, as specified in Appendix 2 of "The Tokens" document.
+= The tokens are written in frames of about TOKEN_FRAME_SIZE tokens as the lexer goes, so only one frame of tokens is
+= held in memory and a reader can start on the first frames before the lexing is done.
 =
 ====================
 */
-    
-    FILE * output = fopen( outputFilename, "wb" );
 
-    // Signature (%TOK-001)
-    if ( fwrite( "\x25\x54\x4F\x4B\x2D\x30\x30\x31", 1, 8, output ) < 8 ) {
-        fputs( "Error writing to output file.\n", stderr );
-        fclose( output );
+    int            length;
+    char *         sourceString = ReadSource( inputFilename, punchCardExtension, &length );
+    tokenList_t    tokens = InitializeTokenList();
+    symbolTable_t  symbolTable = InitializeSymbolTable();
+    FILE *         output = strcmp( outputFilename, "-" ) ? fopen( outputFilename, "wb" ) : stdout;
+    tokenStream_t  stream;
+    char *         slice = sourceString;
+
+    if ( output == NULL ) {
+        perror( outputFilename );
         exit( 1 );
     }
 
-    // The amount of tokens
-    if ( fwrite( &( tokens->size ), sizeof( token_t ), 1, output ) < 1 ) {
-        fputs( "Error writing to output file.\n", stderr );
+    stream = InitializeTokenStream( output, options->compress );
+
+    while ( *slice != '\0' && slice - sourceString <= length - 1 ) {
+        slice = characterFunctions[ ( unsigned char ) ( *slice ) ]( slice, &tokens, &symbolTable );
+
+        // The character functions only return between tokens.
+        if ( tokens.size >= TOKEN_FRAME_SIZE ) {
+            PushTokenFrame( &stream, &tokens, &symbolTable );
+            tokens.size = 0;
+        }
+    }
+
+    FinishTokenStream( &stream, &tokens, &symbolTable );
+
+    if ( output != stdout ) {
         fclose( output );
+    }
+
+    DestroySymbolTable( symbolTable );
+    DestroyTokenList( tokens );
+    free( sourceString );
+}
+
+char * SkipBlockComment( char * slice, char * end ) {
+/*
+====================
+=
+= SkipBlockComment
+=
+= Returns the position after the first * / between slice and end, or NULL if the comment goes on past end.
+=
+====================
+*/
+
+    for ( ; slice + 1 < end; slice++ ) {
+        if ( slice[ 0 ] == '*' && slice[ 1 ] == '/' ) {
+            return slice + 2;
+        }
+    }
+
+    return NULL;
+}
+
+char * SkipCharacter( char * slice, char * end ) {
+/*
+====================
+=
+= SkipCharacter
+=
+= Returns the position after the character or escape sequence at slice, as HandleCharacterConstant reads it.
+=
+====================
+*/
+
+    int digits = 0;
+
+    if ( *slice != '\\' ) {
+        unsigned char lead = *slice;
+
+        return slice + ( lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4 );
+    } else if ( slice + 1 == end ) {
+        return end + 1;
+    } else if ( slice[ 1 ] >= '0' && slice[ 1 ] <= '7' ) {
+        for ( slice++; digits < 3 && slice < end && *slice >= '0' && *slice <= '7'; digits++, slice++ );
+    } else if ( slice[ 1 ] == 'u' || slice[ 1 ] == 'U' ) {
+        for ( slice += 2; digits < 8 && slice < end && isxdigit( ( unsigned char )*slice ); digits++, slice++ );
+    } else if ( slice[ 1 ] == 'x' ) {
+        for ( slice += 2; slice < end && isxdigit( ( unsigned char )*slice ); slice++ );
+    } else {
+        slice += 2;
+    }
+
+    return slice;
+}
+
+int ScanChunk( char * slice, char * end, int state ) {
+/*
+====================
+=
+= ScanChunk
+=
+= Finds out whether the lexer would end the source between slice and end inside a block comment, if it started it in
+= state (NORMAL_STATE or COMMENT_STATE).
+=
+= Only the constructs that can hide a comment delimiter are followed: comments, string literals, character constants,
+= pp-numbers (for their ' digit separators) and header names. Returns UNKNOWN_STATE when a string literal, character
+= constant or header name goes on past end, which no valid source split at a newline does.
+=
+====================
+*/
+
+    char close;
+
+    if ( state == COMMENT_STATE && ( slice = SkipBlockComment( slice, end ) ) == NULL ) {
+        return COMMENT_STATE;
+    }
+
+    while ( slice < end ) {
+        // Comments
+        if ( slice[ 0 ] == '/' && slice + 1 < end && slice[ 1 ] == '/' ) {
+            while ( slice < end && *slice != '\n' ) {
+                slice++;
+            }
+        } else if ( slice[ 0 ] == '/' && slice + 1 < end && slice[ 1 ] == '*' ) {
+            if ( ( slice = SkipBlockComment( slice + 2, end ) ) == NULL ) {
+                return COMMENT_STATE;
+            }
+        // String literals, like in the lexer a " after a backslash never closes them
+        } else if ( *slice == '\"' ) {
+            for ( slice++; slice < end && !( *slice == '\"' && slice[ -1 ] != '\\' ); slice++ );
+
+            if ( slice++ == end ) {
+                return UNKNOWN_STATE;
+            }
+        // Character constants
+        } else if ( *slice == '\'' ) {
+            if ( ++slice == end || ( slice = SkipCharacter( slice, end ) + 1 ) > end ) {
+                return UNKNOWN_STATE;
+            }
+        // pp-numbers and identifiers, which may end with the prefix of a character constant
+        } else if ( isalnum( ( unsigned char )*slice ) || *slice == '_' ) {
+            bool number = isdigit( ( unsigned char )*slice );
+
+            for ( slice++; slice < end && ( isalnum( ( unsigned char )*slice ) || *slice == '_' || ( number && ( *slice == '.' || *slice == '\'' ) ) ); slice++ );
+        // Header names
+        } else if ( *slice == '#' ) {
+            for ( slice++; slice < end && *slice == ' '; slice++ );
+
+            if ( ( end - slice > 7 && !memcmp( slice, "include", 7 ) ) || ( end - slice > 5 && !memcmp( slice, "embed", 5 ) ) ) {
+                for ( ; slice < end && *slice != '<' && *slice != '\"'; slice++ );
+
+                if ( slice == end ) {
+                    return UNKNOWN_STATE;
+                }
+
+                close = *slice == '<' ? '>' : '\"';
+
+                for ( slice++; slice < end && *slice != close; slice++ );
+
+                if ( slice++ == end ) {
+                    return UNKNOWN_STATE;
+                }
+            }
+        } else {
+            slice++;
+        }
+    }
+
+    return NORMAL_STATE;
+}
+
+void LexChunk( sourceChunk_t * chunk ) {
+/*
+====================
+=
+= LexChunk
+=
+= Lexes a chunk of the source into its own tokens and symbol table, starting in its resolved state.
+=
+= The chunk is lexed from a copy, as the character functions may briefly write a few bytes past the character they are
+= on and the next chunk belongs to another thread.
+=
+====================
+*/
+
+    size_t  length = chunk->end - chunk->start;
+    char *  copy = malloc( length + CHUNK_SLACK );
+    char *  slice;
+
+    if ( copy == NULL ) {
+        fputs( "Out of memory.\n", stderr );
         exit( 1 );
     }
 
-    // The tokens
-    tokenNode_t * tracer = tokens->head;
+    memcpy( copy, chunk->start, length );
+    memset( copy + length, 0, CHUNK_SLACK );
 
-    while ( tracer != NULL ) {       
-        if ( fwrite( &( tracer->token ), sizeof( token_t ), 1, output ) < 1 ) {
-            fputs( "Error writing to output file.\n", stderr );
-            fclose( output );
-            exit( 1 );
+    chunk->tokens = InitializeTokenList();
+    chunk->symbolTable = InitializeSymbolTable();
+
+    // The comment a chunk starts in was already pushed by the chunk it opened in.
+    slice = chunk->state == COMMENT_STATE ? SkipBlockComment( copy, copy + length ) : copy;
+
+    while ( slice != NULL && slice < copy + length ) {
+        slice = characterFunctions[ ( unsigned char ) ( *slice ) ]( slice, &( chunk->tokens ), &( chunk->symbolTable ) );
+    }
+
+    free( copy );
+}
+
+void * ChunkWorker( void * argument ) {
+/*
+====================
+=
+= ChunkWorker
+=
+= Scans or lexes chunks until none are left.
+=
+====================
+*/
+
+    chunkWork_t *    work = argument;
+    sourceChunk_t *  chunk;
+
+    while ( true ) {
+        pthread_mutex_lock( &( work->lock ) );
+        chunk = work->next < work->count ? &( work->chunks[ work->next++ ] ) : NULL;
+        pthread_mutex_unlock( &( work->lock ) );
+
+        if ( chunk == NULL ) {
+            return NULL;
+        }
+
+        if ( work->lex ) {
+            LexChunk( chunk );
+        } else {
+            chunk->endStates[ NORMAL_STATE ] = ScanChunk( chunk->start, chunk->end, NORMAL_STATE );
+            chunk->endStates[ COMMENT_STATE ] = ScanChunk( chunk->start, chunk->end, COMMENT_STATE );
         }
-        
-        tracer = tracer->next;
     }
+}
 
-    // Symbol table
-    token_t hash;
+void RunChunkWorkers( chunkWork_t * work, int threads, bool lex ) {
+/*
+====================
+=
+= RunChunkWorkers
+=
+= Runs one pass of ChunkWorker over every chunk on threads threads.
+=
+====================
+*/
+
+    pthread_t threadIds[ threads ];
 
-    while ( ReadChart( symbolTable->chart, &hash ) ) {
-        // Hash
-        if ( fwrite( &hash, 4, 1, output ) < 1 ) {
-            fputs( "Error writing to output file.\n", stderr );
-            fclose( output );
+    work->next = 0;
+    work->lex = lex;
+
+    for ( int i = 0; i < threads; i++ ) {
+        if ( pthread_create( &threadIds[ i ], NULL, ChunkWorker, work ) != 0 ) {
+            fputs( "Could not start a thread.\n", stderr );
             exit( 1 );
         }
+    }
 
-        // Name
-        if ( fwrite( symbolTable->table[ hash ], sizeof( char ), strlen( symbolTable->table[ hash ] ) + 1, output ) < strlen( symbolTable->table[ hash ] ) + 1 ) {
-            fputs( "Error writing to output file.\n", stderr );
-            fclose( output );
-            exit( 1 );
+    for ( int i = 0; i < threads; i++ ) {
+        pthread_join( threadIds[ i ], NULL );
+    }
+}
+
+void DecomposeParallel( char * inputFilename, bool punchCardExtension, int threads, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= DecomposeParallel
+=
+= Decomposes a C source file like Decompose, splitting large files into chunks at newlines that are lexed on threads
+= threads. The result is the same as the one of Decompose.
+=
+= Only a block comment can carry the state of the lexer across a newline, so every chunk is first scanned twice in
+= parallel, once as if it started in code and once as if it started inside a comment, which is much cheaper than
+= lexing it. The real state at the start of every chunk then follows from the end states in order. The chunks are
+= lexed in parallel from their real state into their own lists and tables, and merged in order: re-pushing the symbols
+= of every chunk in the order they were first found gives them the hashes a single lexer would have, and the
+= identifiers of the chunk are remapped to them.
+=
+= Falls back to a single lexer when a chunk can't be scanned, e.g. on a string literal that goes on past a newline.
+=
+====================
+*/
+
+    int              length;
+    char *           sourceString = ReadSource( inputFilename, punchCardExtension, &length );
+    size_t           size = strlen( sourceString ); // Like Decompose, stop at the first NUL.
+    size_t           count = threads * 4;
+    sourceChunk_t *  chunks;
+    chunkWork_t      work;
+    char *           slice = sourceString;
+    token_t          remap[ SYMBOL_TABLE_SIZE ];
+    int              state = NORMAL_STATE;
+    size_t           i;
+
+    if ( size > ( size_t )length ) {
+        size = length;
+    }
+
+    if ( count > size / PARALLEL_CHUNK_SIZE ) {
+        count = size / PARALLEL_CHUNK_SIZE;
+    }
+
+    if ( ( chunks = malloc( ( count + 1 ) * sizeof( sourceChunk_t ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    // Split at the first newline after every chunk size, the last chunk gets the rest.
+    for ( i = 0; i < count && slice < sourceString + size; i++ ) {
+        char * newline = i == count - 1 ? NULL : memchr( sourceString + ( i + 1 ) * size / count, '\n', size - ( i + 1 ) * size / count );
+
+        chunks[ i ].start = slice;
+        chunks[ i ].end = newline == NULL ? sourceString + size : newline + 1;
+
+        if ( chunks[ i ].end < slice ) {
+            chunks[ i ].end = slice;
         }
+
+        slice = chunks[ i ].end;
+    }
+
+    count = i;
+
+    work = ( chunkWork_t ){ chunks, count, 0, false, PTHREAD_MUTEX_INITIALIZER };
+
+    if ( count > 1 ) {
+        RunChunkWorkers( &work, threads, false );
+
+        for ( i = 0; i < count && state != UNKNOWN_STATE; i++ ) {
+            chunks[ i ].state = state;
+            state = chunks[ i ].endStates[ state ];
+        }
+    }
+
+    if ( count <= 1 || state == UNKNOWN_STATE ) {
+        free( sourceString );
+        free( chunks );
+        Decompose( inputFilename, punchCardExtension, tokens, symbolTable );
+        return;
+    }
+
+    RunChunkWorkers( &work, threads, true );
+    pthread_mutex_destroy( &( work.lock ) );
+    free( sourceString );
+
+    // Merge
+    *tokens = InitializeTokenList();
+    *symbolTable = InitializeSymbolTable();
+
+    for ( i = 0; i < count; i++ ) {
+        tokenList_t * chunkTokens = &( chunks[ i ].tokens );
+        size_t        first = tokens->size;
+
+        for ( chartStack_t * tracer = chunks[ i ].symbolTable.chart; tracer != NULL; tracer = tracer->next ) {
+            symbol_t symbol = chunks[ i ].symbolTable.table[ tracer->hash ];
+
+            remap[ tracer->hash ] = PushSymbol( symbolTable, symbol, strlen( symbol ) );
+        }
+
+        if ( chunkTokens->size > 0 ) {
+            PushData( tokens, chunkTokens->tokens, chunkTokens->size * sizeof( token_t ) );
+        }
+
+        for ( size_t position = first; position < tokens->size; position += TokenWords( tokens, position ) ) {
+            if ( tokens->tokens[ position ] >= 747 && tokens->tokens[ position ] < SYMBOL_TABLE_SIZE ) {
+                tokens->tokens[ position ] = remap[ tokens->tokens[ position ] ];
+            }
+        }
+
+        DestroySymbolTable( chunks[ i ].symbolTable );
+        DestroyTokenList( chunks[ i ].tokens );
     }
 
-    fclose( output );
+    free( chunks );
 }
\ No newline at end of file
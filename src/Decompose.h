@@ -1,5 +1,39 @@
+#ifndef DECOMPOSE_H
+#define DECOMPOSE_H
 #include "TokenList.h"
 #include "SymbolTable.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
 
+// Zeroed bytes after every chunk copy, the character functions read a few bytes ahead.
+#define CHUNK_SLACK 64
+
+// What the lexer is in at the start of a line, see ScanChunk.
+enum chunkState_t {
+    NORMAL_STATE,
+    COMMENT_STATE,
+    UNKNOWN_STATE,
+};
+
+typedef struct {
+    tokenList_t    tokens;
+    symbolTable_t  symbolTable;
+    char *         source;
+    size_t         sourceCapacity;
+} lexerContext_t;
+
+char * ReadSource( char * inputFilename, bool punchCardExtension, int * length );
+void LexInto( char * sourceString, int length, tokenList_t * tokens, symbolTable_t * symbolTable );
+lexerStatus_t LexTrapped( char * sourceString, int length, tokenList_t * tokens, symbolTable_t * symbolTable, bool recover, diagnosticList_t * diagnostics );
+void LexSource( char * sourceString, int length, tokenList_t * tokens, symbolTable_t * symbolTable );
+lexerContext_t InitializeLexerContext();
+void ResetLexerContext( lexerContext_t * context );
+void DestroyLexerContext( lexerContext_t * context );
+lexerStatus_t DecomposeInto( lexerContext_t * context, char * inputFilename, bool punchCardExtension, diagnosticList_t * diagnostics );
 void Decompose( char * inputFilename, bool punchCardExtension, tokenList_t * tokens, symbolTable_t * symbolTable );
-void ExportTokenFile( char * outputFilename, tokenList_t * tokens, symbolTable_t * symbolTable );
\ No newline at end of file
+void DecomposeParallel( char * inputFilename, bool punchCardExtension, int threads, tokenList_t * tokens, symbolTable_t * symbolTable );
+bool DecomposeRecovering( char * inputFilename, bool punchCardExtension, tokenList_t * tokens, symbolTable_t * symbolTable );
+char * SkipBlockComment( char * slice, char * end );
+int ScanChunk( char * slice, char * end, int state );
+void DecomposeToStream( char * inputFilename, char * outputFilename, bool punchCardExtension, tokenFileOptions_t * options );
+#endif
\ No newline at end of file
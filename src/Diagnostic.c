@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include "Diagnostic.h"
+
+// The innermost error trap of the thread, NULL when errors end the program.
+static _Thread_local errorTrap_t *  errorTrap = NULL;
+
+diagnosticList_t InitializeDiagnosticList() {
+/*
+====================
+=
+= InitializeDiagnosticList
+=
+= Initializes the diagnosticList_t data structure.
+=
+====================
+*/
+
+    diagnosticList_t  list;
+
+    list.diagnostics = NULL;
+    list.size = 0;
+    list.capacity = 0;
+
+    return list;
+}
+
+bool PushDiagnostic( diagnosticList_t * list, diagnosticKind_t kind, size_t offset, const char * message ) {
+/*
+====================
+=
+= PushDiagnostic
+=
+= Pushes a diagnostic to a list, the message is truncated to DIAGNOSTIC_MESSAGE_SIZE - 1 characters.
+=
+= Returns false if there is no memory left for it. This never raises an error, as it is how errors are reported.
+=
+====================
+*/
+
+    diagnostic_t *  diagnostics;
+
+    if ( list->size == list->capacity ) {
+        if ( ( diagnostics = realloc( list->diagnostics, ( list->capacity == 0 ? 16 : list->capacity * 2 ) * sizeof( diagnostic_t ) ) ) == NULL ) {
+            return false;
+        }
+
+        list->diagnostics = diagnostics;
+        list->capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+    }
+
+    list->diagnostics[ list->size ].kind = kind;
+    list->diagnostics[ list->size ].offset = offset;
+    snprintf( list->diagnostics[ list->size ].message, DIAGNOSTIC_MESSAGE_SIZE, "%s", message );
+    list->size++;
+
+    return true;
+}
+
+void PrintDiagnostics( FILE * file, const char * name, diagnosticList_t * list ) {
+/*
+====================
+=
+= PrintDiagnostics
+=
+= Prints the diagnostics of a list to file, one per line and prefixed by name, then empties the list.
+=
+====================
+*/
+
+    for ( size_t i = 0; i < list->size; i++ ) {
+        if ( list->diagnostics[ i ].offset == NO_OFFSET ) {
+            fprintf( file, "%s: %s\n", name, list->diagnostics[ i ].message );
+        } else {
+            fprintf( file, "%s: offset %zu: %s\n", name, list->diagnostics[ i ].offset, list->diagnostics[ i ].message );
+        }
+    }
+
+    list->size = 0;
+}
+
+void DestroyDiagnosticList( diagnosticList_t list ) {
+    free( list.diagnostics );
+}
+
+void SetErrorTrap( errorTrap_t * trap, const char * source, size_t length, bool recover, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= SetErrorTrap
+=
+= Makes RaiseError return to trap instead of ending the program, until ClearErrorTrap is called. The caller then calls
+= setjmp on trap->jump, which returns a non-zero value when an error was raised.
+=
+= Errors raised at a position inside the length characters of source are reported with their offset from source, and
+= all errors are pushed to diagnostics if it is not NULL.
+=
+= With recover set the lexical errors don't return to the trap: RaiseError counts them in trap->recovered and returns,
+= and the lexer carries on after the bad input. Running out of memory or identifiers still returns to the trap.
+=
+= Traps nest, and each thread has its own.
+=
+====================
+*/
+
+    trap->source = source;
+    trap->length = length;
+    trap->recover = recover;
+    trap->recovered = 0;
+    trap->diagnostics = diagnostics;
+    trap->previous = errorTrap;
+
+    errorTrap = trap;
+}
+
+void ClearErrorTrap( errorTrap_t * trap ) {
+    errorTrap = trap->previous;
+}
+
+void RaiseError( const char * position, diagnosticKind_t kind, const char * format, ... ) {
+/*
+====================
+=
+= RaiseError
+=
+= Reports an error at position, which may be NULL.
+=
+= Without an error trap the message is printed and the program ends, as it always did from the command line. With one
+= the error is recorded as a diagnostic and the function returns to the setjmp of the trap, leaving whatever was being
+= built in a state that can only be reset or destroyed, unless the trap recovers from the error: then the function
+= returns to its caller, which skips the bad input.
+=
+====================
+*/
+
+    errorTrap_t *  trap = errorTrap;
+    char           message[ DIAGNOSTIC_MESSAGE_SIZE ];
+    size_t         offset = NO_OFFSET;
+    va_list        arguments;
+
+    va_start( arguments, format );
+
+    if ( trap == NULL ) {
+        vfprintf( stderr, format, arguments );
+        fputc( '\n', stderr );
+        exit( 1 );
+    }
+
+    vsnprintf( message, DIAGNOSTIC_MESSAGE_SIZE, format, arguments );
+    va_end( arguments );
+
+    if ( position != NULL && trap->source != NULL && position >= trap->source && position <= trap->source + trap->length ) {
+        offset = position - trap->source;
+    }
+
+    if ( trap->diagnostics != NULL ) {
+        PushDiagnostic( trap->diagnostics, kind, offset, message );
+    }
+
+    if ( trap->recover && kind >= INVALID_CHARACTER_ERROR && kind <= INVALID_CONSTANT_ERROR ) {
+        trap->recovered++;
+        return;
+    }
+
+    // The trap is spent, the caller is back outside of it.
+    errorTrap = trap->previous;
+    longjmp( trap->jump, 1 );
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef DIAGNOSTIC_H
+#define DIAGNOSTIC_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <setjmp.h>
+
+#define DIAGNOSTIC_MESSAGE_SIZE 256
+
+// Offset of a diagnostic that is not tied to a position in the source.
+#define NO_OFFSET SIZE_MAX
+
+typedef enum {
+    LEXER_SUCCESS,
+    LEXER_RECOVERED,
+    LEXER_ERROR,
+} lexerStatus_t;
+
+// The kinds from INVALID_CHARACTER_ERROR to INVALID_CONSTANT_ERROR can be recovered from.
+typedef enum {
+    OUT_OF_MEMORY_ERROR,
+    INPUT_TOO_LARGE_ERROR,
+    INVALID_CHARACTER_ERROR,
+    UNKNOWN_DIRECTIVE_ERROR,
+    UNSUPPORTED_ESCAPE_ERROR,
+    INVALID_IDENTIFIER_ERROR,
+    INVALID_CONSTANT_ERROR,
+    SYMBOL_TABLE_FULL_ERROR,
+    INVALID_TOKEN_ERROR,
+    INVALID_EDIT_ERROR,
+    MALFORMED_FILE_ERROR,
+    WRITE_ERROR,
+} diagnosticKind_t;
+
+typedef struct {
+    diagnosticKind_t  kind;
+    size_t            offset;
+    char              message[ DIAGNOSTIC_MESSAGE_SIZE ];
+} diagnostic_t;
+
+typedef struct {
+    diagnostic_t *  diagnostics;
+    size_t          size;
+    size_t          capacity;
+} diagnosticList_t;
+
+typedef struct _errorTrap_t {
+    jmp_buf                 jump;
+    const char *            source;
+    size_t                  length;
+    bool                    recover;
+    size_t                  recovered;
+    diagnosticList_t *      diagnostics;
+    struct _errorTrap_t *   previous;
+} errorTrap_t;
+
+diagnosticList_t InitializeDiagnosticList();
+bool PushDiagnostic( diagnosticList_t * list, diagnosticKind_t kind, size_t offset, const char * message );
+void PrintDiagnostics( FILE * file, const char * name, diagnosticList_t * list );
+void DestroyDiagnosticList( diagnosticList_t list );
+void SetErrorTrap( errorTrap_t * trap, const char * source, size_t length, bool recover, diagnosticList_t * diagnostics );
+void ClearErrorTrap( errorTrap_t * trap );
+void RaiseError( const char * position, diagnosticKind_t kind, const char * format, ... );
+#endif
\ No newline at end of file
@@ -0,0 +1,548 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "File.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
+#include "HandleCharacters.h"
+#include "Library.h"
+#include "Document.h"
+
+/*
+A document is a source that stays lexed as it is edited, for an editor that wants the tokens after every keystroke
+without lexing the whole buffer again.
+
+Next to its tokens a document keeps its lexemes: where every call of a character function started in the text, and
+where the tokens it pushed start in the list. The last lexeme is where the lexing stopped, with the size of the list.
+The character functions keep no state between calls and only look ahead, never further than DOCUMENT_LOOKAHEAD bytes
+past what they lex, so the lexer can be restarted at any lexeme that ends that far before an edit. From there the text
+is lexed again until a lexeme starts where an old lexeme after the edit started, moved by the length of the edit: the
+rest of the text is unchanged and would lex to the same tokens, so the lexing stops and the new lexemes and tokens are
+spliced in place of the old ones between the two. The lexing is proportional to the edit; what comes after it is only
+moved in memory.
+
+The text of a document is after the translation phases 1 and 2, like the one lexed by LexBuffer, and the offsets of the
+edits and of the diagnostics are counted in it.
+*/
+
+bool ReserveBytes( char ** buffer, size_t * capacity, size_t size, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= ReserveBytes
+=
+= Grows a buffer of *capacity bytes to hold at least size bytes, with room to spare for the next edits.
+=
+= Returns false with the error pushed to diagnostics, if it is not NULL, when there is no memory left; the buffer is
+= then left as it was.
+=
+====================
+*/
+
+    char *  grown;
+
+    if ( size <= *capacity ) {
+        return true;
+    }
+
+    size += size / 2;
+
+    if ( ( grown = realloc( *buffer, size ) ) == NULL ) {
+        if ( diagnostics != NULL ) {
+            PushDiagnostic( diagnostics, OUT_OF_MEMORY_ERROR, NO_OFFSET, "Out of memory." );
+        }
+
+        return false;
+    }
+
+    *buffer = grown;
+    *capacity = size;
+
+    return true;
+}
+
+void ReserveLexemes( lexemeList_t * lexemes, size_t size ) {
+    size_t      capacity = lexemes->capacity == 0 ? 1024 : lexemes->capacity;
+    lexeme_t *  grown;
+
+    if ( size <= lexemes->capacity ) {
+        return;
+    }
+
+    while ( capacity < size ) {
+        capacity *= 2;
+    }
+
+    if ( ( grown = realloc( lexemes->lexemes, capacity * sizeof( lexeme_t ) ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    lexemes->lexemes = grown;
+    lexemes->capacity = capacity;
+}
+
+void ReserveDocumentTokens( tokenList_t * tokens, size_t size ) {
+    size_t     capacity = tokens->capacity == 0 ? 1024 : tokens->capacity;
+    token_t *  grown;
+
+    if ( size <= tokens->capacity ) {
+        return;
+    }
+
+    while ( capacity < size ) {
+        capacity *= 2;
+    }
+
+    if ( ( grown = realloc( tokens->tokens, capacity * sizeof( token_t ) ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    tokens->tokens = grown;
+    tokens->capacity = capacity;
+}
+
+void PushLexeme( lexemeList_t * lexemes, size_t start, size_t token ) {
+    ReserveLexemes( lexemes, lexemes->size + 1 );
+
+    lexemes->lexemes[ lexemes->size ].start = start;
+    lexemes->lexemes[ lexemes->size ].token = token;
+    lexemes->size++;
+}
+
+size_t FindLexeme( lexemeList_t * lexemes, size_t offset ) {
+/*
+====================
+=
+= FindLexeme
+=
+= Returns the index of the first lexeme that starts at offset or after it, or the number of lexemes if there is none.
+=
+====================
+*/
+
+    size_t  low = 0;
+    size_t  high = lexemes->size;
+    size_t  middle;
+
+    while ( low < high ) {
+        middle = low + ( high - low ) / 2;
+
+        if ( lexemes->lexemes[ middle ].start < offset ) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+void CountReferences( lexedDocument_t * document, size_t first, size_t last, bool add ) {
+/*
+====================
+=
+= CountReferences
+=
+= Adds or removes the references of the identifiers among the tokens of a document from first to last, keeping the
+= count of the symbols that are referenced at all.
+=
+====================
+*/
+
+    tokenList_t  range = { document->tokens.tokens + first, last - first, last - first };
+    token_t      token;
+
+    for ( size_t position = 0; position < range.size; position += TokenWords( &range, position ) ) {
+        token = range.tokens[ position ];
+
+        if ( token < 747 ) {
+            continue;
+        }
+
+        if ( add ) {
+            if ( document->references[ token ]++ == 0 ) {
+                document->liveSymbols++;
+            }
+        } else if ( --( document->references[ token ] ) == 0 ) {
+            document->liveSymbols--;
+        }
+    }
+}
+
+void CountNewSymbols( lexedDocument_t * document, chartStack_t * tail ) {
+    for ( chartStack_t * tracer = tail == NULL ? document->symbolTable.chart : tail->next; tracer != NULL; tracer = tracer->next ) {
+        document->symbols++;
+    }
+}
+
+void SpliceText( lexedDocument_t * document, size_t offset, size_t deleted, const char * bytes, size_t length ) {
+/*
+====================
+=
+= SpliceText
+=
+= Replaces deleted bytes of the text of a document at offset with length bytes, the text must already have room for
+= them and its slack.
+=
+====================
+*/
+
+    char *  text = document->text;
+
+    memmove( text + offset + length, text + offset + deleted, document->length - offset - deleted );
+    memcpy( text + offset, bytes, length );
+
+    document->length = document->length - deleted + length;
+    memset( text + document->length, '\0', BUFFER_SLACK + 1 );
+}
+
+void RestoreDigraph( lexedDocument_t * document ) {
+    if ( document->digraph != NULL ) {
+        *( document->digraph ) = ':';
+        document->digraph = NULL;
+    }
+}
+
+size_t LexUntilResync( lexedDocument_t * document, size_t restart, size_t candidate, size_t inserted, size_t deleted ) {
+/*
+====================
+=
+= LexUntilResync
+=
+= Lexes the text of a document from the offset restart into its relexed tokens and lexemes, until a lexeme starts where
+= one of the old lexemes from candidate on started, after inserted bytes took the place of deleted ones before it.
+=
+= Returns the index of that old lexeme, whose start is not pushed again. If the lexing stops first, the lexeme where it
+= stopped is pushed and the number of old lexemes is returned.
+=
+====================
+*/
+
+    char *      text = document->text;
+    char *      slice = text + restart;
+    lexeme_t *  old = document->lexemes.lexemes;
+    size_t      count = document->lexemes.size;
+    size_t      position;
+
+    document->relexed.size = 0;
+    document->relexedLexemes.size = 0;
+
+    while ( true ) {
+        position = slice - text;
+
+        // A character function can only go past the end on a NUL of the slack.
+        if ( position > document->length ) {
+            position = document->length;
+        }
+
+        // The old lexemes are moved by the edit, compared so that nothing goes negative.
+        while ( candidate < count && old[ candidate ].start + inserted < position + deleted ) {
+            candidate++;
+        }
+
+        if ( candidate < count && old[ candidate ].start + inserted == position + deleted ) {
+            return candidate;
+        }
+
+        PushLexeme( &( document->relexedLexemes ), position, document->relexed.size );
+
+        if ( *slice == '\0' || position == document->length ) {
+            return count;
+        }
+
+        // %: is lexed by writing a # over the colon, which is put back so that the text can be lexed again, also by
+        // RestoreDigraph after a trapped error.
+        document->digraph = slice[ 0 ] == '%' && slice[ 1 ] == ':' ? slice + 1 : NULL;
+        slice = characterFunctions[ ( unsigned char )*slice ]( slice, &( document->relexed ), &( document->symbolTable ) );
+        RestoreDigraph( document );
+    }
+}
+
+tokenSplice_t ReplaceLexemes( lexedDocument_t * document, size_t first, size_t last, size_t inserted, size_t deleted ) {
+/*
+====================
+=
+= ReplaceLexemes
+=
+= Replaces the lexemes of a document from first to last, and their tokens, with the relexed ones. The lexemes after
+= them are moved by the edit, inserted bytes in place of deleted ones, and by the change in the number of tokens.
+=
+= The memory is reserved before anything changes, so that an error leaves the document as it was.
+=
+====================
+*/
+
+    lexemeList_t *  lexemes = &( document->lexemes );
+    lexemeList_t *  relexed = &( document->relexedLexemes );
+    tokenList_t *   tokens = &( document->tokens );
+    size_t          firstToken = first < lexemes->size ? lexemes->lexemes[ first ].token : tokens->size;
+    size_t          lastToken = last < lexemes->size ? lexemes->lexemes[ last ].token : tokens->size;
+    size_t          tail = lexemes->size - last;
+    tokenSplice_t   splice = { firstToken, lastToken - firstToken, document->relexed.size };
+
+    ReserveDocumentTokens( tokens, tokens->size - splice.removed + splice.inserted );
+    ReserveLexemes( lexemes, first + relexed->size + tail );
+
+    // Tokens
+    CountReferences( document, firstToken, lastToken, false );
+
+    memmove( tokens->tokens + firstToken + splice.inserted, tokens->tokens + lastToken, ( tokens->size - lastToken ) * sizeof( token_t ) );
+    memcpy( tokens->tokens + firstToken, document->relexed.tokens, splice.inserted * sizeof( token_t ) );
+    tokens->size = tokens->size - splice.removed + splice.inserted;
+
+    CountReferences( document, firstToken, firstToken + splice.inserted, true );
+
+    // Lexemes
+    memmove( lexemes->lexemes + first + relexed->size, lexemes->lexemes + last, tail * sizeof( lexeme_t ) );
+
+    for ( size_t i = 0; i < relexed->size; i++ ) {
+        lexemes->lexemes[ first + i ].start = relexed->lexemes[ i ].start;
+        lexemes->lexemes[ first + i ].token = relexed->lexemes[ i ].token + firstToken;
+    }
+
+    lexemes->size = first + relexed->size + tail;
+
+    for ( size_t i = first + relexed->size; i < lexemes->size; i++ ) {
+        lexemes->lexemes[ i ].start = lexemes->lexemes[ i ].start - deleted + inserted;
+        lexemes->lexemes[ i ].token = lexemes->lexemes[ i ].token - splice.removed + splice.inserted;
+    }
+
+    return splice;
+}
+
+tokenSplice_t LexWhole( lexedDocument_t * document ) {
+/*
+====================
+=
+= LexWhole
+=
+= Lexes the whole text of a document again, with an emptied symbol table.
+=
+= If an error is trapped the document is left without tokens, and whole set for the next edit to try again.
+=
+====================
+*/
+
+    size_t         removed = document->tokens.size;
+    tokenSplice_t  splice;
+
+    document->whole = true;
+    document->tokens.size = 0;
+    document->lexemes.size = 0;
+    ResetSymbolTable( &( document->symbolTable ) );
+    memset( document->references, 0, SYMBOL_TABLE_SIZE * sizeof( uint32_t ) );
+    document->symbols = 0;
+    document->liveSymbols = 0;
+
+    LexUntilResync( document, 0, 0, 0, 0 );
+    splice = ReplaceLexemes( document, 0, 0, 0, 0 );
+    CountNewSymbols( document, NULL );
+
+    document->whole = false;
+    splice.removed = removed;
+
+    return splice;
+}
+
+lexerStatus_t OpenDocument( lexedDocument_t * document, const char * buffer, size_t length, bool punchCardExtension, bool recover, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= OpenDocument
+=
+= Opens a document on a copy of length bytes of C source at buffer and lexes it whole.
+=
+= recover and diagnostics are as in LexBuffer, and are kept for the edits. After LEXER_ERROR the document has no tokens,
+= the next edit lexes it whole again; it must be closed either way.
+=
+====================
+*/
+
+    errorTrap_t  trap;
+    int          sourceLength;
+
+    document->text = NULL;
+    document->length = 0;
+    document->capacity = 0;
+    document->tokens = InitializeTokenList();
+    document->lexemes = ( lexemeList_t ){ NULL, 0, 0 };
+    document->symbolTable = InitializeSymbolTable();
+    document->references = calloc( SYMBOL_TABLE_SIZE, sizeof( uint32_t ) );
+    document->symbols = 0;
+    document->liveSymbols = 0;
+    document->punchCardExtension = punchCardExtension;
+    document->recover = recover;
+    document->whole = true;
+    document->digraph = NULL;
+    document->diagnostics = diagnostics;
+    document->relexed = InitializeTokenList();
+    document->relexedLexemes = ( lexemeList_t ){ NULL, 0, 0 };
+    document->replacement = NULL;
+    document->replacementCapacity = 0;
+    document->removed = NULL;
+    document->removedCapacity = 0;
+
+    if ( document->references == NULL ) {
+        if ( diagnostics != NULL ) {
+            PushDiagnostic( diagnostics, OUT_OF_MEMORY_ERROR, NO_OFFSET, "Out of memory." );
+        }
+
+        return LEXER_ERROR;
+    }
+
+    if ( !CopySource( &( document->text ), &( document->capacity ), buffer, length, punchCardExtension, &sourceLength, diagnostics ) ) {
+        return LEXER_ERROR;
+    }
+
+    document->length = sourceLength;
+
+    SetErrorTrap( &trap, document->text, document->length, recover, diagnostics );
+
+    if ( setjmp( trap.jump ) != 0 ) {
+        RestoreDigraph( document );
+        return LEXER_ERROR;
+    }
+
+    LexWhole( document );
+
+    ClearErrorTrap( &trap );
+
+    return trap.recovered > 0 ? LEXER_RECOVERED : LEXER_SUCCESS;
+}
+
+lexerStatus_t EditDocument( lexedDocument_t * document, size_t offset, size_t deleted, const char * inserted, size_t length, tokenSplice_t * splice ) {
+/*
+====================
+=
+= EditDocument
+=
+= Replaces deleted bytes of the text of a document at offset with length bytes at inserted, which go through the
+= translation phases 1 and 2, and lexes the text again from the nearest restart point before the edit until the tokens
+= are the same as before. splice, if it is not NULL, is filled with the range of tokens that changed.
+=
+= The identifiers that are no longer referenced stay in the symbol table, so that the hashes don't change between
+= edits, until there are more than DOCUMENT_DEAD_SYMBOLS of them; the document is then lexed whole with an emptied
+= table.
+=
+= Returns the status of the lexing of the edit, with its diagnostics pushed to the list of the document. An edit that
+= can't be lexed is undone, unless the document had no tokens after an earlier error; the text then keeps the edit and
+= the next one tries to lex it whole again.
+=
+====================
+*/
+
+    errorTrap_t     trap;
+    tokenSplice_t   changed;
+    chartStack_t *  tail = document->symbolTable.chartTail;
+    size_t          previousSize = document->tokens.size;
+    size_t          before = offset > 0 ? 1 : 0;
+    size_t          after;
+    size_t          restart = 0;
+    size_t          candidate = 0;
+    size_t          resync;
+    int             replaced;
+
+    if ( offset > document->length || deleted > document->length - offset ) {
+        if ( document->diagnostics != NULL ) {
+            PushDiagnostic( document->diagnostics, INVALID_EDIT_ERROR, offset, "Edit goes past the end of the document." );
+        }
+
+        return LEXER_ERROR;
+    }
+
+    if ( length > ( size_t )INT_MAX - BUFFER_SLACK - 3 - ( document->length - deleted ) ) {
+        if ( document->diagnostics != NULL ) {
+            PushDiagnostic( document->diagnostics, INPUT_TOO_LARGE_ERROR, NO_OFFSET, "Document too large to lex." );
+        }
+
+        return LEXER_ERROR;
+    }
+
+    after = offset + deleted < document->length ? 1 : 0;
+
+    if ( !ReserveBytes( &( document->replacement ), &( document->replacementCapacity ), before + length + after + 1, document->diagnostics )
+      || !ReserveBytes( &( document->removed ), &( document->removedCapacity ), before + deleted + after, document->diagnostics )
+      || !ReserveBytes( &( document->text ), &( document->capacity ), document->length - deleted + length + BUFFER_SLACK + 1, document->diagnostics ) ) {
+        return LEXER_ERROR;
+    }
+
+    // The bytes on both sides of the edit go through the translation phases with the inserted ones, for the
+    // backslash-newlines that the edit makes.
+    memcpy( document->replacement, document->text + offset - before, before );
+    memcpy( document->replacement + before, inserted, length );
+    memcpy( document->replacement + before + length, document->text + offset + deleted, after );
+    document->replacement[ before + length + after ] = '\0';
+    replaced = before + length + after;
+
+    if ( document->punchCardExtension ) {
+        RemoveDel( document->replacement, &replaced );
+    }
+
+    RemoveBackslashNewline( document->replacement, &replaced );
+
+    offset -= before;
+    deleted += before + after;
+    memcpy( document->removed, document->text + offset, deleted );
+
+    // The lexer restarts at the first lexeme that ends less than DOCUMENT_LOOKAHEAD bytes before the edit, and can
+    // resynchronize with any lexeme that starts after it.
+    if ( !document->whole ) {
+        restart = FindLexeme( &( document->lexemes ), offset >= DOCUMENT_LOOKAHEAD ? offset - DOCUMENT_LOOKAHEAD + 1 : 0 );
+        restart = restart > 0 ? restart - 1 : 0;
+        candidate = FindLexeme( &( document->lexemes ), offset + deleted );
+    }
+
+    SpliceText( document, offset, deleted, document->replacement, replaced );
+
+    SetErrorTrap( &trap, document->text, document->length, document->recover, document->diagnostics );
+
+    if ( setjmp( trap.jump ) != 0 ) {
+        RestoreDigraph( document );
+
+        if ( !document->whole ) {
+            SpliceText( document, offset, replaced, document->removed, deleted );
+            CountNewSymbols( document, tail );
+        }
+
+        return LEXER_ERROR;
+    }
+
+    if ( document->whole ) {
+        changed = LexWhole( document );
+    } else {
+        resync = LexUntilResync( document, document->lexemes.lexemes[ restart ].start, candidate, replaced, deleted );
+        changed = ReplaceLexemes( document, restart, resync, replaced, deleted );
+        CountNewSymbols( document, tail );
+
+        if ( document->symbols - document->liveSymbols > DOCUMENT_DEAD_SYMBOLS ) {
+            changed = LexWhole( document );
+            changed.removed = previousSize;
+        }
+    }
+
+    ClearErrorTrap( &trap );
+
+    if ( splice != NULL ) {
+        *splice = changed;
+    }
+
+    return trap.recovered > 0 ? LEXER_RECOVERED : LEXER_SUCCESS;
+}
+
+void CloseDocument( lexedDocument_t * document ) {
+    DestroySymbolTable( document->symbolTable );
+    DestroyTokenList( document->tokens );
+    DestroyTokenList( document->relexed );
+    free( document->lexemes.lexemes );
+    free( document->relexedLexemes.lexemes );
+    free( document->references );
+    free( document->text );
+    free( document->replacement );
+    free( document->removed );
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "Diagnostic.h"
+
+// Bytes past its end a character function may look at, a lexeme that ends closer than that to an edit is lexed again.
+#ifndef DOCUMENT_LOOKAHEAD
+#define DOCUMENT_LOOKAHEAD 16
+#endif
+
+// Unreferenced symbols a document keeps before it is lexed whole with an emptied symbol table, half of the table.
+#ifndef DOCUMENT_DEAD_SYMBOLS
+#define DOCUMENT_DEAD_SYMBOLS ( ( SYMBOL_TABLE_SIZE - 747 ) / 2 )
+#endif
+
+typedef struct {
+    size_t  start;
+    size_t  token;
+} lexeme_t;
+
+typedef struct {
+    lexeme_t *  lexemes;
+    size_t      size;
+    size_t      capacity;
+} lexemeList_t;
+
+typedef struct {
+    size_t  first;
+    size_t  removed;
+    size_t  inserted;
+} tokenSplice_t;
+
+typedef struct {
+    char *              text;
+    size_t              length;
+    size_t              capacity;
+    tokenList_t         tokens;
+    lexemeList_t        lexemes;
+    symbolTable_t       symbolTable;
+    uint32_t *          references;
+    size_t              symbols;
+    size_t              liveSymbols;
+    bool                punchCardExtension;
+    bool                recover;
+    bool                whole;
+    char *              digraph;
+    diagnosticList_t *  diagnostics;
+    tokenList_t         relexed;
+    lexemeList_t        relexedLexemes;
+    char *              replacement;
+    size_t              replacementCapacity;
+    char *              removed;
+    size_t              removedCapacity;
+} lexedDocument_t;
+
+lexerStatus_t OpenDocument( lexedDocument_t * document, const char * buffer, size_t length, bool punchCardExtension, bool recover, diagnosticList_t * diagnostics );
+lexerStatus_t EditDocument( lexedDocument_t * document, size_t offset, size_t deleted, const char * inserted, size_t length, tokenSplice_t * splice );
+void CloseDocument( lexedDocument_t * document );
+#endif
\ No newline at end of file
@@ -3,6 +3,13 @@
 #include <string.h>
 #include <stdbool.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 void * ReadFileIntoBuffer( char * filename, int * fileLength );
 int RemoveBackslashNewline( char * string, int * size );
 
@@ -65,6 +72,209 @@ void * ReadFileIntoBuffer( char * filename, int * fileLength ) {
     return buffer;
 }
 
+void * TryReadBinaryFile( char * filename, size_t * fileLength ) {
+/*
+====================
+=
+= TryReadBinaryFile
+=
+= Reads a whole binary file into a buffer that is allocated dynamically and returned, or returns NULL if the file can't
+= be opened or read, e.g. because another process just removed it.
+=
+= This buffer must be freed by the caller after use to avoid a leak.
+=
+= The fileLength pointer is filled with the length of the buffer.
+=
+====================
+*/
+
+    char *  buffer;
+    FILE *  fp = fopen( filename, "rb" );
+    long    bufferSize;
+
+    if ( fp == NULL ) {
+        return NULL;
+    }
+
+    if ( fseek( fp, 0, SEEK_END ) != 0 || ( bufferSize = ftell( fp ) ) == -1 ) {
+        fclose( fp );
+        return NULL;
+    }
+
+    // One extra byte so that empty files still get a valid buffer.
+    if ( ( buffer = malloc( bufferSize + 1 ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    fseek( fp, 0, SEEK_SET );
+
+    *fileLength = fread( buffer, 1, bufferSize, fp );
+
+    if ( ferror( fp ) != 0 ) {
+        fclose( fp );
+        free( buffer );
+        return NULL;
+    }
+
+    fclose( fp );
+
+    return buffer;
+}
+
+void * ReadBinaryFile( char * filename, size_t * fileLength ) {
+/*
+====================
+=
+= ReadBinaryFile
+=
+= Reads a whole binary file into a buffer that is allocated dynamically and returned.
+=
+= This buffer must be freed by the caller after use to avoid a leak.
+=
+= The fileLength pointer is filled with the length of the buffer.
+=
+====================
+*/
+
+    void * buffer = TryReadBinaryFile( filename, fileLength );
+
+    if ( buffer == NULL ) {
+        perror( filename );
+        exit( 1 );
+    }
+
+    return buffer;
+}
+
+void * TryMapFile( char * filename, size_t * fileLength ) {
+/*
+====================
+=
+= TryMapFile
+=
+= Maps a whole file into memory read-only like MapFile, but returns NULL instead of ending the program if the file
+= can't be opened or mapped, e.g. because another process just removed it.
+=
+====================
+*/
+
+#ifdef _WIN32
+    return TryReadBinaryFile( filename, fileLength );
+#else
+    int          descriptor = open( filename, O_RDONLY );
+    struct stat  status;
+    void *       mapping;
+
+    if ( descriptor == -1 ) {
+        return NULL;
+    }
+
+    if ( fstat( descriptor, &status ) == -1 ) {
+        close( descriptor );
+        return NULL;
+    }
+
+    *fileLength = status.st_size;
+
+    // Empty files can't be mapped, they still get a valid pointer.
+    if ( *fileLength == 0 ) {
+        close( descriptor );
+
+        if ( ( mapping = malloc( 1 ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+
+        return mapping;
+    }
+
+    mapping = mmap( NULL, *fileLength, PROT_READ, MAP_PRIVATE, descriptor, 0 );
+    close( descriptor );
+
+    return mapping == MAP_FAILED ? NULL : mapping;
+#endif
+}
+
+void * MapFile( char * filename, size_t * fileLength ) {
+/*
+====================
+=
+= MapFile
+=
+= Maps a whole file into memory read-only, the mapping must be released with UnmapFile.
+=
+= Where memory mapping is not available the file is read into a buffer with ReadBinaryFile instead.
+=
+= The fileLength pointer is filled with the length of the file.
+=
+====================
+*/
+
+    void * mapping = TryMapFile( filename, fileLength );
+
+    if ( mapping == NULL ) {
+        perror( filename );
+        exit( 1 );
+    }
+
+    return mapping;
+}
+
+void UnmapFile( void * mapping, size_t fileLength ) {
+/*
+====================
+=
+= UnmapFile
+=
+= Releases a file mapped with MapFile.
+=
+====================
+*/
+
+#ifdef _WIN32
+    ( void )fileLength;
+    free( mapping );
+#else
+    if ( fileLength == 0 ) {
+        free( mapping );
+    } else {
+        munmap( mapping, fileLength );
+    }
+#endif
+}
+
+#ifndef _WIN32
+bool WriteAt( int descriptor, const void * data, size_t size, off_t offset ) {
+/*
+====================
+=
+= WriteAt
+=
+= Writes size bytes to an open file at offset, without moving its position, so that many threads can write different
+= parts of the same file at once.
+=
+= Returns false on a write error.
+=
+====================
+*/
+
+    ssize_t written;
+
+    while ( size > 0 ) {
+        if ( ( written = pwrite( descriptor, data, size, offset ) ) <= 0 ) {
+            return false;
+        }
+
+        data = ( const char * )data + written;
+        size -= written;
+        offset += written;
+    }
+
+    return true;
+}
+#endif
+
 int RemoveBackslashNewline( char * string, int * size ) {
 /*
 ====================
@@ -84,7 +294,7 @@ int RemoveBackslashNewline( char * string, int * size ) {
 
     while ( *seeker != '\0' ) {
         if ( *seeker == '\\' && *( seeker + 1 ) == '\n' ) {
-            memcpy( seeker, seeker + 2, --charsRemaining );
+            memmove( seeker, seeker + 2, --charsRemaining );
             ( *size ) -= 2;
         } else {
             seeker++;
@@ -101,7 +311,7 @@ int RemoveDel( char * string, int * size ) {
 
     while ( *seeker != '\0' ) {
         if ( *seeker == 0x7F ) {
-            memcpy( seeker, seeker + 1, charsRemaining );
+            memmove( seeker, seeker + 1, charsRemaining );
             ( *size ) -= 1;
         } else {
             seeker++;
@@ -1,3 +1,18 @@
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
 void * ReadFileIntoBuffer( char * filename, int * fileLength );
+void * TryReadBinaryFile( char * filename, size_t * fileLength );
+void * ReadBinaryFile( char * filename, size_t * fileLength );
+void * TryMapFile( char * filename, size_t * fileLength );
+void * MapFile( char * filename, size_t * fileLength );
+void UnmapFile( void * mapping, size_t fileLength );
+#ifndef _WIN32
+bool WriteAt( int descriptor, const void * data, size_t size, off_t offset );
+#endif
 int RemoveBackslashNewline( char * string, int * size );
 int RemoveDel( char * string, int * size );
\ No newline at end of file
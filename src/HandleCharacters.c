@@ -9,6 +9,7 @@
 #include "Tokens.h"
 #include "IdentifierCharacters.h"
 #include "CharacterConstants.h"
+#include "Diagnostic.h"
 
 /*
 This function-like macro compares 2 strings up to 8 characters (excluding null) about five times faster than memcmp.
@@ -45,6 +46,30 @@ Invalid characters
 ==================
 */
 
+char * PushErrorToken( tokenList_t * tokens, char * start, char * end ) {
+/*
+====================
+=
+= PushErrorToken
+=
+= Pushes the bytes from start to end as an error token, which is how the recovery mode of the lexer keeps the input it
+= could not make sense of, one byte per payload word.
+=
+= Returns end, where the lexer carries on.
+=
+====================
+*/
+
+    PushToken( tokens, ERROR_TOKEN );
+    PushToken( tokens, end - start );
+
+    for ( char * tracer = start; tracer < end; tracer++ ) {
+        PushToken( tokens, ( unsigned char )*tracer );
+    }
+
+    return end;
+}
+
 char * _HandleInvalid( char * slice, tokenList_t * tokens, symbolTable_t * symbolTable ) {
 /*
 ====================
@@ -53,15 +78,22 @@ char * _HandleInvalid( char * slice, tokenList_t * tokens, symbolTable_t * symbo
 =
 = Handles invalid characters that shouldn't be in the source file outsize of certain literals.
 =
+= When the error is recovered from the character is skipped whole, with the continuation bytes of a UTF-8 character.
+=
 ====================
 */
     
-    fputs( "Invalid character located.", stderr );
-    exit( 1 );
+    char * end = slice + 1;
+
+    RaiseError( slice, INVALID_CHARACTER_ERROR, "Invalid character located." );
+
+    while ( ( ( unsigned char )*end & 0xC0 ) == 0x80 ) {
+        end++;
+    }
+
+    return PushErrorToken( tokens, slice, end );
     
     // Avoid warnings about unused variables
-    ( void )slice;
-    ( void )tokens;
     ( void )symbolTable;
 }
 
@@ -176,13 +208,13 @@ char * _HandleDoubleQuotes( char * slice, tokenList_t * tokens, symbolTable_t *
 ====================
 */   
     int            length;
-    tokenNode_t *  lengthNode;
+    size_t         lengthIndex;
     
     PushToken( tokens, CHARACTER_STRING_LITERAL_TOKEN );
-    lengthNode = PushToken( tokens, 0 );
+    lengthIndex = PushToken( tokens, 0 );
     slice = HandleStringLiteral( slice + 1, &length, tokens );
 
-    lengthNode->token = length;
+    tokens->tokens[ lengthIndex ] = length;
 
     return slice + 1;
 
@@ -204,6 +236,8 @@ char * _HandleHash( char * slice, tokenList_t * tokens, symbolTable_t * symbolTa
 ====================
 */
 
+    char * hash = slice;
+
     // ##
     if ( *( slice + 1 ) == '#' ) {
         PushToken( tokens, TokenHash( slice, 2 ) );
@@ -268,8 +302,8 @@ char * _HandleHash( char * slice, tokenList_t * tokens, symbolTable_t * symbolTa
             slice += 5;
         }
 
-        // Push whitespace character before header name
-        while ( *slice != '<' && *slice != '\"' ) {
+        // Push whitespace character before header name, an unterminated directive ends with the source.
+        while ( *slice != '<' && *slice != '\"' && *slice != '\0' ) {
             PushToken( tokens, *slice );
             slice++;
         }
@@ -284,16 +318,16 @@ char * _HandleHash( char * slice, tokenList_t * tokens, symbolTable_t * symbolTa
         
         slice++;
 
-        tokenNode_t *  lengthNode = PushToken( tokens, 0x00000000 );
+        size_t         lengthIndex = PushToken( tokens, 0x00000000 );
         size_t         length = 0;
 
-        while ( headerCharSequenceType == Q_CHAR_SEQUENCE ? *slice != '\"' : *slice != '>' ) {
+        while ( ( headerCharSequenceType == Q_CHAR_SEQUENCE ? *slice != '\"' : *slice != '>' ) && *slice != '\0' ) {
             slice = HandleUTF8Character( slice, &character );
             PushToken( tokens, character );
             length++;
         }
 
-        lengthNode->token = length;
+        tokens->tokens[ lengthIndex ] = length;
         
     // #define
     } else if ( STR_8_EQUAL( slice, "\0\0define", 6 ) ) {
@@ -320,14 +354,16 @@ char * _HandleHash( char * slice, tokenList_t * tokens, symbolTable_t * symbolTa
         PushToken( tokens, PRAGMA_PREPROCESSING_DIRECTIVE_TOKEN );
         return slice + 6;
     } else {
-        int length = 1; // length is initialized at 1 so the # doesn't get caught as an invalid identifier character.
+        int length = 0; // slice is already past the # and the spaces after it.
 
         while ( validIdentifierCharacter[ ( unsigned char )slice[ length ] ] ) {
             length++;
         }
         
-        fprintf( stderr, "Unrecognized preprocessing directive: %.*s is among them.", length, slice );
-        exit( 1 );
+        RaiseError( slice, UNKNOWN_DIRECTIVE_ERROR, "Unrecognized preprocessing directive: %.*s is among them.", length, slice );
+
+        // The directive is kept as it was written, from the hash to the end of its name.
+        return PushErrorToken( tokens, hash, slice + length );
     }
 
     return slice + 1;
@@ -637,7 +673,7 @@ char * _HandleSlash( char * slice, tokenList_t * tokens, symbolTable_t * symbolT
         // Find and return the position of the newline.
         slice += 2;
 
-        while ( *slice != '\n' ) {
+        while ( *slice != '\n' && *slice != '\0' ) {
             slice++;
         }
 
@@ -651,6 +687,11 @@ char * _HandleSlash( char * slice, tokenList_t * tokens, symbolTable_t * symbolT
         slice += 2;
         
         while ( !( *slice == '*' && *( slice + 1 ) == '/' ) ) {
+            // Unterminated comment, it ends with the file.
+            if ( *slice == '\0' ) {
+                return slice;
+            }
+
             slice++;
         }
 
@@ -892,13 +933,13 @@ char * _HandleCapitalL( char * slice, tokenList_t * tokens, symbolTable_t * symb
         return next + 1;
     } else if ( *( slice + 1 ) == '\"' ) {
         int            length;
-        tokenNode_t *  lengthNode;
+        size_t         lengthIndex;
         
         PushToken( tokens, WCHAR_UNDERSCORE_T_STRING_LITERAL_TOKEN );
-        lengthNode = PushToken( tokens, 0 );
+        lengthIndex = PushToken( tokens, 0 );
         next = HandleStringLiteral( slice + 2, &length, tokens );
 
-        lengthNode->token = length;
+        tokens->tokens[ lengthIndex ] = length;
 
         return next + 1;
     } else {
@@ -933,13 +974,13 @@ char * _HandleCapitalU( char * slice, tokenList_t * tokens, symbolTable_t * symb
         return next + 1;
     } else if ( *( slice + 1 ) == '\"' ) {
         int            length;
-        tokenNode_t *  lengthNode;
+        size_t         lengthIndex;
         
         PushToken( tokens, UTF_32_STRING_LITERAL_TOKEN );
-        lengthNode = PushToken( tokens, 0 );
+        lengthIndex = PushToken( tokens, 0 );
         slice = HandleStringLiteral( slice + 2, &length, tokens );
 
-        lengthNode->token = length;
+        tokens->tokens[ lengthIndex ] = length;
 
         return slice + 1;
     } else {
@@ -1641,13 +1682,13 @@ char * _HandleSmallU( char * slice, tokenList_t * tokens, symbolTable_t * symbol
     // UTF-16 string literals
     } else if ( *( slice + 1 ) == '\"' ) {
         int            length;
-        tokenNode_t *  lengthNode;
+        size_t         lengthIndex;
         
         PushToken( tokens, UTF_16_STRING_LITERAL_TOKEN );
-        lengthNode = PushToken( tokens, 0 );
+        lengthIndex = PushToken( tokens, 0 );
         next = HandleStringLiteral( slice + 2, &length, tokens );
 
-        lengthNode->token = length;
+        tokens->tokens[ lengthIndex ] = length;
 
         return next + 1;
     // UTF-8
@@ -1662,13 +1703,13 @@ char * _HandleSmallU( char * slice, tokenList_t * tokens, symbolTable_t * symbol
         // UTF-8 string literals
         } else if ( *( slice + 2 ) == '\"' ) {
             int            length;
-            tokenNode_t *  lengthNode;
+            size_t         lengthIndex;
             
             PushToken( tokens, CHARACTER_STRING_LITERAL_TOKEN );
-            lengthNode = PushToken( tokens, 0 );
+            lengthIndex = PushToken( tokens, 0 );
             next = HandleStringLiteral( slice + 3, &length, tokens );
 
-            lengthNode->token = length;
+            tokens->tokens[ lengthIndex ] = length;
 
             return next + 1;
         } else {
@@ -1858,6 +1899,29 @@ Other
 =====
 */
 
+char * SkipPreprocessingNumber( char * slice ) {
+/*
+====================
+=
+= SkipPreprocessingNumber
+=
+= Returns the end of the preprocessing number at slice, the digits, letters, dots and exponent signs that make up a
+= constant, valid or not.
+=
+====================
+*/
+
+    do {
+        if ( ( *slice == 'e' || *slice == 'E' || *slice == 'p' || *slice == 'P' ) && ( *( slice + 1 ) == '+' || *( slice + 1 ) == '-' ) ) {
+            slice++;
+        }
+
+        slice++;
+    } while ( validIdentifierCharacter[ ( unsigned char )*slice ] || *slice == '.' || *slice == '\'' );
+
+    return slice;
+}
+
 char * _HandleConstant( char * slice, tokenList_t * tokens, symbolTable_t * symbolTable ) {
     char *       tracer = slice;
     bool         isFloat = false;
@@ -1951,6 +2015,8 @@ char * _HandleConstant( char * slice, tokenList_t * tokens, symbolTable_t * symb
     }
 
     if ( isFloat ) {
+        // The padding bytes of the long double end up in the tokens, keep them zero so the output is reproducible.
+        memset( &ldConstant, 0, sizeof( long double ) );
         ldConstant = strtold( number, NULL );
     } else {
         static_assert( sizeof( unsigned long long ) >= 8, "A 64-bit value does not fit in an unsigned long long" );
@@ -2120,8 +2186,8 @@ char * _HandleConstant( char * slice, tokenList_t * tokens, symbolTable_t * symb
                     return end + 2;
                 }
                 #else
-                fputs( "_DecimalN floats are currently unsupported.\n", stderr );
-                exit( 1 );
+                RaiseError( slice, INVALID_CONSTANT_ERROR, "_DecimalN floats are currently unsupported." );
+                return PushErrorToken( tokens, slice, SkipPreprocessingNumber( slice ) );
                 #endif
             }
         // Unsuffixed float constants have type double
@@ -2135,8 +2201,9 @@ char * _HandleConstant( char * slice, tokenList_t * tokens, symbolTable_t * symb
         }
     }
 
-    fputs( "Invalid constant detected.\n", stderr );
-    exit( 1 );
+    RaiseError( slice, INVALID_CONSTANT_ERROR, "Invalid constant detected." );
+
+    return PushErrorToken( tokens, slice, SkipPreprocessingNumber( slice ) );
 
     // Avoid unused variable warning
     ( void )symbolTable;
@@ -2195,32 +2262,32 @@ char * _HandleIdentifier( char * slice, tokenList_t * tokens, symbolTable_t * sy
                 *pos = '\0';
                 ucnExpectedLength = 8;
             } else {
-                fprintf( stderr, "Invalid identifier located: %.*s\n", ( int )length, slice );
-                exit( 1 );
+                RaiseError( slice, INVALID_IDENTIFIER_ERROR, "Invalid identifier located: %.*s", ( int )length, slice );
+                return PushErrorToken( tokens, slice, slice + length );
             }
             
             ucnValue = strtol( &( slice[ i + 2 ] ), &end, 16 );
             *pos = floating;
             
             if ( end < pos ) {
-                fprintf( stderr, "Invalid universal character name in identifier %.*s (%.*s): universal character name is too short at %d characters, %d are expected.\n", ( int )length, slice, ( int )( end - &( slice[ i ] ) ), &( slice[ i ] ), ( int )( end - &( slice[ i ] ) ) - 2, ucnExpectedLength );
-                exit( 1 );
+                RaiseError( slice, INVALID_IDENTIFIER_ERROR, "Invalid universal character name in identifier %.*s (%.*s): universal character name is too short at %d characters, %d are expected.", ( int )length, slice, ( int )( end - &( slice[ i ] ) ), &( slice[ i ] ), ( int )( end - &( slice[ i ] ) ) - 2, ucnExpectedLength );
+                return PushErrorToken( tokens, slice, slice + length );
             }
             
             if ( ucnValue == 0 ) {
-                fprintf( stderr, "Invalid universal character name in identifier %.*s: %.*s.\n", ( int )length, slice, ( int )( pos - &( slice[ i ] ) ), &( slice[ i ] ) );
-                exit( 1 );
+                RaiseError( slice, INVALID_IDENTIFIER_ERROR, "Invalid universal character name in identifier %.*s: %.*s.", ( int )length, slice, ( int )( pos - &( slice[ i ] ) ), &( slice[ i ] ) );
+                return PushErrorToken( tokens, slice, slice + length );
             }
             
             if ( ucnValue < 0x00A0 && !( ucnValue == 0x0024 || ucnValue == 0x0040 || ucnValue == 0x0060 ) ) {
-                fprintf( stderr, "Invalid universal character name in identifier %.*s (%.*s): universal character names in identifiers below 0x00A0, other than 0x0024 ($), 0x0040 (@) and 0x0060 (`), are not allowed.\n", ( int )length, slice, ( int )( pos - &( slice[ i ] ) ), &( slice[ i ] ) );
-                exit( 1 );
+                RaiseError( slice, INVALID_IDENTIFIER_ERROR, "Invalid universal character name in identifier %.*s (%.*s): universal character names in identifiers below 0x00A0, other than 0x0024 ($), 0x0040 (@) and 0x0060 (`), are not allowed.", ( int )length, slice, ( int )( pos - &( slice[ i ] ) ), &( slice[ i ] ) );
+                return PushErrorToken( tokens, slice, slice + length );
             } else if ( ucnValue >= 0xD800 && ucnValue <= 0xDFFF ) {
-                fprintf( stderr, "Invalid universal character name in identifier %.*s (%.*s): universal character names in identifiers with values in range 0xD800 to 0xDFFF inclusive are not allowed.\n", ( int )length, slice, ( int )( pos - &( slice[ i ] ) ), &( slice[ i ] ) );
-                exit( 1 );
+                RaiseError( slice, INVALID_IDENTIFIER_ERROR, "Invalid universal character name in identifier %.*s (%.*s): universal character names in identifiers with values in range 0xD800 to 0xDFFF inclusive are not allowed.", ( int )length, slice, ( int )( pos - &( slice[ i ] ) ), &( slice[ i ] ) );
+                return PushErrorToken( tokens, slice, slice + length );
             } else if ( ucnValue > 0x10FFFF ) {
-                fprintf( stderr, "Invalid universal character name in identifier %.*s (%.*s): universal character names in identifiers with values greater than 0x10FFFF are not allowed.\n", ( int )length, slice, ( int )( pos - &( slice[ i ] ) ), &( slice[ i ] ) );
-                exit( 1 );
+                RaiseError( slice, INVALID_IDENTIFIER_ERROR, "Invalid universal character name in identifier %.*s (%.*s): universal character names in identifiers with values greater than 0x10FFFF are not allowed.", ( int )length, slice, ( int )( pos - &( slice[ i ] ) ), &( slice[ i ] ) );
+                return PushErrorToken( tokens, slice, slice + length );
             }
 
             i += pos - &( slice[ i ] ) - 1;
@@ -2268,5 +2335,6 @@ char * _HandleDel( char * slice, tokenList_t * tokens, symbolTable_t * symbolTab
 }
 
 // The characterFunctions definition. The functions 45 through 126 have not yet been added.
-char *  ( * const characterFunctions[ 128 ] )( char * slice, tokenList_t * tokens, symbolTable_t * symbolTable ) = { _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleWhiteSpace, _HandleWhiteSpace, _HandleWhiteSpace, _HandleInvalid, _HandleCarriageReturn, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleWhiteSpace, _HandleExclamationMark, _HandleDoubleQuotes, _HandleHash, _HandleInvalid, _HandlePercent, _HandleAmpersand, _HandleApostrophe, _HandleOpeningParenthesis, _HandleClosingParenthesis, _HandleAsterisk, _HandlePlus, _HandleComma, _HandleMinus, _HandleDot, _HandleSlash, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleColon, _HandleSemicolon, _HandleLess, _HandleEqual, _HandleGreater, _HandleQuestionMark, _HandleInvalid, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleCapitalL, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleCapitalU, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleOpeningBrackets, _HandleIdentifier, _HandleClosingBrackets, _HandleCaret, _HandleUnderscore, _HandleInvalid, _HandleSmallA, _HandleSmallB, _HandleSmallC, _HandleSmallD, _HandleSmallE, _HandleSmallF, _HandleSmallG, _HandleIdentifier, _HandleSmallI, _HandleIdentifier, _HandleIdentifier, _HandleSmallL, _HandleIdentifier, _HandleSmallN, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleSmallR, _HandleSmallS, _HandleSmallT, _HandleSmallU, _HandleSmallV, _HandleSmallW, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleOpeningBraces, _HandleVerticalLine, _HandleClosingBraces, _HandleTilde, _HandleInvalid };
+// Bytes past ASCII are all invalid, so that any byte read from a file can index it.
+char *  ( * const characterFunctions[ 256 ] )( char * slice, tokenList_t * tokens, symbolTable_t * symbolTable ) = { _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleWhiteSpace, _HandleWhiteSpace, _HandleWhiteSpace, _HandleInvalid, _HandleCarriageReturn, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleWhiteSpace, _HandleExclamationMark, _HandleDoubleQuotes, _HandleHash, _HandleInvalid, _HandlePercent, _HandleAmpersand, _HandleApostrophe, _HandleOpeningParenthesis, _HandleClosingParenthesis, _HandleAsterisk, _HandlePlus, _HandleComma, _HandleMinus, _HandleDot, _HandleSlash, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleConstant, _HandleColon, _HandleSemicolon, _HandleLess, _HandleEqual, _HandleGreater, _HandleQuestionMark, _HandleInvalid, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleCapitalL, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleCapitalU, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleOpeningBrackets, _HandleIdentifier, _HandleClosingBrackets, _HandleCaret, _HandleUnderscore, _HandleInvalid, _HandleSmallA, _HandleSmallB, _HandleSmallC, _HandleSmallD, _HandleSmallE, _HandleSmallF, _HandleSmallG, _HandleIdentifier, _HandleSmallI, _HandleIdentifier, _HandleIdentifier, _HandleSmallL, _HandleIdentifier, _HandleSmallN, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleSmallR, _HandleSmallS, _HandleSmallT, _HandleSmallU, _HandleSmallV, _HandleSmallW, _HandleIdentifier, _HandleIdentifier, _HandleIdentifier, _HandleOpeningBraces, _HandleVerticalLine, _HandleClosingBraces, _HandleTilde, _HandleInvalid , _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid, _HandleInvalid };
                                                                                                                        // NULL             SOH             STX             ETX             EOT             ENQ             ACK             BEL             BS               HT                 LF                  VT               FF                 CR                  SO              SI              DLE             DC1             DC2             DC3             DC4             NAK             SYN             ETB             CAN             EM              SUB             ESC             FS              GS              RS              US              space                  !                      "                #              $               %               &                  '                      (                          )                     *              +             ,             -           .            /               0                1                2                3                4                5                6                7                8                9              :               ;               <            =               >                  ?                 @                A                  B                  C                  D                  E                  F                  G                  H                  I                  J                  K                 L                 M                  N                  O                  P                  Q                  R                  S                  T                 U                 V                  W                  X                  Y                  Z                    [                     \                    ]                  ^                _                 `              a              b              c              d              e              f              g                h                i                j                  k               l                m                n                o                  p                  q                r              s              t              u              v              w                x                  y                  z                   {                     |                    }                 ~              DEL
\ No newline at end of file
@@ -1 +1 @@
-extern char * ( *characterFunctions[ 128 ] )();
\ No newline at end of file
+extern char * ( *characterFunctions[ 256 ] )();
\ No newline at end of file
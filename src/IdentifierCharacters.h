@@ -1,4 +1,4 @@
 #include <stdbool.h>
 
 extern bool validIdentifierStartCharacter[ 128 ];
-extern bool validIdentifierCharacter[ 128 ];
\ No newline at end of file
+extern bool validIdentifierCharacter[ 256 ];
\ No newline at end of file
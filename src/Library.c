@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "OutputBuffer.h"
+#include "File.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
+#include "HandleCharacters.h"
+#include "Decompose.h"
+#include "Recompose/Recompose.h"
+#include "Library.h"
+
+/*
+The library entry points work on memory only and never end the program: every error is trapped and returned as a status
+code, with the reason pushed to a diagnostic list. They can be called from any number of threads at once, as long as
+each thread uses its own lexer contexts and token lists.
+
+They are what an editor or a build tool links against, lexing its own buffers without a process or a temporary file
+per source.
+*/
+
+bool CopySource( char ** copy, size_t * capacity, const char * buffer, size_t length, bool punchCardExtension, int * sourceLength, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= CopySource
+=
+= Copies length bytes of C source at buffer to *copy, growing it to fit if *capacity is too small, and does the
+= translation phases 1 and 2 on the copy like ReadSource does on a file. sourceLength is filled with the length left.
+=
+= Returns false with the error pushed to diagnostics, if it is not NULL, when the buffer can't be copied.
+=
+====================
+*/
+
+    char *  source;
+
+    if ( length > INT_MAX - BUFFER_SLACK - 1 ) {
+        if ( diagnostics != NULL ) {
+            PushDiagnostic( diagnostics, INPUT_TOO_LARGE_ERROR, NO_OFFSET, "Buffer too large to lex." );
+        }
+
+        return false;
+    }
+
+    if ( length + BUFFER_SLACK + 1 > *capacity ) {
+        if ( ( source = realloc( *copy, length + BUFFER_SLACK + 1 ) ) == NULL ) {
+            if ( diagnostics != NULL ) {
+                PushDiagnostic( diagnostics, OUT_OF_MEMORY_ERROR, NO_OFFSET, "Out of memory." );
+            }
+
+            return false;
+        }
+
+        *copy = source;
+        *capacity = length + BUFFER_SLACK + 1;
+    }
+
+    source = *copy;
+    memcpy( source, buffer, length );
+    memset( source + length, '\0', BUFFER_SLACK + 1 );
+    *sourceLength = length;
+
+    if ( punchCardExtension ) {
+        RemoveDel( source, sourceLength );
+    }
+
+    RemoveBackslashNewline( source, sourceLength );
+
+    return true;
+}
+
+lexerStatus_t LexBuffer( lexerContext_t * context, const char * buffer, size_t length, bool punchCardExtension, bool recover, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= LexBuffer
+=
+= Lexes length bytes of C source at buffer into a lexer context, which is reset first. The buffer is left untouched, a
+= copy of it that the context keeps for the next call goes through the translation phases 1 to 3 like a file read by
+= Decompose.
+=
+= Returns LEXER_SUCCESS, or LEXER_ERROR with the error pushed to diagnostics if it is not NULL. The offset of a
+= diagnostic is counted in the buffer after its backslash-newlines were removed. After an error the context holds part
+= of the tokens and is only good to be reset or destroyed.
+=
+= With recover set the lexical errors are recovered from, see LexTrapped: the context then holds all the tokens, with
+= error tokens in place of the bad input, and LEXER_RECOVERED is returned.
+=
+====================
+*/
+
+    int  sourceLength;
+
+    ResetLexerContext( context );
+
+    if ( !CopySource( &( context->source ), &( context->sourceCapacity ), buffer, length, punchCardExtension, &sourceLength, diagnostics ) ) {
+        return LEXER_ERROR;
+    }
+
+    return LexTrapped( context->source, sourceLength, &( context->tokens ), &( context->symbolTable ), recover, diagnostics );
+}
+
+bool OpenLexerCursor( lexerCursor_t * cursor, const char * buffer, size_t length, bool punchCardExtension, bool recover, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= OpenLexerCursor
+=
+= Opens a cursor that lexes a copy of length bytes of C source at buffer a few tokens at a time, as they are pulled
+= with NextToken or NextTokens, so that a consumer can lex and parse at once without the whole token list in memory.
+=
+= recover and diagnostics are as in LexBuffer. Returns false with the error pushed to diagnostics, if it is not NULL,
+= when the buffer can't be copied; the cursor must be closed either way.
+=
+====================
+*/
+
+    size_t  capacity = 0;
+
+    cursor->source = NULL;
+    cursor->tokens = InitializeTokenList();
+    cursor->next = 0;
+    cursor->recover = recover;
+    cursor->status = LEXER_SUCCESS;
+    cursor->diagnostics = diagnostics;
+
+    if ( !CopySource( &( cursor->source ), &capacity, buffer, length, punchCardExtension, &( cursor->length ), diagnostics ) ) {
+        cursor->status = LEXER_ERROR;
+        cursor->position = NULL;
+        cursor->symbolTable = ( symbolTable_t ){ NULL, NULL, NULL, NULL };
+
+        return false;
+    }
+
+    cursor->position = cursor->source;
+    cursor->symbolTable = InitializeSymbolTable();
+
+    return true;
+}
+
+bool RefillLexerCursor( lexerCursor_t * cursor ) {
+/*
+====================
+=
+= RefillLexerCursor
+=
+= Lexes the next LEXER_CURSOR_TOKENS or so tokens of a cursor in place of the ones already pulled. The character
+= functions are only called whole, so a token is never split from its payload.
+=
+= Returns false at the end of the source or after an error, which drops the tokens of the refill and sets the status of
+= the cursor to LEXER_ERROR.
+=
+====================
+*/
+
+    errorTrap_t  trap;
+    char *       end = cursor->source + cursor->length;
+
+    cursor->tokens.size = 0;
+    cursor->next = 0;
+
+    if ( cursor->status == LEXER_ERROR ) {
+        return false;
+    }
+
+    SetErrorTrap( &trap, cursor->source, cursor->length, cursor->recover, cursor->diagnostics );
+
+    if ( setjmp( trap.jump ) != 0 ) {
+        cursor->status = LEXER_ERROR;
+        cursor->tokens.size = 0;
+
+        return false;
+    }
+
+    while ( cursor->tokens.size < LEXER_CURSOR_TOKENS && *( cursor->position ) != '\0' && cursor->position < end ) {
+        cursor->position = characterFunctions[ ( unsigned char )*( cursor->position ) ]( cursor->position, &( cursor->tokens ), &( cursor->symbolTable ) );
+    }
+
+    ClearErrorTrap( &trap );
+
+    if ( trap.recovered > 0 ) {
+        cursor->status = LEXER_RECOVERED;
+    }
+
+    return cursor->tokens.size > 0;
+}
+
+bool NextToken( lexerCursor_t * cursor, lexedToken_t * token ) {
+/*
+====================
+=
+= NextToken
+=
+= Pulls the next token of a cursor into token, with its payload and, for identifiers, its name. The payload and the
+= name stay valid until the next call on the cursor.
+=
+= Returns false at the end of the source or after an error, see the status of the cursor to tell them apart.
+=
+====================
+*/
+
+    size_t  words;
+
+    if ( cursor->next >= cursor->tokens.size && !RefillLexerCursor( cursor ) ) {
+        return false;
+    }
+
+    words = TokenWords( &( cursor->tokens ), cursor->next );
+
+    token->token = cursor->tokens.tokens[ cursor->next ];
+    token->payload = cursor->tokens.tokens + cursor->next + 1;
+    token->payloadWords = words - 1;
+    token->name = token->token >= 747 ? cursor->symbolTable.table[ token->token ] : NULL;
+
+    cursor->next += words;
+
+    return true;
+}
+
+size_t NextTokens( lexerCursor_t * cursor, tokenList_t * tokens, size_t count ) {
+/*
+====================
+=
+= NextTokens
+=
+= Pulls up to count tokens of a cursor and appends them to tokens with their payloads, as in a decomposed token list.
+= The identifiers are in the symbol table of the cursor.
+=
+= Returns the number of tokens appended, fewer than count only at the end of the source or after an error. If tokens
+= can't grow the status of the cursor is set to LEXER_ERROR, and the last token appended may lack part of its payload.
+=
+====================
+*/
+
+    errorTrap_t      trap;
+    volatile size_t  pulled = 0;
+    size_t           words;
+
+    // Only growing tokens can fail here, the lexing errors are trapped by the refills.
+    SetErrorTrap( &trap, NULL, 0, false, cursor->diagnostics );
+
+    if ( setjmp( trap.jump ) != 0 ) {
+        cursor->status = LEXER_ERROR;
+
+        return pulled;
+    }
+
+    while ( pulled < count ) {
+        if ( cursor->next >= cursor->tokens.size && !RefillLexerCursor( cursor ) ) {
+            break;
+        }
+
+        words = TokenWords( &( cursor->tokens ), cursor->next );
+
+        for ( size_t i = 0; i < words; i++ ) {
+            PushToken( tokens, cursor->tokens.tokens[ cursor->next + i ] );
+        }
+
+        cursor->next += words;
+        pulled++;
+    }
+
+    ClearErrorTrap( &trap );
+
+    return pulled;
+}
+
+void CloseLexerCursor( lexerCursor_t * cursor ) {
+    if ( cursor->symbolTable.table != NULL ) {
+        DestroySymbolTable( cursor->symbolTable );
+    }
+
+    DestroyTokenList( cursor->tokens );
+    free( cursor->source );
+}
+
+bool CheckTokens( tokenList_t * tokens, symbolTable_t * symbolTable, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= CheckTokens
+=
+= Checks that a token list can be recomposed: every token is known, every identifier is in symbolTable and no payload
+= goes past the end of the list.
+=
+= Returns false after pushing the first problem found to diagnostics, if it is not NULL.
+=
+====================
+*/
+
+    char    message[ DIAGNOSTIC_MESSAGE_SIZE ];
+    size_t  words;
+    token_t token;
+
+    for ( size_t position = 0; position < tokens->size; position += words + 1 ) {
+        token = tokens->tokens[ position ];
+
+        if ( token >= SYMBOL_TABLE_SIZE ) {
+            snprintf( message, DIAGNOSTIC_MESSAGE_SIZE, "Unknown token %u.", token );
+        } else if ( token >= 747 && symbolTable->table[ token ] == NULL ) {
+            snprintf( message, DIAGNOSTIC_MESSAGE_SIZE, "Identifier %u is not in the symbol table.", token );
+        } else {
+            if ( TokenPayload( token, &words ) == CHARACTER_SEQUENCE_PAYLOAD && position + 1 < tokens->size ) {
+                words += tokens->tokens[ position + 1 ];
+            }
+
+            if ( words < tokens->size - position ) {
+                continue;
+            }
+
+            snprintf( message, DIAGNOSTIC_MESSAGE_SIZE, "Token %u is cut short by the end of the list.", token );
+        }
+
+        if ( diagnostics != NULL ) {
+            PushDiagnostic( diagnostics, INVALID_TOKEN_ERROR, position, message );
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+lexerStatus_t RecomposeBuffer( tokenList_t * tokens, symbolTable_t * symbolTable, outputBuffer_t * output, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= RecomposeBuffer
+=
+= Recomposes a series of tokens into output, taking the identifier spellings from a symbol table. output is usually a
+= memory buffer, made with InitializeOutputBuffer( NULL ), that the recomposed source is appended to.
+=
+= The tokens are checked before anything is written. Returns LEXER_SUCCESS, or LEXER_ERROR with the error pushed to
+= diagnostics if it is not NULL; the offset of a diagnostic is then the position of the token in the list.
+=
+====================
+*/
+
+    errorTrap_t    trap;
+    chartCursor_t  chart;
+    token_t        hash;
+
+    if ( !CheckTokens( tokens, symbolTable, diagnostics ) ) {
+        return LEXER_ERROR;
+    }
+
+    SetErrorTrap( &trap, NULL, 0, false, diagnostics );
+
+    if ( setjmp( trap.jump ) != 0 ) {
+        DestroyTokenMeaning();
+        return LEXER_ERROR;
+    }
+
+    chart = InitializeChartCursor( symbolTable->chart );
+
+    while ( ReadChart( &chart, 1, &hash ) ) {
+        SetTokenMeaning( hash, symbolTable->table[ hash ], strlen( symbolTable->table[ hash ] ) );
+    }
+
+    RecomposeToBuffer( tokens, output );
+    DestroyTokenMeaning();
+
+    ClearErrorTrap( &trap );
+
+    return LEXER_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+#include <stdbool.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "OutputBuffer.h"
+#include "Diagnostic.h"
+#include "Decompose.h"
+
+// Zeroed bytes after the copy of a buffer, the character functions read a few bytes ahead.
+#define BUFFER_SLACK 64
+
+// Tokens lexed at once by a lexer cursor, more when the last character function called pushes several.
+#ifndef LEXER_CURSOR_TOKENS
+#define LEXER_CURSOR_TOKENS 256
+#endif
+
+typedef struct {
+    char *              source;
+    int                 length;
+    char *              position;
+    tokenList_t         tokens;
+    size_t              next;
+    symbolTable_t       symbolTable;
+    bool                recover;
+    lexerStatus_t       status;
+    diagnosticList_t *  diagnostics;
+} lexerCursor_t;
+
+typedef struct {
+    token_t          token;
+    const token_t *  payload;
+    size_t           payloadWords;
+    const char *     name;
+} lexedToken_t;
+
+bool CopySource( char ** copy, size_t * capacity, const char * buffer, size_t length, bool punchCardExtension, int * sourceLength, diagnosticList_t * diagnostics );
+lexerStatus_t LexBuffer( lexerContext_t * context, const char * buffer, size_t length, bool punchCardExtension, bool recover, diagnosticList_t * diagnostics );
+bool OpenLexerCursor( lexerCursor_t * cursor, const char * buffer, size_t length, bool punchCardExtension, bool recover, diagnosticList_t * diagnostics );
+bool NextToken( lexerCursor_t * cursor, lexedToken_t * token );
+size_t NextTokens( lexerCursor_t * cursor, tokenList_t * tokens, size_t count );
+void CloseLexerCursor( lexerCursor_t * cursor );
+lexerStatus_t RecomposeBuffer( tokenList_t * tokens, symbolTable_t * symbolTable, outputBuffer_t * output, diagnosticList_t * diagnostics );
+#endif
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include "OutputBuffer.h"
+#include "Diagnostic.h"
+
+outputBuffer_t InitializeOutputBuffer( FILE * file ) {
+/*
+====================
+=
+= InitializeOutputBuffer
+=
+= Initializes the outputBuffer_t data structure.
+=
+= Everything pushed to the buffer is written to file in OUTPUT_BUFFER_SIZE sized writes, instead of going through
+= stdio on every character.
+=
+= If file is NULL the buffer is a memory buffer instead: it grows as needed and is never flushed, the caller reads the
+= result from the data and size fields before destroying it.
+=
+====================
+*/
+
+    outputBuffer_t  buffer;
+
+    if ( ( buffer.data = malloc( OUTPUT_BUFFER_SIZE ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    buffer.size = 0;
+    buffer.capacity = OUTPUT_BUFFER_SIZE;
+    buffer.file = file;
+    buffer.limit = 0;
+
+    return buffer;
+}
+
+void FlushOutputBuffer( outputBuffer_t * buffer ) {
+/*
+====================
+=
+= FlushOutputBuffer
+=
+= Writes the contents of the buffer to its file and empties the buffer.
+=
+= Memory buffers are left untouched.
+=
+====================
+*/
+
+    if ( buffer->file == NULL ) {
+        return;
+    }
+
+    if ( buffer->size > 0 && fwrite( buffer->data, 1, buffer->size, buffer->file ) < buffer->size ) {
+        RaiseError( NULL, WRITE_ERROR, "Error writing to output file." );
+    }
+
+    buffer->size = 0;
+}
+
+bool ReserveOutputBuffer( outputBuffer_t * buffer, size_t size ) {
+/*
+====================
+=
+= ReserveOutputBuffer
+=
+= Makes room for size more bytes in the buffer, by flushing it or, for memory buffers, by growing it.
+=
+= Returns false if a file buffer can't hold size bytes even after flushing. A memory buffer that would grow past its
+= limit raises an INPUT_TOO_LARGE_ERROR.
+=
+====================
+*/
+
+    size_t  capacity = buffer->capacity;
+    char *  data;
+
+    if ( buffer->capacity - buffer->size >= size ) {
+        return true;
+    }
+
+    if ( buffer->file != NULL ) {
+        FlushOutputBuffer( buffer );
+
+        return buffer->capacity >= size;
+    }
+
+    if ( buffer->limit > 0 && ( buffer->size > buffer->limit || size > buffer->limit - buffer->size ) ) {
+        RaiseError( NULL, INPUT_TOO_LARGE_ERROR, "Output is larger than the limit of %zu bytes.", buffer->limit );
+    }
+
+    while ( capacity - buffer->size < size ) {
+        // Past half of the address space the capacity can't be doubled, and no allocation that large would succeed.
+        if ( capacity > SIZE_MAX / 2 ) {
+            RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+        }
+
+        capacity *= 2;
+    }
+
+    if ( buffer->limit > 0 && capacity > buffer->limit ) {
+        capacity = buffer->limit;
+    }
+
+    // The buffer is left untouched on failure, so that it can still be destroyed if the error is trapped.
+    if ( ( data = realloc( buffer->data, capacity ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+
+    return true;
+}
+
+void PushBytes( outputBuffer_t * buffer, const char * bytes, size_t size ) {
+/*
+====================
+=
+= PushBytes
+=
+= Pushes size bytes to the buffer, flushing it first if they do not fit.
+=
+= Pushes larger than the whole buffer are written directly to the file.
+=
+====================
+*/
+
+    if ( !ReserveOutputBuffer( buffer, size ) ) {
+        if ( fwrite( bytes, 1, size, buffer->file ) < size ) {
+            RaiseError( NULL, WRITE_ERROR, "Error writing to output file." );
+        }
+
+        return;
+    }
+
+    memcpy( buffer->data + buffer->size, bytes, size );
+    buffer->size += size;
+}
+
+void PushByte( outputBuffer_t * buffer, char byte ) {
+    if ( buffer->size == buffer->capacity ) {
+        ReserveOutputBuffer( buffer, 1 );
+    }
+
+    buffer->data[ buffer->size++ ] = byte;
+}
+
+void PushFormatted( outputBuffer_t * buffer, const char * format, ... ) {
+/*
+====================
+=
+= PushFormatted
+=
+= Pushes printf-style formatted output to the buffer.
+=
+= The output is formatted directly into the free space of the buffer, if it does not fit room is made for it and the
+= formatting is retried.
+=
+====================
+*/
+
+    va_list  arguments;
+    va_list  retry;
+    int      length;
+
+    va_start( arguments, format );
+    va_copy( retry, arguments );
+
+    length = vsnprintf( buffer->data + buffer->size, buffer->capacity - buffer->size, format, arguments );
+
+    if ( length >= 0 && ( size_t )length >= buffer->capacity - buffer->size ) {
+        // Even a very long double printed with %Lf is well under OUTPUT_BUFFER_SIZE characters.
+        ReserveOutputBuffer( buffer, length + 1 );
+        length = vsnprintf( buffer->data + buffer->size, buffer->capacity - buffer->size, format, retry );
+    }
+
+    if ( length < 0 ) {
+        fputs( "Error formatting output.\n", stderr );
+        exit( 1 );
+    }
+
+    buffer->size += length;
+
+    va_end( retry );
+    va_end( arguments );
+}
+
+void DestroyOutputBuffer( outputBuffer_t * buffer ) {
+/*
+====================
+=
+= DestroyOutputBuffer
+=
+= Flushes the remaining contents of the buffer and frees it.
+=
+====================
+*/
+
+    FlushOutputBuffer( buffer );
+    free( buffer->data );
+    buffer->data = NULL;
+}
\ No newline at end of file
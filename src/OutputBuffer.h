@@ -0,0 +1,24 @@
+#ifndef OUTPUTBUFFER_H
+#define OUTPUTBUFFER_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define OUTPUT_BUFFER_SIZE ( 1 << 20 )
+
+typedef struct {
+    char *  data;
+    size_t  size;
+    size_t  capacity;
+    FILE *  file;
+    size_t  limit;      // Bytes a memory buffer may grow to, 0 for no limit
+} outputBuffer_t;
+
+outputBuffer_t InitializeOutputBuffer( FILE * file );
+bool ReserveOutputBuffer( outputBuffer_t * buffer, size_t size );
+void PushBytes( outputBuffer_t * buffer, const char * bytes, size_t size );
+void PushByte( outputBuffer_t * buffer, char byte );
+void PushFormatted( outputBuffer_t * buffer, const char * format, ... );
+void FlushOutputBuffer( outputBuffer_t * buffer );
+void DestroyOutputBuffer( outputBuffer_t * buffer );
+#endif
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "OutputBuffer.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
+#include "Rans.h"
+
+/*
+Order-0 rANS coder over bytes, with RANS_STATES interleaved 32-bit states and byte-wise renormalization.
+
+A compressed block is laid out as follows:
+
+    varint               Size of the decoded data
+    varint               Number of symbols with a non-zero frequency
+    byte, varint         Symbol and frequency, for each of those symbols (frequencies add up to RANS_SCALE)
+    4 bytes * states     Final encoder states, state 0 first
+    ...                  Renormalization bytes
+
+Byte i of the data is coded with state i % RANS_STATES. The states are independent of each other, so the decoder loop
+has RANS_STATES independent dependency chains that the CPU (or a vectorizing compiler) can run side by side.
+*/
+
+void NormalizeFrequencies( const size_t * counts, size_t total, uint32_t * frequencies ) {
+/*
+====================
+=
+= NormalizeFrequencies
+=
+= Scales symbol counts to frequencies that add up to RANS_SCALE, keeping every present symbol at least at 1.
+=
+====================
+*/
+
+    uint32_t  sum = 0;
+    int       largest = 0;
+
+    for ( int i = 0; i < 256; i++ ) {
+        if ( counts[ i ] == 0 ) {
+            frequencies[ i ] = 0;
+            continue;
+        }
+
+        frequencies[ i ] = ( uint64_t )counts[ i ] * RANS_SCALE / total;
+
+        if ( frequencies[ i ] == 0 ) {
+            frequencies[ i ] = 1;
+        }
+
+        if ( counts[ i ] > counts[ largest ] ) {
+            largest = i;
+        }
+
+        sum += frequencies[ i ];
+    }
+
+    // The rounding error goes to the most common symbol, where it costs the least.
+    if ( sum < RANS_SCALE ) {
+        frequencies[ largest ] += RANS_SCALE - sum;
+    }
+
+    // Symbols bumped to 1 can push the sum over the scale, take it back from the biggest frequencies.
+    while ( sum > RANS_SCALE ) {
+        int biggest = 0;
+
+        for ( int i = 1; i < 256; i++ ) {
+            if ( frequencies[ i ] > frequencies[ biggest ] ) {
+                biggest = i;
+            }
+        }
+
+        frequencies[ biggest ]--;
+        sum--;
+    }
+}
+
+void RansEncode( const uint8_t * data, size_t size, outputBuffer_t * output ) {
+/*
+====================
+=
+= RansEncode
+=
+= Compresses size bytes of data and pushes the compressed block to output.
+=
+====================
+*/
+
+    size_t     counts[ 256 ] = { 0 };
+    uint32_t   frequencies[ 256 ];
+    uint32_t   starts[ 256 ];
+    uint32_t   states[ RANS_STATES ];
+    uint32_t   symbols = 0;
+    uint8_t *  stream;
+    uint8_t *  position;
+
+    PushVarint( output, size );
+
+    if ( size == 0 ) {
+        PushVarint( output, 0 );
+        return;
+    }
+
+    for ( size_t i = 0; i < size; i++ ) {
+        counts[ data[ i ] ]++;
+    }
+
+    NormalizeFrequencies( counts, size, frequencies );
+
+    // Frequency model
+    for ( int i = 0; i < 256; i++ ) {
+        symbols += frequencies[ i ] != 0;
+    }
+
+    PushVarint( output, symbols );
+
+    for ( uint32_t i = 0, start = 0; i < 256; i++ ) {
+        starts[ i ] = start;
+        start += frequencies[ i ];
+
+        if ( frequencies[ i ] != 0 ) {
+            PushByte( output, i );
+            PushVarint( output, frequencies[ i ] );
+        }
+    }
+
+    // A symbol never takes more than 2 renormalization bytes with a 12-bit scale, the stream is written backwards.
+    if ( ( stream = malloc( size * 2 + RANS_STATES * 4 ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    position = stream + size * 2 + RANS_STATES * 4;
+
+    for ( int i = 0; i < RANS_STATES; i++ ) {
+        states[ i ] = RANS_LOWER_BOUND;
+    }
+
+    // rANS is last in, first out, so the data is encoded from the end for the decoder to read it from the start.
+    for ( size_t i = size; i-- > 0; ) {
+        uint32_t *  state = &states[ i % RANS_STATES ];
+        uint32_t    frequency = frequencies[ data[ i ] ];
+        uint32_t    maximum = ( ( RANS_LOWER_BOUND >> RANS_SCALE_BITS ) << 8 ) * frequency;
+
+        while ( *state >= maximum ) {
+            *--position = *state & 0xFF;
+            *state >>= 8;
+        }
+
+        *state = ( ( *state / frequency ) << RANS_SCALE_BITS ) + ( *state % frequency ) + starts[ data[ i ] ];
+    }
+
+    // Flush the states, state 0 ends up first.
+    for ( int i = RANS_STATES - 1; i >= 0; i-- ) {
+        position -= 4;
+        position[ 0 ] = states[ i ];
+        position[ 1 ] = states[ i ] >> 8;
+        position[ 2 ] = states[ i ] >> 16;
+        position[ 3 ] = states[ i ] >> 24;
+    }
+
+    PushBytes( output, ( char * )position, stream + size * 2 + RANS_STATES * 4 - position );
+
+    free( stream );
+}
+
+bool RansDecode( const uint8_t ** block, const uint8_t * end, uint64_t limit, outputBuffer_t * output ) {
+/*
+====================
+=
+= RansDecode
+=
+= Decompresses the block made by RansEncode at *block and pushes the decoded bytes to output.
+=
+= *block is moved past the block, so consecutive blocks can be decoded one after the other.
+=
+= Returns false if the block is malformed or decodes to more than limit bytes. A model with a single symbol reads no
+= input at all while decoding, so the limit is the only bound on what a few bytes of a block can make.
+=
+====================
+*/
+
+    const uint8_t *  position = *block;
+    uint64_t         decodedSize;
+    uint64_t         symbols;
+    uint64_t         frequency;
+    uint32_t         frequencies[ 256 ] = { 0 };
+    uint32_t         starts[ 256 ];
+    uint8_t          slots[ RANS_SCALE ];
+    uint32_t         states[ RANS_STATES ];
+    uint32_t         sum = 0;
+    char *           decoded;
+
+    if ( !ReadVarint( &position, end, &decodedSize ) || decodedSize > limit || !ReadVarint( &position, end, &symbols ) || symbols > 256 ) {
+        return false;
+    }
+
+    if ( decodedSize == 0 ) {
+        *block = position;
+        return true;
+    }
+
+    // Frequency model
+    for ( uint64_t i = 0; i < symbols; i++ ) {
+        if ( position == end ) {
+            return false;
+        }
+
+        uint8_t symbol = *position++;
+
+        if ( !ReadVarint( &position, end, &frequency ) || frequency == 0 || frequency > RANS_SCALE ) {
+            return false;
+        }
+
+        frequencies[ symbol ] = frequency;
+    }
+
+    for ( int i = 0; i < 256; i++ ) {
+        if ( sum + frequencies[ i ] > RANS_SCALE ) {
+            return false;
+        }
+
+        starts[ i ] = sum;
+        memset( slots + sum, i, frequencies[ i ] );
+        sum += frequencies[ i ];
+    }
+
+    if ( sum != RANS_SCALE || ( size_t )( end - position ) < RANS_STATES * 4 ) {
+        return false;
+    }
+
+    for ( int i = 0; i < RANS_STATES; i++ ) {
+        states[ i ] = position[ 0 ] | position[ 1 ] << 8 | position[ 2 ] << 16 | ( uint32_t )position[ 3 ] << 24;
+        position += 4;
+    }
+
+    ReserveOutputBuffer( output, decodedSize );
+    decoded = output->data + output->size;
+
+    for ( uint64_t i = 0; i < decodedSize; i += RANS_STATES ) {
+        for ( int j = 0; j < RANS_STATES && i + j < decodedSize; j++ ) {
+            uint32_t  slot = states[ j ] & ( RANS_SCALE - 1 );
+            uint8_t   symbol = slots[ slot ];
+
+            decoded[ i + j ] = symbol;
+            states[ j ] = frequencies[ symbol ] * ( states[ j ] >> RANS_SCALE_BITS ) + slot - starts[ symbol ];
+
+            while ( states[ j ] < RANS_LOWER_BOUND ) {
+                if ( position == end ) {
+                    return false;
+                }
+
+                states[ j ] = states[ j ] << 8 | *position++;
+            }
+        }
+    }
+
+    output->size += decodedSize;
+    *block = position;
+
+    return true;
+}
\ No newline at end of file
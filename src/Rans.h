@@ -0,0 +1,14 @@
+#ifndef RANS_H
+#define RANS_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "OutputBuffer.h"
+
+#define RANS_SCALE_BITS 12
+#define RANS_SCALE ( 1 << RANS_SCALE_BITS )
+#define RANS_LOWER_BOUND ( 1u << 23 )
+#define RANS_STATES 4
+
+void RansEncode( const uint8_t * data, size_t size, outputBuffer_t * output );
+bool RansDecode( const uint8_t ** position, const uint8_t * end, uint64_t limit, outputBuffer_t * output );
+#endif
\ No newline at end of file
@@ -1,13 +1,14 @@
 #include <stdio.h>
 #include <inttypes.h>
+#include "../OutputBuffer.h"
 
-void PushUniversalCharacterName( uint32_t character, FILE * outputFile ) {
+void PushUniversalCharacterName( uint32_t character, outputBuffer_t * output ) {
 /*
 ====================
 =
 = PushUniversalCharacterName
 =
-= Pushes a universal character name to the output file.
+= Pushes a universal character name to the output buffer.
 =
 ====================
 */
@@ -24,16 +25,16 @@ void PushUniversalCharacterName( uint32_t character, FILE * outputFile ) {
         significantBytes = 1;
     }
 
-    significantBytes > 2 ? fprintf( outputFile, "\\U%08X", character ) : fprintf( outputFile, "\\u%04X", character );
+    significantBytes > 2 ? PushFormatted( output, "\\U%08X", character ) : PushFormatted( output, "\\u%04X", character );
 }
 
-void PushCharacter( uint32_t character, FILE * outputFile ) {
+void PushCharacter( uint32_t character, outputBuffer_t * output ) {
 /*
 ====================
 =
 = PushCharacter
 =
-= Pushes a character to the output file, either as itself or an escape sequence.
+= Pushes a character to the output buffer, either as itself or an escape sequence.
 =
 ====================
 */
@@ -41,62 +42,62 @@ void PushCharacter( uint32_t character, FILE * outputFile ) {
     // Escape sequences
     switch ( character ) {
         case '\'':
-            fputs( "\\\'", outputFile );
+            PushBytes( output, "\\\'", 2 );
             break;
         case '\"':
-            fputs( "\\\"", outputFile );
+            PushBytes( output, "\\\"", 2 );
             break;
         case '\?':
-            fputs( "\\\?", outputFile );
+            PushBytes( output, "\\\?", 2 );
             break;
         case '\\':
-            fputs( "\\\\", outputFile );
+            PushBytes( output, "\\\\", 2 );
             break;
         case '\a':
-            fputs( "\\a", outputFile );
+            PushBytes( output, "\\a", 2 );
             break;
         case '\b':
-            fputs( "\\b", outputFile );
+            PushBytes( output, "\\b", 2 );
             break;
         case '\f':
-            fputs( "\\f", outputFile );
+            PushBytes( output, "\\f", 2 );
             break;
         case '\n':
-            fputs( "\\n", outputFile );
+            PushBytes( output, "\\n", 2 );
             break;
         case '\r':
-            fputs( "\\r", outputFile );
+            PushBytes( output, "\\r", 2 );
             break;
         case '\t':
-            fputs( "\\t", outputFile );
+            PushBytes( output, "\\t", 2 );
             break;
         case '\v':
-            fputs( "\\v", outputFile );
+            PushBytes( output, "\\v", 2 );
             break;
         
         // Normal characters
         default:
             // Other control characters are represented on octal.
             if ( character < 32 ) {
-                fprintf( outputFile, "\\%o", character );
+                PushFormatted( output, "\\%o", character );
             // Non-ASCII characters and DEL are represented as a universal character name.
             } else if ( character > 126 ) {
-                PushUniversalCharacterName( character, outputFile );
+                PushUniversalCharacterName( character, output );
             // Printable ASCII characters are represented as themselves.
             } else {
-                fputc( character, outputFile );
+                PushByte( output, character );
             }
             break;
     }
 }
 
-void PushUTF8CharactersFromUTF32( uint32_t character, FILE * outputFile ) {
+void PushUTF8CharactersFromUTF32( uint32_t character, outputBuffer_t * output ) {
 /*
 ====================
 =
 = PushUTF8CharactersFromUTF32
 =
-= Pushes UTF-8 characters to the output file from a UTF-32 character.
+= Pushes UTF-8 characters to the output buffer from a UTF-32 character.
 =
 ====================
 */
@@ -136,5 +137,5 @@ void PushUTF8CharactersFromUTF32( uint32_t character, FILE * outputFile ) {
             *--target = ( character | firstByteMark[ bytes ] );
 	}
 
-    fwrite( &charTowrite, 1, bytes, outputFile );
+    PushBytes( output, ( char * )&charTowrite, bytes );
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <inttypes.h>
-void PushUniversalCharacterName( uint32_t character, FILE * outputFile );
-void PushCharacter( uint32_t character, FILE * outputFile );
-void PushUTF8CharactersFromUTF32( uint32_t character, FILE * outputFile );
\ No newline at end of file
+#include "../OutputBuffer.h"
+void PushUniversalCharacterName( uint32_t character, outputBuffer_t * output );
+void PushCharacter( uint32_t character, outputBuffer_t * output );
+void PushUTF8CharactersFromUTF32( uint32_t character, outputBuffer_t * output );
\ No newline at end of file
@@ -4,15 +4,154 @@
 #include <inttypes.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include "Characters.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../OutputBuffer.h"
+#include "../File.h"
 #include "../TokenList.h"
+#include "../SymbolTable.h"
+#include "../TokenFile.h"
+#include "../TokenArchive.h"
+#include "../TokenStream.h"
 #include "../Tokens.h"
-
-char * tokenMeaning[ 4819 ] = { "", "", "", "", "", "", "", "", "", "\t", "\n", "\v", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", " ", "!", "\"", "#", "$", "%", "&", "'", "(", ")", "*", "+", ",", "-", ".", "/", "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", ":", ";", "<", "=", ">", "?", "@", "A", "B", "C", "D", "E", "F", "G", "H", "I", "J", "K", "L", "M", "N", "O", "P", "Q", "R", "S", "T", "U", "V", "W", "X", "Y", "Z", "[", "\\", "]", "^", "_", "`", "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z", "{", "|", "}", "~", "", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "", "", "", "", "", "", "->", "\xFF", "\xFF", "", "", "", "", "", "false", "!", "", "|=", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "_Decimal64", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "", "while", "", "", "", "##", "", "", "", "", "", "", "", "", "", "", "", "#", "", "", "", "", "", "", "", "", "enum", "", "+=", "", "", "", "", "", "_BitInt", "#if", "#ifdef", "#ifndef", "#elif", "#elifdef", "#elifndef", "#else", "#endif", "#include", "#embed", "#define", "#undef", "#line", "#error", "#warning", "#pragma", "", "", "", "", "%", "", "", "", "constexpr", "", "", "&&", "", "", "", "", "", "", "", "", "", "", "", "&", "", "", "", "", "", "", "", "", "", "", "", "return", "", "", "", "", "_Decimal32", "", "", "", "", "", "", "alignof", "", "", "", "nullptr", "", "", "*=", "", "", "", "", "", "", "(", "", "", "", "", "<<=", "", "", "", "", "", "", "", "", "", "", "", "", "", ")", "", "", "", "inline", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "*", "", "", "else", "", "", "", "++", "", "thread_local", "", "", "", "", "", "", "", "", "", "+", "_Atomic", "", "unsigned", "", "", "", "", "", "", "!=", "", "", "", "float", "", "", "", "", ",", "", "", "", "", "", "", "--", "", "volatile", "_Imaginary", "", "", "", "", "", "", "", "", "-", "", "", "", "", "case", "", "...", "", "", "", "", "", "", "goto", "", "", "", "", ".", "", "", "", "", "", "default", "", "", "", "", "", "", "", "typedef", "", "", "", "", "/", "", "", "", "", "typeof", "", "", "long", "", "", "", "", "", "", "", "int", ">>=", "", "", "", "union", "", "", "", "_Complex", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "_Noreturn", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "alignas", "", "", "", "", "", "", "", "", "break", "", "", "", "", "", "", "", "", "", "", "", "", "/=", "", "", "", "", "", "", "", "", "auto", "", "", "", "", "", "static", "", "", "", "", "", "", "", "", "double", "", "", "", "struct", "", "restrict", "", "", "", "", "", "", "", "", "", "", "", "", "static_assert", "", "", "", "", "", "_Decimal128", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "sizeof", "&=", "", "", "", "", "", "", "", "", ">=", "", "", "", "", "", "if", "", "", "", "", "", "^=", "", "", "", "", "do", "", "", "::", "for", "", "short", "", "", "_Generic", "", "continue", "{", "", "", ":", "", "", "bool", "||", "", "", "", "[", "", "", "", "", "", "", "", "|", "", "", ";", "", "", "", "", "register", "", "<<", "", "", "", "", "", "", "", "", "}", "%=", "", "<", "-=", "", "", "", "", "", "==", "]", "true", "", "", "", "", "", "", "~", "signed", "", "=", "", "", "", "", "", "", ">>", "^", "", "", "", "", "", "", "", "", "", "switch", ">", "", "", "", "typeof_unqual", "", "extern", "", "", "", "", "", "", "", "", "char", "", "", "", "?", "", "", "", "", "", "", "", "void", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "const", "", "<=", "" };
+#include "../Diagnostic.h"
+
+// The tokenMeaning array holds the spelling of every token that is not an identifier, "\xFF" marks special cases.
+// It is only the source for the spelling blob, which is what Recompose actually reads.
+static const char * const tokenMeaning[ 747 ] = { "", "", "", "", "", "", "", "", "", "\t", "\n", "\v", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", " ", "!", "\"", "#", "$", "%", "&", "'", "(", ")", "*", "+", ",", "-", ".", "/", "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", ":", ";", "<", "=", ">", "?", "@", "A", "B", "C", "D", "E", "F", "G", "H", "I", "J", "K", "L", "M", "N", "O", "P", "Q", "R", "S", "T", "U", "V", "W", "X", "Y", "Z", "[", "\\", "]", "^", "_", "`", "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z", "{", "|", "}", "~", "", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "", "", "", "", "", "->", "\xFF", "\xFF", "", "", "", "", "", "false", "!", "", "|=", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "_Decimal64", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "\xFF", "", "while", "", "", "", "##", "", "", "", "", "", "", "", "", "", "", "", "#", "", "", "", "", "", "", "", "", "enum", "", "+=", "", "", "", "", "", "_BitInt", "#if", "#ifdef", "#ifndef", "#elif", "#elifdef", "#elifndef", "#else", "#endif", "#include", "#embed", "#define", "#undef", "#line", "#error", "#warning", "#pragma", "", "", "", "", "%", "", "", "", "constexpr", "", "", "&&", "", "", "", "", "", "", "", "", "", "", "", "&", "", "", "", "", "", "", "", "", "", "", "", "return", "", "", "", "", "_Decimal32", "", "", "", "", "", "", "alignof", "", "", "", "nullptr", "", "", "*=", "", "", "", "", "", "", "(", "", "", "", "", "<<=", "", "", "", "", "", "", "", "", "", "", "", "", "", ")", "", "", "", "inline", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "*", "", "", "else", "", "", "", "++", "", "thread_local", "", "", "", "", "", "", "", "", "", "+", "_Atomic", "", "unsigned", "", "", "", "", "", "", "!=", "", "", "", "float", "", "", "", "", ",", "", "", "", "", "", "", "--", "", "volatile", "_Imaginary", "", "", "", "", "", "", "", "", "-", "", "", "", "", "case", "", "...", "", "", "", "", "", "", "goto", "", "", "", "", ".", "", "", "", "", "", "default", "", "", "", "", "", "", "", "typedef", "", "", "", "", "/", "", "", "", "", "typeof", "", "", "long", "", "", "", "", "", "", "", "int", ">>=", "", "", "", "union", "", "", "", "_Complex", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "_Noreturn", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "alignas", "", "", "", "", "", "", "", "", "break", "", "", "", "", "", "", "", "", "", "", "", "", "/=", "", "", "", "", "", "", "", "", "auto", "", "", "", "", "", "static", "", "", "", "", "", "", "", "", "double", "", "", "", "struct", "", "restrict", "", "", "", "", "", "", "", "", "", "", "", "", "static_assert", "", "", "", "", "", "_Decimal128", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "sizeof", "&=", "", "", "", "", "", "", "", "", ">=", "", "", "", "", "", "if", "", "", "", "", "", "^=", "", "", "", "", "do", "", "", "::", "for", "", "short", "", "", "_Generic", "", "continue", "{", "", "", ":", "", "", "bool", "||", "", "", "", "[", "", "", "", "", "", "", "", "|", "", "", ";", "", "", "", "", "register", "", "<<", "", "", "", "", "", "", "", "", "}", "%=", "", "<", "-=", "", "", "", "", "", "==", "]", "true", "", "", "", "", "", "", "~", "signed", "", "=", "", "", "", "", "", "", ">>", "^", "", "", "", "", "", "", "", "", "", "switch", ">", "", "", "", "typeof_unqual", "", "extern", "", "", "", "", "", "", "", "", "char", "", "", "", "?", "", "", "", "", "", "", "", "void", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "const", "", "<=", "" };
+
+typedef struct {
+    uint32_t  offset;
+    uint16_t  length;
+} tokenSpelling_t;
+
+#define SPECIAL_TOKEN_LENGTH 0xFFFF
+
+// The spellings are per thread, every thread recomposing with its own identifiers.
+static _Thread_local char *           spellingBlob = NULL;
+static _Thread_local size_t           spellingBlobSize = 0;
+static _Thread_local size_t           spellingBlobCapacity = 0;
+static _Thread_local size_t           keywordBlobSize = 0;
+static _Thread_local tokenSpelling_t  tokenSpelling[ 4819 ];
+
+// The identifiers that have a spelling, so that DestroyTokenMeaning only clears those.
+static _Thread_local token_t          usedIdentifiers[ 4819 - 747 ];
+static _Thread_local size_t           usedIdentifierCount = 0;
+
+// Fewer tokens than this are recomposed by one thread.
+#ifndef PARALLEL_RECOMPOSE_TOKENS
+#define PARALLEL_RECOMPOSE_TOKENS ( 1 << 20 )
+#endif
+
+typedef struct {
+    tokenList_t     tokens;
+    outputBuffer_t  output;
+    uint64_t        offset;
+} recomposeSegment_t;
+
+typedef struct {
+    recomposeSegment_t *  segments;
+    size_t                count;
+    size_t                next;
+    bool                  write;
+    pthread_mutex_t       lock;
+    symbolTable_t *       symbolTable;
+    char *                outputFilename;
+    int                   file;
+    atomic_bool           failed;     // A segment could not be written, raised on the calling thread
+} recomposeWork_t;
 
 void DestroyTokenMeaning();
+void RecomposeWithSymbols( tokenList_t * tokens, symbolTable_t * symbolTable, char * outputFilename );
+
+void AppendSpelling( token_t token, const char * spelling, size_t length ) {
+/*
+====================
+=
+= AppendSpelling
+=
+= Appends the spelling of a token to the spelling blob and records its offset and length.
+=
+====================
+*/
+
+    if ( spellingBlobSize + length > spellingBlobCapacity ) {
+        size_t  capacity = ( spellingBlobCapacity + length ) * 2;
+        char *  blob;
+
+        if ( ( blob = realloc( spellingBlob, capacity ) ) == NULL ) {
+            RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+        }
+
+        spellingBlob = blob;
+        spellingBlobCapacity = capacity;
+    }
+
+    // Identifier spellings start after the keywords, an offset of 0 is a slot that was never set.
+    if ( token >= 747 && tokenSpelling[ token ].offset == 0 ) {
+        usedIdentifiers[ usedIdentifierCount++ ] = token;
+    }
+
+    memcpy( spellingBlob + spellingBlobSize, spelling, length );
+    tokenSpelling[ token ].offset = spellingBlobSize;
+    tokenSpelling[ token ].length = length;
+    spellingBlobSize += length;
+}
+
+void InitializeTokenSpellings() {
+/*
+====================
+=
+= InitializeTokenSpellings
+=
+= Packs the spellings in tokenMeaning into the spelling blob, so that Recompose can copy every token by its precomputed
+= length instead of calling strlen on it.
+=
+= Only the first call does anything, identifiers are appended later by SetTokenMeaning.
+=
+====================
+*/
+
+    if ( spellingBlob != NULL ) {
+        return;
+    }
+
+    for ( token_t token = 0; token < 747; token++ ) {
+        if ( *tokenMeaning[ token ] == '\xFF' ) {
+            tokenSpelling[ token ].offset = 0;
+            tokenSpelling[ token ].length = SPECIAL_TOKEN_LENGTH;
+        } else {
+            AppendSpelling( token, tokenMeaning[ token ], strlen( tokenMeaning[ token ] ) );
+        }
+    }
+
+    keywordBlobSize = spellingBlobSize;
+}
+
+void SetTokenMeaning( token_t token, const char * name, size_t length ) {
+/*
+====================
+=
+= SetTokenMeaning
+=
+= Sets the spelling of a token, used to load the identifiers of a symbol table before recomposing.
+=
+====================
+*/
+
+    InitializeTokenSpellings();
+    AppendSpelling( token, name, length );
+}
 
-void SpecialCases( uint32_t token, FILE * outputFile, unsigned int * iterator ) {
+void SpecialCases( uint32_t token, outputBuffer_t * output, tokenCursor_t * cursor ) {
 /*
 ====================
 =
@@ -23,7 +162,7 @@ void SpecialCases( uint32_t token, FILE * outputFile, unsigned int * iterator )
 = Special cases are mostly compound tokens where the next tokens must be read and pushed in a certain way to the
 = recomposed source file.
 =
-= The value pointed by iterator is incremented the number of additional tokens read.
+= The payload of the token is read from cursor, which is left at the next token.
 =
 ====================
 */
@@ -39,8 +178,8 @@ void SpecialCases( uint32_t token, FILE * outputFile, unsigned int * iterator )
     double       dConstant;
     long double  ldConstant;
 
-    // These integer static asserts can be fixed by replacing the format specifiers and casts in the fprintf functions.
-    // A fully portable implementation would have all the fprintf functions with either %ull or %ll, without side-effects.
+    // These integer static asserts can be fixed by replacing the format specifiers and casts in the PushFormatted calls.
+    // A fully portable implementation would have all the PushFormatted calls with either %ull or %ll, without side-effects.
     static_assert( sizeof( int ) >= 4, "A 32-bit integer does not fit into an int" );
     static_assert( sizeof( unsigned int ) >= 4, "A 32-bit integer does not fit into an int" );
     static_assert( sizeof( long ) >= 4, "A 32-bit integer does not fit into a long" );
@@ -57,87 +196,72 @@ void SpecialCases( uint32_t token, FILE * outputFile, unsigned int * iterator )
         
         // Character string literals
         case CHARACTER_STRING_LITERAL_TOKEN:
-            fputc( '\"', outputFile );
+            PushByte( output, '\"' );
             
-            ReadTokens( NULL, 1, &stringLength );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &stringLength );
 
             for ( unsigned int i = 0; i < stringLength; i++ ) {
-                ReadTokens( NULL, 1, &token );
-                PushCharacter( token, outputFile );
-
-                ( *iterator )++;
+                ReadTokens( cursor, 1, &token );
+                PushCharacter( token, output );
             }
             
-            fputc( '\"', outputFile );
+            PushByte( output, '\"' );
             break;
         
         // UTF-8 string literals
         case UTF_8_STRING_LITERAL_TOKEN:
-            fputs( "u8\"", outputFile );
+            PushBytes( output, "u8\"", 3 );
             
-            ReadTokens( NULL, 1, &stringLength );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &stringLength );
 
             for ( unsigned int i = 0; i < stringLength; i++ ) {
-                ReadTokens( NULL, 1, &stringLength );
-                PushCharacter( token, outputFile );
-
-                ( *iterator )++;
+                ReadTokens( cursor, 1, &token );
+                PushCharacter( token, output );
             }
             
-            fputc( '\"', outputFile );
+            PushByte( output, '\"' );
             break;
         
         // wchar_t string literals
         case WCHAR_UNDERSCORE_T_STRING_LITERAL_TOKEN:
-            fputs( "L\"", outputFile );
+            PushBytes( output, "L\"", 2 );
             
-            ReadTokens( NULL, 1, &stringLength );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &stringLength );
 
             for ( unsigned int i = 0; i < stringLength; i++ ) {
-                ReadTokens( NULL, 1, &token );
-                PushCharacter( token, outputFile );
-
-                ( *iterator )++;
+                ReadTokens( cursor, 1, &token );
+                PushCharacter( token, output );
             }
             
-            fputc( '\"', outputFile );
+            PushByte( output, '\"' );
             break;
         
         // UTF-16 string literals
         case UTF_16_STRING_LITERAL_TOKEN:
-            fputs( "u\"", outputFile );
+            PushBytes( output, "u\"", 2 );
             
-            ReadTokens( NULL, 1, &stringLength );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &stringLength );
 
             for ( unsigned int i = 0; i < stringLength; i++ ) {
-                ReadTokens( NULL, 1, &token );
-                PushCharacter( token, outputFile );
-
-                ( *iterator )++;
+                ReadTokens( cursor, 1, &token );
+                PushCharacter( token, output );
             }
             
-            fputc( '\"', outputFile );
+            PushByte( output, '\"' );
             break;
         
         // UTF-32 string literals
         case UTF_32_STRING_LITERAL_TOKEN:
-            fputs( "U\"", outputFile );
+            PushBytes( output, "U\"", 2 );
             
-            ReadTokens( NULL, 1, &stringLength );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &stringLength );
 
             for ( unsigned int i = 0; i < stringLength; i++ ) {
-                ReadTokens( NULL, 1, &token );
-                PushCharacter( token, outputFile );
-
-                ( *iterator )++;
+                ReadTokens( cursor, 1, &token );
+                PushCharacter( token, output );
             }
             
-            fputc( '\"', outputFile );
+            PushByte( output, '\"' );
             break;
 
         /*
@@ -148,36 +272,46 @@ void SpecialCases( uint32_t token, FILE * outputFile, unsigned int * iterator )
 
         // H-char headers (<header.h>)
         case HEADER_NAME_LESS_GREATER_TOKEN:
-            fputc( '<', outputFile );
+            PushByte( output, '<' );
             
-            ReadTokens( NULL, 1, &stringLength );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &stringLength );
 
             for ( unsigned int i = 0; i < stringLength; i++ ) {
-                ReadTokens( NULL, 1, &token );
-                PushUTF8CharactersFromUTF32( token, outputFile );
-
-                ( *iterator )++;
+                ReadTokens( cursor, 1, &token );
+                PushUTF8CharactersFromUTF32( token, output );
             }
 
-            fputc( '>', outputFile );
+            PushByte( output, '>' );
             break;
 
         // Q-char headers ("header.h")
         case HEADER_NAME_QUOTES_TOKEN:
-            fputc( '\"', outputFile );
+            PushByte( output, '\"' );
             
-            ReadTokens( NULL, 1, &stringLength );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &stringLength );
 
             for ( unsigned int i = 0; i < stringLength; i++ ) {
-                ReadTokens( NULL, 1, &token );
-                PushUTF8CharactersFromUTF32( token, outputFile );
-
-                ( *iterator )++;
+                ReadTokens( cursor, 1, &token );
+                PushUTF8CharactersFromUTF32( token, output );
             }
 
-            fputc( '\"', outputFile );
+            PushByte( output, '\"' );
+            break;
+
+        /*
+        ============
+        Error tokens
+        ============
+        */
+
+        // Bytes skipped by the recovery mode of the lexer, written back as they were.
+        case ERROR_TOKEN:
+            ReadTokens( cursor, 1, &stringLength );
+
+            for ( unsigned int i = 0; i < stringLength; i++ ) {
+                ReadTokens( cursor, 1, &token );
+                PushByte( output, token );
+            }
             break;
 
         /*
@@ -188,67 +322,62 @@ void SpecialCases( uint32_t token, FILE * outputFile, unsigned int * iterator )
         
         // Character constants
         case CHARACTER_CONSTANT_TOKEN:
-            fputc( '\'', outputFile );
+            PushByte( output, '\'' );
             
-            ReadTokens( NULL, 1, &token );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &token );
             
-            PushCharacter( token, outputFile );
+            PushCharacter( token, output );
             
             //Closing apostrophe
-            fputc( '\'', outputFile );
+            PushByte( output, '\'' );
             break;
         
         // UTF-8 character constant
         case UTF_8_CHARACTER_CONSTANT_TOKEN:
-            fputs( "u8\'", outputFile );
+            PushBytes( output, "u8\'", 3 );
             
-            ReadTokens( NULL, 1, &token );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &token );
             
-            PushCharacter( token, outputFile );
+            PushCharacter( token, output );
             
             //Closing apostrophe
-            fputc( '\'', outputFile );
+            PushByte( output, '\'' );
             break;
         
         // wchar_t character constant
         case WCHAR_UNDERSCORE_T_CHARACTER_CONSTANT_TOKEN:
-            fputs( "L\'", outputFile );
+            PushBytes( output, "L\'", 2 );
             
-            ReadTokens( NULL, 1, &token );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &token );
             
-            PushCharacter( token, outputFile );
+            PushCharacter( token, output );
             
             //Closing apostrophe
-            fputc( '\'', outputFile );
+            PushByte( output, '\'' );
             break;
         
         // UTF-16 character constant
         case UTF_16_CHARACTER_CONSTANT_TOKEN:
-            fputs( "u\'", outputFile );
+            PushBytes( output, "u\'", 2 );
             
-            ReadTokens( NULL, 1, &token );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &token );
             
-            PushCharacter( token, outputFile );
+            PushCharacter( token, output );
             
             //Closing apostrophe
-            fputc( '\'', outputFile );
+            PushByte( output, '\'' );
             break;
         
         // UTF-32 character constant
         case UTF_32_CHARACTER_CONSTANT_TOKEN:
-            fputs( "U\'", outputFile );
+            PushBytes( output, "U\'", 2 );
             
-            ReadTokens( NULL, 1, &token );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &token );
             
-            PushCharacter( token, outputFile );
+            PushCharacter( token, output );
             
             //Closing apostrophe
-            fputc( '\'', outputFile );
+            PushByte( output, '\'' );
             break;
         
         /*
@@ -259,49 +388,43 @@ void SpecialCases( uint32_t token, FILE * outputFile, unsigned int * iterator )
         
         // int constants
         case INT_CONSTANT_TOKEN:
-            ReadTokens( NULL, 1, &iConstant );
-            fprintf( outputFile, "%d", ( int )iConstant );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &iConstant );
+            PushFormatted( output, "%d", ( int )iConstant );
             break;
         
         // unsigned int constants
         case UNSIGNED_INT_CONSTANT_TOKEN:
-            ReadTokens( NULL, 1, &uiConstant );
-            fprintf( outputFile, "%u", ( unsigned int )uiConstant );
-            fputc( 'u', outputFile );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &uiConstant );
+            PushFormatted( output, "%u", ( unsigned int )uiConstant );
+            PushByte( output, 'u' );
             break;
         
         // long constants
         case LONG_INT_CONSTANT_TOKEN:
-            ReadTokens( NULL, 1, &lConstant );
-            fprintf( outputFile, "%ld", ( long )lConstant );
-            fputc( 'l', outputFile );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &lConstant );
+            PushFormatted( output, "%ld", ( long )lConstant );
+            PushByte( output, 'l' );
             break;
         
         // unsigned long constants
         case UNSIGNED_LONG_INT_CONSTANT_TOKEN:
-            ReadTokens( NULL, 1, &ulConstant );
-            fprintf( outputFile, "%lu", ( unsigned long )ulConstant );
-            fputs( "ul", outputFile );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &ulConstant );
+            PushFormatted( output, "%lu", ( unsigned long )ulConstant );
+            PushBytes( output, "ul", 2 );
             break;
         
         // long long constants
         case LONG_LONG_INT_CONSTANT_TOKEN:
-            ReadTokens( NULL, 2, &llConstant );
-            fprintf( outputFile, "%lld", ( long long )llConstant );
-            fputs( "ll", outputFile );
-            ( *iterator ) += 2;
+            ReadTokens( cursor, 2, &llConstant );
+            PushFormatted( output, "%lld", ( long long )llConstant );
+            PushBytes( output, "ll", 2 );
             break;
         
         // unsigned long long constants
         case UNSIGNED_LONG_LONG_INT_CONSTANT_TOKEN:
-            ReadTokens( NULL, 2, &ullConstant );
-            fprintf( outputFile, "%llu", ( unsigned long long )ullConstant );
-            fputs( "ull", outputFile );
-            ( *iterator ) += 2;
+            ReadTokens( cursor, 2, &ullConstant );
+            PushFormatted( output, "%llu", ( unsigned long long )ullConstant );
+            PushBytes( output, "ull", 3 );
             break;
         
         /*
@@ -313,18 +436,16 @@ void SpecialCases( uint32_t token, FILE * outputFile, unsigned int * iterator )
         // Float constants
         case FLOAT_CONSTANT_TOKEN:
             static_assert( sizeof( float ) == sizeof( token_t ), "A float is not 4 bytes." );
-            ReadTokens( NULL, 1, &fConstant );
-            fprintf( outputFile, "%f", fConstant );
-            fputc( 'f', outputFile );
-            ( *iterator )++;
+            ReadTokens( cursor, 1, &fConstant );
+            PushFormatted( output, "%f", fConstant );
+            PushByte( output, 'f' );
             break;
         
         // Double constants
         case DOUBLE_CONSTANT_TOKEN:
             static_assert( sizeof( double ) == 2 * sizeof( token_t ), "A double is not 8 bytes." );
-            ReadTokens( NULL, 2, &dConstant );
-            fprintf( outputFile, "%lf", dConstant );
-            ( *iterator ) += 2;
+            ReadTokens( cursor, 2, &dConstant );
+            PushFormatted( output, "%lf", dConstant );
             break;
         
         // long double constants
@@ -334,146 +455,397 @@ void SpecialCases( uint32_t token, FILE * outputFile, unsigned int * iterator )
             #ifndef __INTELLISENSE__
             static_assert( sizeof( long double ) == 4 * sizeof( token_t ), "A long double is not 16 bytes." );
             #endif
-            ReadTokens( NULL, 4, &ldConstant );
-            fprintf( outputFile, "%Lf", ldConstant );
-            fputc( 'l', outputFile );
-            ( *iterator ) += 4;
+            ReadTokens( cursor, 4, &ldConstant );
+            PushFormatted( output, "%Lf", ldConstant );
+            PushByte( output, 'l' );
             break;
     }
 }
 
-void Recompose( tokenList_t * tokens, FILE * outputFile ) {
+void RecomposeToBuffer( tokenList_t * tokens, outputBuffer_t * output ) {
 /*
 ====================
 =
-= Recompose
+= RecomposeToBuffer
 =
-= Recomposes a series of tokens into a C source file.
+= Recomposes a series of tokens into an output buffer, the identifiers must already be set with SetTokenMeaning.
 =
 ====================
 */
     
-    token_t token;
+    tokenCursor_t    cursor = InitializeTokenCursor( tokens );
+    token_t          token;
+    tokenSpelling_t  spelling;
 
-    for ( unsigned int i = 0; i < tokens->size; i++ ) {
-        ReadTokens( tokens->head, 1, &token );
+    InitializeTokenSpellings();
+
+    while ( ReadTokens( &cursor, 1, &token ) == 1 ) {
+        spelling = tokenSpelling[ token ];
 
         // Special cases
-        if ( *tokenMeaning[ token ] == '\xFF' ) {
-            SpecialCases( token, outputFile, &i );
+        if ( spelling.length == SPECIAL_TOKEN_LENGTH ) {
+            SpecialCases( token, output, &cursor );
         // Normal tokens
         } else {
-            fputs( tokenMeaning[ token ], outputFile );
+            PushBytes( output, spellingBlob + spelling.offset, spelling.length );
         }
     }
 }
 
-void RecomposeFromFile( char * inputFilename, char * outputFilename, bool yolo ) {
-    FILE * inputFile = fopen( inputFilename, "rb" );
+void Recompose( tokenList_t * tokens, FILE * outputFile ) {
+/*
+====================
+=
+= Recompose
+=
+= Recomposes a series of tokens into a C source file.
+=
+= The output goes through an output buffer that is written to outputFile in large blocks.
+=
+====================
+*/
+    
+    outputBuffer_t output = InitializeOutputBuffer( outputFile );
 
-    // Error opening file
-    if ( inputFile == NULL ) {
-        perror( inputFilename );
-        exit( 1 );
-    }
+    RecomposeToBuffer( tokens, &output );
 
-    // Signature check
-    char signature[ 9 ];
-    signature[ 8 ] = '\0';
+    DestroyOutputBuffer( &output );
+}
 
-    if ( fread( signature, 1, 8, inputFile ) < 8 ) {
-        fprintf( stderr, "%s: Error reading file.", inputFilename );
-        exit( 1 );
-    }
+void * RecomposeWorker( void * argument ) {
+/*
+====================
+=
+= RecomposeWorker
+=
+= Recomposes segments of a parallel recompose into their own buffers until none are left, or writes them to their
+= offsets in the output file.
+=
+====================
+*/
 
-    // Check signature prefix ("%TOK-")
-    if ( memcmp( signature, "\x25\x54\x4F\x4B\x2D", 5 ) ) {
-        if ( yolo ) {
-            fprintf( stderr, "%s: Signature check failed: expect instability from YOLO mode.\n", inputFilename );
-        } else {
-            fprintf( stderr, "%s: File signature mismatch. File potentially corrupted.\n" 
-                             "Rerun with --yolo to ignore all checks.\n", inputFilename );
-            exit( 1 );
+    recomposeWork_t *     work = argument;
+    recomposeSegment_t *  segment;
+    chartCursor_t         chart = InitializeChartCursor( work->symbolTable->chart );
+    token_t               hash;
+
+    // Every thread has its own spellings.
+    if ( !work->write ) {
+        while ( ReadChart( &chart, 1, &hash ) ) {
+            SetTokenMeaning( hash, work->symbolTable->table[ hash ], strlen( work->symbolTable->table[ hash ] ) );
         }
-        
     }
-    
-    // Check revision number
-    int revision = strtol( signature + 5, NULL, 10 );
 
-    if ( revision > 1 ) {
-        if ( yolo ) {
-            fprintf( stderr, "%s: File revision check failed (got %d, maximum supported is 1): expect instability from YOLO mode.\n", inputFilename, revision );
+    while ( true ) {
+        pthread_mutex_lock( &( work->lock ) );
+        segment = work->next < work->count ? &( work->segments[ work->next++ ] ) : NULL;
+        pthread_mutex_unlock( &( work->lock ) );
+
+        if ( segment == NULL ) {
+            break;
+        }
+
+        if ( work->write ) {
+#ifndef _WIN32
+            if ( !WriteAt( work->file, segment->output.data, segment->output.size, segment->offset ) ) {
+                atomic_store( &( work->failed ), true );
+            }
+#endif
         } else {
-            fprintf( stderr, "%s: Unsupported file revision \"%d\", maximum supported revision is 1.\n"
-                            "Rerun with --yolo to ignore all checks.\n", inputFilename, revision );
-            exit( 1 );
+            segment->output = InitializeOutputBuffer( NULL );
+            RecomposeToBuffer( &( segment->tokens ), &( segment->output ) );
         }
     }
 
-    // Token count
-    unsigned int tokenCount;
-    if ( fread( &tokenCount, 4, 1, inputFile ) < 1 ) {
-        fprintf( stderr, "%s: Error reading file.", inputFilename );
-        exit( 1 );
+    if ( !work->write ) {
+        DestroyTokenMeaning();
     }
 
-    tokenList_t  tokens = InitializeTokenList();
-    token_t      token;
+    return NULL;
+}
+
+void RunRecomposeWorkers( recomposeWork_t * work, int threads, bool write ) {
+/*
+====================
+=
+= RunRecomposeWorkers
+=
+= Runs one pass of RecomposeWorker over every segment on threads threads.
+=
+====================
+*/
+
+    pthread_t threadIds[ threads ];
+
+    work->next = 0;
+    work->write = write;
 
-    for ( unsigned int i = 0; i < tokenCount; i++ ) {
-        if ( fread( &token, 4, 1, inputFile ) < 1 ) {
-            fprintf( stderr, "%s: Error reading file.", inputFilename );
+    for ( int i = 0; i < threads; i++ ) {
+        if ( pthread_create( &threadIds[ i ], NULL, RecomposeWorker, work ) != 0 ) {
+            fputs( "Could not start a thread.\n", stderr );
+            exit( 1 );
         }
-        
-        PushToken( &tokens, token );
     }
 
-    // Go to the symbol table
-    fseek( inputFile, tokenCount * 4 + 12, SEEK_SET );
+    for ( int i = 0; i < threads; i++ ) {
+        pthread_join( threadIds[ i ], NULL );
+    }
+}
 
-    // Load symbol table
-    uint32_t  symbol;
-    char      name[ 64 ];
-    size_t    length;
+void RecomposeParallel( tokenList_t * tokens, symbolTable_t * symbolTable, char * outputFilename, int threads ) {
+/*
+====================
+=
+= RecomposeParallel
+=
+= Recomposes a series of tokens into a C source file like RecomposeWithSymbols, on threads threads.
+=
+= The tokens are split into segments between two tokens, never inside the payload of a constant or literal. Every
+= segment is recomposed into its own buffer, the offset of every segment in the file is the sum of the sizes of the
+= segments before it, and the segments are written to their offsets at once.
+=
+= Fewer than PARALLEL_RECOMPOSE_TOKENS tokens are recomposed by one thread.
+=
+= A file that can't be opened or written raises a WRITE_ERROR once the segments are freed, see RaiseError.
+=
+====================
+*/
 
-    while( fread( &symbol, 4, 1, inputFile ) ) {
-        length = 0;
+    recomposeWork_t  work = { .symbolTable = symbolTable, .outputFilename = outputFilename, .lock = PTHREAD_MUTEX_INITIALIZER };
+    size_t           count = threads * 4;
+    size_t           first = 0;
+    size_t           position = 0;
+    uint64_t         offset = 0;
+    bool             written = true;
+    int              openError = 0;
 
-        // Read symbol name
-        do {
-            if ( fread( &name[ length ], 1, 1, inputFile ) < 1 ) {
-                fprintf( stderr, "%s: Error reading file.", inputFilename );
-            }
+    atomic_init( &( work.failed ), false );
+
+    if ( count > tokens->size / PARALLEL_RECOMPOSE_TOKENS ) {
+        count = tokens->size / PARALLEL_RECOMPOSE_TOKENS;
+    }
 
-            length++;
-        } while ( name[ length - 1 ] != '\0' );
+    if ( threads <= 1 || count <= 1 ) {
+        RecomposeWithSymbols( tokens, symbolTable, outputFilename );
+        return;
+    }
 
-        if ( symbol > 4819 ) {
-            fprintf( stderr, "Malformed file \"%s\": Symbol \"%s\" has value %u, above upper limit 4819 for file revision 1.\n", inputFilename, name, symbol );
-            exit( 1 );
-        } else if ( symbol < 128 ) {
-            fprintf( stderr, "Malformed file \"%s\": Symbol \"%s\" has value %u, bellow lower limit 128 for file revision 1.\n", inputFilename, name, symbol );
-            exit( 1 );
+    if ( ( work.segments = malloc( count * sizeof( recomposeSegment_t ) ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    // Split at the first token boundary after every segment size.
+    for ( work.count = 0; work.count < count && first < tokens->size; work.count++ ) {
+        size_t target = work.count == count - 1 ? tokens->size : ( work.count + 1 ) * tokens->size / count;
+
+        while ( position < target ) {
+            position += TokenWords( tokens, position );
         }
-        
-        tokenMeaning[ symbol ] = malloc( ( strlen( name ) + 1 ) * sizeof( char ) );
-        strcpy( tokenMeaning[ symbol ], name );
+
+        if ( position > tokens->size ) {
+            position = tokens->size;
+        }
+
+        work.segments[ work.count ].tokens = ( tokenList_t ){ tokens->tokens + first, position - first, position - first };
+        first = position;
+    }
+
+    RunRecomposeWorkers( &work, threads, false );
+
+    for ( size_t i = 0; i < work.count; i++ ) {
+        work.segments[ i ].offset = offset;
+        offset += work.segments[ i ].output.size;
     }
-    
-    fclose( inputFile );
 
+#ifdef _WIN32
+    // Without pwrite the segments are written in order, through a text stream like in RecomposeWithSymbols.
     FILE * outputFile = fopen( outputFilename, "w" );
 
-    if ( outputFile == NULL ) {
+    if ( outputFile != NULL ) {
+        for ( size_t i = 0; written && i < work.count; i++ ) {
+            written = fwrite( work.segments[ i ].output.data, 1, work.segments[ i ].output.size, outputFile ) == work.segments[ i ].output.size;
+        }
+
+        written = fclose( outputFile ) == 0 && written;
+    } else {
+        openError = errno;
+    }
+#else
+    if ( ( work.file = open( outputFilename, O_WRONLY | O_CREAT | O_TRUNC, 0666 ) ) != -1 ) {
+        RunRecomposeWorkers( &work, threads, true );
+
+        written = close( work.file ) == 0 && !atomic_load( &( work.failed ) );
+    } else {
+        openError = errno;
+    }
+#endif
+
+    pthread_mutex_destroy( &( work.lock ) );
+
+    for ( size_t i = 0; i < work.count; i++ ) {
+        DestroyOutputBuffer( &( work.segments[ i ].output ) );
+    }
+
+    free( work.segments );
+
+    // Raised only once the segments are freed, so that a trapped error leaks nothing.
+    if ( openError != 0 ) {
+        RaiseError( NULL, WRITE_ERROR, "%s: %s", outputFilename, strerror( openError ) );
+    }
+
+    if ( !written ) {
+        RaiseError( NULL, WRITE_ERROR, "%s: Error writing to output file.", outputFilename );
+    }
+}
+
+void RecomposeWithSymbols( tokenList_t * tokens, symbolTable_t * symbolTable, char * outputFilename ) {
+/*
+====================
+=
+= RecomposeWithSymbols
+=
+= Recomposes a series of tokens into a C source file, taking the identifier spellings from a symbol table.
+=
+= A file that can't be opened or written raises a WRITE_ERROR, see RaiseError.
+=
+====================
+*/
+
+    chartCursor_t  chart = InitializeChartCursor( symbolTable->chart );
+    token_t        hash;
+    FILE *         outputFile;
+
+    // Opened first, so that nothing is left to free if it can't be.
+    if ( ( outputFile = fopen( outputFilename, "w" ) ) == NULL ) {
+        RaiseError( NULL, WRITE_ERROR, "%s: %s", outputFilename, strerror( errno ) );
+    }
+
+    while ( ReadChart( &chart, 1, &hash ) ) {
+        SetTokenMeaning( hash, symbolTable->table[ hash ], strlen( symbolTable->table[ hash ] ) );
+    }
+
+    Recompose( tokens, outputFile );
+
+    DestroyTokenMeaning();
+
+    if ( fclose( outputFile ) != 0 ) {
+        RaiseError( NULL, WRITE_ERROR, "%s: Error writing to output file.", outputFilename );
+    }
+}
+
+void RecomposeFromFile( char * inputFilename, char * outputFilename, bool yolo, int threads, tokenFileOptions_t * options ) {
+/*
+====================
+=
+= RecomposeFromFile
+=
+= Recomposes a tokens file of any supported revision into a C source file.
+=
+= If options->firstLine is set only lines firstLine to options->lastLine of the output are recomposed, they count the
+= newlines the output has and not the ones of the source file: a comment over many lines is a single space. Large
+= files are recomposed on threads threads.
+=
+====================
+*/
+
+    tokenList_t    tokens;
+    symbolTable_t  symbolTable;
+
+    ImportTokenFile( inputFilename, yolo, options, &tokens, &symbolTable );
+    RecomposeParallel( &tokens, &symbolTable, outputFilename, threads );
+
+    DestroySymbolTable( symbolTable );
+    DestroyTokenList( tokens );
+}
+
+void RecomposeStream( char * inputFilename, char * outputFilename ) {
+/*
+====================
+=
+= RecomposeStream
+=
+= Recomposes a %TOK-003 token stream read from inputFilename ("-" for the standard input) frame by frame, so the
+= output of a stream that is still being written comes out as its frames arrive.
+=
+====================
+*/
+
+    FILE *               input = strcmp( inputFilename, "-" ) ? fopen( inputFilename, "rb" ) : stdin;
+    FILE *               outputFile = strcmp( outputFilename, "-" ) ? fopen( outputFilename, "w" ) : stdout;
+    tokenStreamReader_t  reader;
+    tokenList_t          tokens = InitializeTokenList();
+    symbolTable_t        symbolTable = InitializeSymbolTable();
+    chartStack_t *       lastSymbol = NULL;
+    int                  type;
+
+    if ( input == NULL ) {
         perror( inputFilename );
         exit( 1 );
     }
 
-    Recompose( &tokens, outputFile );
+    if ( outputFile == NULL ) {
+        perror( outputFilename );
+        exit( 1 );
+    }
+
+    reader = InitializeTokenStreamReader( inputFilename, input );
+
+    while ( ( type = ReadTokenFrame( &reader, &tokens, &symbolTable ) ) != TRAILER_FRAME ) {
+        if ( type == SYMBOL_FRAME ) {
+            // Spell the symbols added by the frame.
+            for ( chartStack_t * symbol = lastSymbol == NULL ? symbolTable.chart : lastSymbol->next; symbol != NULL; symbol = symbol->next ) {
+                SetTokenMeaning( symbol->hash, symbolTable.table[ symbol->hash ], strlen( symbolTable.table[ symbol->hash ] ) );
+            }
+
+            lastSymbol = symbolTable.chartTail;
+        } else if ( type == TOKEN_FRAME ) {
+            Recompose( &tokens, outputFile );
+            fflush( outputFile );
+            tokens.size = 0;
+        }
+    }
 
+    DestroyTokenStreamReader( &reader );
     DestroyTokenMeaning();
-    fclose( outputFile );
+    DestroySymbolTable( symbolTable );
+    DestroyTokenList( tokens );
+
+    if ( input != stdin ) {
+        fclose( input );
+    }
+
+    if ( outputFile != stdout ) {
+        fclose( outputFile );
+    }
+}
+
+void RecomposeFromArchive( char * archiveFilename, char * memberName, char * outputFilename, tokenFileOptions_t * options ) {
+/*
+====================
+=
+= RecomposeFromArchive
+=
+= Recomposes one file of a token archive into a C source file.
+=
+====================
+*/
+
+    tokenArchive_t   archive = OpenTokenArchive( archiveFilename, !options->skipChecksums );
+    archiveMember_t  member;
+    tokenList_t      tokens;
+    symbolTable_t    symbolTable;
+
+    if ( !FindArchiveMember( &archive, memberName, &member ) ) {
+        fprintf( stderr, "%s: No file \"%s\" in the archive.\n", archiveFilename, memberName );
+        exit( 1 );
+    }
+
+    ImportArchiveMember( &archive, &member, &tokens, &symbolTable );
+    RecomposeWithSymbols( &tokens, &symbolTable, outputFilename );
+
+    DestroySymbolTable( symbolTable );
+    DestroyTokenList( tokens );
+    CloseTokenArchive( &archive );
 }
 
 void DestroyTokenMeaning() {
@@ -482,13 +854,17 @@ void DestroyTokenMeaning() {
 =
 = DestroyTokenMeaning
 =
-= Destroys the alloc'ed strings in tokenMeaning.
+= Removes the identifier spellings added with SetTokenMeaning, only touching the slots that were set.
 =
 ====================
 */
     
-    for ( int i = 747; i < 4819; i++ ) {
-        free( tokenMeaning[ i ] );
-        tokenMeaning[ i ] = NULL;
+    spellingBlobSize = keywordBlobSize;
+
+    for ( size_t i = 0; i < usedIdentifierCount; i++ ) {
+        tokenSpelling[ usedIdentifiers[ i ] ].offset = 0;
+        tokenSpelling[ usedIdentifiers[ i ] ].length = 0;
     }
+
+    usedIdentifierCount = 0;
 }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #include <stdio.h>
+#include "../OutputBuffer.h"
 
-extern char * tokenMeaning[];
-
+void RecomposeToBuffer( tokenList_t * tokens, outputBuffer_t * output );
 void Recompose( tokenList_t * tokens, FILE * outputFile );
-void RecomposeFromFile( char * inputFilename, char * outputFilename, bool yolo );
+void RecomposeFromFile( char * inputFilename, char * outputFilename, bool yolo, int threads, tokenFileOptions_t * options );
+void RecomposeWithSymbols( tokenList_t * tokens, symbolTable_t * symbolTable, char * outputFilename );
+void RecomposeParallel( tokenList_t * tokens, symbolTable_t * symbolTable, char * outputFilename, int threads );
+void RecomposeStream( char * inputFilename, char * outputFilename );
+void RecomposeFromArchive( char * archiveFilename, char * memberName, char * outputFilename, tokenFileOptions_t * options );
+void SetTokenMeaning( token_t token, const char * name, size_t length );
 void DestroyTokenMeaning();
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "Ring.h"
+
+void InitializeRing( ring_t * ring, size_t capacity ) {
+/*
+====================
+=
+= InitializeRing
+=
+= Initializes a bounded ring of capacity items, passed between threads: any number of them may push and pop at once.
+=
+====================
+*/
+
+    if ( ( ring->items = malloc( capacity * sizeof( void * ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->tail = 0;
+    pthread_mutex_init( &( ring->lock ), NULL );
+    pthread_cond_init( &( ring->notEmpty ), NULL );
+    pthread_cond_init( &( ring->notFull ), NULL );
+}
+
+void PushRing( ring_t * ring, void * item ) {
+/*
+====================
+=
+= PushRing
+=
+= Pushes an item to a ring, waiting while it is full so that the producer never runs too far ahead.
+=
+====================
+*/
+
+    pthread_mutex_lock( &( ring->lock ) );
+
+    while ( ring->tail - ring->head == ring->capacity ) {
+        pthread_cond_wait( &( ring->notFull ), &( ring->lock ) );
+    }
+
+    ring->items[ ring->tail++ % ring->capacity ] = item;
+
+    pthread_cond_signal( &( ring->notEmpty ) );
+    pthread_mutex_unlock( &( ring->lock ) );
+}
+
+void * PopRing( ring_t * ring ) {
+/*
+====================
+=
+= PopRing
+=
+= Pops the oldest item of a ring, waiting while it is empty.
+=
+====================
+*/
+
+    void * item;
+
+    pthread_mutex_lock( &( ring->lock ) );
+
+    while ( ring->tail == ring->head ) {
+        pthread_cond_wait( &( ring->notEmpty ), &( ring->lock ) );
+    }
+
+    item = ring->items[ ring->head++ % ring->capacity ];
+
+    pthread_cond_signal( &( ring->notFull ) );
+    pthread_mutex_unlock( &( ring->lock ) );
+
+    return item;
+}
+
+void DestroyRing( ring_t * ring ) {
+    pthread_mutex_destroy( &( ring->lock ) );
+    pthread_cond_destroy( &( ring->notEmpty ) );
+    pthread_cond_destroy( &( ring->notFull ) );
+    free( ring->items );
+}
\ No newline at end of file
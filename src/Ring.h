@@ -0,0 +1,20 @@
+#ifndef RING_H
+#define RING_H
+#include <stddef.h>
+#include <pthread.h>
+
+typedef struct {
+    void **          items;
+    size_t           capacity;
+    size_t           head;
+    size_t           tail;
+    pthread_mutex_t  lock;
+    pthread_cond_t   notEmpty;
+    pthread_cond_t   notFull;
+} ring_t;
+
+void InitializeRing( ring_t * ring, size_t capacity );
+void PushRing( ring_t * ring, void * item );
+void * PopRing( ring_t * ring );
+void DestroyRing( ring_t * ring );
+#endif
\ No newline at end of file
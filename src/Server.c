@@ -0,0 +1,1015 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <pthread.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
+#include "Decompose.h"
+#include "OutputBuffer.h"
+#include "Library.h"
+#include "TokenCache.h"
+#include "File.h"
+#include "Ring.h"
+#include "Server.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+// Lexed and recomposed by every worker before it takes connections, so that the first request finds everything warm.
+#define WARM_UP_SOURCE "#include <stdio.h>\nint main( void ) { printf( \"%d\\n\", 'a' + 0x1p4 ); return 0; }\n"
+
+typedef struct _cachedTokenFile_t {
+    char                         key[ TOKEN_CACHE_KEY_SIZE ];
+    char *                       data;
+    size_t                       size;
+    int                          references;   // Responses being sent from the entry
+    bool                         removed;      // No longer in the cache, freed with its last reference
+    struct _cachedTokenFile_t *  next;         // In its bucket
+    struct _cachedTokenFile_t *  newer;
+    struct _cachedTokenFile_t *  older;
+} cachedTokenFile_t;
+
+typedef struct {
+    cachedTokenFile_t **  buckets;
+    cachedTokenFile_t *   newest;
+    cachedTokenFile_t *   oldest;
+    size_t                size;
+    size_t                limit;     // Bytes the entries may take, 0 for no limit
+    pthread_mutex_t       lock;
+} memoryCache_t;
+
+typedef struct {
+    char *           socketPath;
+    ring_t           connections;       // With a request waiting, for the workers
+    memoryCache_t    cache;
+    atomic_bool      stopping;
+    int              wake[ 2 ];         // Pipe the poll loop watches, written to when it has something to look at
+    int *            returned;          // Connections a worker answered a request on, to be polled again
+    size_t           returnedCount;
+    size_t           returnedCapacity;
+    pthread_mutex_t  returnedLock;
+} server_t;
+
+typedef struct {
+    server_t *        server;
+    pthread_t         thread;
+    atomic_int        connection;     // Being served, -1 between requests
+    lexerContext_t    context;
+    diagnosticList_t  diagnostics;
+    char *            request;
+    size_t            requestCapacity;
+    outputBuffer_t    result;
+} serverWorker_t;
+
+bool ReadAll( int descriptor, void * data, size_t size ) {
+/*
+====================
+=
+= ReadAll
+=
+= Reads exactly size bytes from a socket. Returns false if it is closed or fails first.
+=
+====================
+*/
+
+    ssize_t received;
+
+    while ( size > 0 ) {
+        if ( ( received = read( descriptor, data, size ) ) <= 0 ) {
+            if ( received < 0 && errno == EINTR ) {
+                continue;
+            }
+
+            return false;
+        }
+
+        data = ( char * )data + received;
+        size -= received;
+    }
+
+    return true;
+}
+
+bool WriteAll( int descriptor, struct iovec * parts, int count ) {
+/*
+====================
+=
+= WriteAll
+=
+= Writes count parts to a socket, in as few calls as it takes. The parts are used up. Returns false if the socket is
+= closed or fails first.
+=
+====================
+*/
+
+    ssize_t sent;
+
+    while ( count > 0 ) {
+        if ( ( sent = writev( descriptor, parts, count ) ) < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+
+            return false;
+        }
+
+        for ( ; count > 0 && ( size_t )sent >= parts->iov_len; parts++, count-- ) {
+            sent -= parts->iov_len;
+        }
+
+        if ( count > 0 ) {
+            parts->iov_base = ( char * )parts->iov_base + sent;
+            parts->iov_len -= sent;
+        }
+    }
+
+    return true;
+}
+
+bool SendResponse( int descriptor, lexerStatus_t status, bool cached, const char * message, size_t messageLength, const void * result, size_t length ) {
+/*
+====================
+=
+= SendResponse
+=
+= Sends the header of a response, its diagnostics text and its result, in one write when the socket takes them.
+=
+====================
+*/
+
+    responseHeader_t  header = { SERVER_MAGIC, status, cached, 0, messageLength, length };
+    struct iovec      parts[ 3 ] = {
+        { &header, sizeof( header ) },
+        { ( void * )message, messageLength },
+        { ( void * )result, length },
+    };
+
+    return WriteAll( descriptor, parts, 3 );
+}
+
+bool SendError( int descriptor, const char * format, ... ) {
+/*
+====================
+=
+= SendError
+=
+= Answers a request that could not be served with LEXER_ERROR and a formatted message.
+=
+====================
+*/
+
+    char     message[ DIAGNOSTIC_MESSAGE_SIZE ];
+    va_list  arguments;
+    int      length;
+
+    va_start( arguments, format );
+    length = vsnprintf( message, sizeof( message ) - 1, format, arguments );
+    va_end( arguments );
+
+    length = length < 0 ? 0 : length > ( int )sizeof( message ) - 2 ? ( int )sizeof( message ) - 2 : length;
+    message[ length++ ] = '\n';
+
+    return SendResponse( descriptor, LEXER_ERROR, false, message, length, NULL, 0 );
+}
+
+void InitializeMemoryCache( memoryCache_t * cache, size_t limit ) {
+/*
+====================
+=
+= InitializeMemoryCache
+=
+= Initializes the in-memory token cache of a server, holding up to limit bytes of token files, or any amount if limit
+= is 0. Entries are found by their TokenCacheKey and the least recently used ones removed first.
+=
+====================
+*/
+
+    if ( ( cache->buckets = calloc( SERVER_CACHE_BUCKETS, sizeof( cachedTokenFile_t * ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->size = 0;
+    cache->limit = limit;
+    pthread_mutex_init( &( cache->lock ), NULL );
+}
+
+void UnlinkCachedTokenFile( memoryCache_t * cache, cachedTokenFile_t * entry ) {
+/*
+====================
+=
+= UnlinkCachedTokenFile
+=
+= Takes an entry out of the order of use. The cache must be locked.
+=
+====================
+*/
+
+    if ( entry->newer != NULL ) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+
+    if ( entry->older != NULL ) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+}
+
+void LinkNewestTokenFile( memoryCache_t * cache, cachedTokenFile_t * entry ) {
+/*
+====================
+=
+= LinkNewestTokenFile
+=
+= Puts an entry first in the order of use. The cache must be locked.
+=
+====================
+*/
+
+    entry->newer = NULL;
+    entry->older = cache->newest;
+
+    if ( cache->newest != NULL ) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+
+    cache->newest = entry;
+}
+
+cachedTokenFile_t * FindCachedTokenFile( memoryCache_t * cache, const char * key ) {
+/*
+====================
+=
+= FindCachedTokenFile
+=
+= Returns the entry of a key, marked as just used and with a reference taken that ReleaseCachedTokenFile drops, or
+= NULL. The entry stays readable while the reference is held, even if it is removed from the cache meanwhile.
+=
+====================
+*/
+
+    cachedTokenFile_t * entry;
+
+    pthread_mutex_lock( &( cache->lock ) );
+
+    entry = cache->buckets[ HashContent( key, strlen( key ) ) % SERVER_CACHE_BUCKETS ];
+
+    while ( entry != NULL && strcmp( entry->key, key ) ) {
+        entry = entry->next;
+    }
+
+    if ( entry != NULL ) {
+        UnlinkCachedTokenFile( cache, entry );
+        LinkNewestTokenFile( cache, entry );
+        entry->references++;
+    }
+
+    pthread_mutex_unlock( &( cache->lock ) );
+
+    return entry;
+}
+
+void FreeCachedTokenFile( cachedTokenFile_t * entry ) {
+    free( entry->data );
+    free( entry );
+}
+
+void ReleaseCachedTokenFile( memoryCache_t * cache, cachedTokenFile_t * entry ) {
+/*
+====================
+=
+= ReleaseCachedTokenFile
+=
+= Drops a reference taken by FindCachedTokenFile.
+=
+====================
+*/
+
+    bool unused;
+
+    pthread_mutex_lock( &( cache->lock ) );
+    unused = --entry->references == 0 && entry->removed;
+    pthread_mutex_unlock( &( cache->lock ) );
+
+    if ( unused ) {
+        FreeCachedTokenFile( entry );
+    }
+}
+
+void RemoveOldestTokenFile( memoryCache_t * cache ) {
+/*
+====================
+=
+= RemoveOldestTokenFile
+=
+= Removes the least recently used entry from the cache, freeing it unless a response is being sent from it. The cache
+= must be locked and not empty.
+=
+====================
+*/
+
+    cachedTokenFile_t *   entry = cache->oldest;
+    cachedTokenFile_t **  link = &( cache->buckets[ HashContent( entry->key, strlen( entry->key ) ) % SERVER_CACHE_BUCKETS ] );
+
+    while ( *link != entry ) {
+        link = &( ( *link )->next );
+    }
+
+    *link = entry->next;
+    UnlinkCachedTokenFile( cache, entry );
+    cache->size -= entry->size;
+
+    if ( entry->references == 0 ) {
+        FreeCachedTokenFile( entry );
+    } else {
+        entry->removed = true;
+    }
+}
+
+void InsertCachedTokenFile( memoryCache_t * cache, const char * key, char * data, size_t size ) {
+/*
+====================
+=
+= InsertCachedTokenFile
+=
+= Adds a token file to the cache under key, taking data, which must have been allocated with malloc, and removing the
+= least recently used entries to make room for it. A token file larger than the whole cache or that another worker
+= added first is freed instead.
+=
+====================
+*/
+
+    cachedTokenFile_t *   entry;
+    cachedTokenFile_t **  bucket = &( cache->buckets[ HashContent( key, strlen( key ) ) % SERVER_CACHE_BUCKETS ] );
+
+    if ( cache->limit > 0 && size > cache->limit ) {
+        free( data );
+        return;
+    }
+
+    if ( ( entry = malloc( sizeof( cachedTokenFile_t ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    strcpy( entry->key, key );
+    entry->data = data;
+    entry->size = size;
+    entry->references = 0;
+    entry->removed = false;
+
+    pthread_mutex_lock( &( cache->lock ) );
+
+    for ( cachedTokenFile_t * other = *bucket; other != NULL; other = other->next ) {
+        if ( !strcmp( other->key, key ) ) {
+            pthread_mutex_unlock( &( cache->lock ) );
+            FreeCachedTokenFile( entry );
+            return;
+        }
+    }
+
+    while ( cache->limit > 0 && cache->size + size > cache->limit ) {
+        RemoveOldestTokenFile( cache );
+    }
+
+    entry->next = *bucket;
+    *bucket = entry;
+    LinkNewestTokenFile( cache, entry );
+    cache->size += size;
+
+    pthread_mutex_unlock( &( cache->lock ) );
+}
+
+void DestroyMemoryCache( memoryCache_t * cache ) {
+    while ( cache->oldest != NULL ) {
+        RemoveOldestTokenFile( cache );
+    }
+
+    pthread_mutex_destroy( &( cache->lock ) );
+    free( cache->buckets );
+}
+
+char * FormatDiagnostics( diagnosticList_t * diagnostics, size_t * length ) {
+/*
+====================
+=
+= FormatDiagnostics
+=
+= Returns the diagnostics of a request as the text of its response, to be freed by the caller, and empties the list.
+= Returns NULL, with length 0, if there are none.
+=
+====================
+*/
+
+    char *  text = NULL;
+    FILE *  stream;
+
+    *length = 0;
+
+    if ( diagnostics->size == 0 ) {
+        return NULL;
+    }
+
+    if ( ( stream = open_memstream( &text, length ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    PrintDiagnostics( stream, "request", diagnostics );
+    fclose( stream );
+
+    return text;
+}
+
+bool ServeLex( serverWorker_t * worker, int descriptor, requestHeader_t * header ) {
+/*
+====================
+=
+= ServeLex
+=
+= Answers a lex request with the token file of its source, from the cache if the same source was lexed with the same
+= options before. Only token files made without errors are cached, so that the diagnostics of a bad source are sent
+= every time. Returns false if the response could not be sent.
+=
+====================
+*/
+
+    tokenFileOptions_t   options = { .revision = header->revision, .compress = header->flags & COMPRESS_FLAG, .sortSymbols = header->flags & SORT_FLAG, .threads = 1 };
+    bool                 punchCardExtension = header->flags & PUNCH_CARD_FLAG;
+    bool                 recover = header->flags & RECOVER_FLAG;
+    memoryCache_t *      cache = &( worker->server->cache );
+    char                 key[ TOKEN_CACHE_KEY_SIZE ];
+    cachedTokenFile_t *  entry;
+    errorTrap_t          trap;
+    lexerStatus_t        status;
+    char *               message;
+    size_t               messageLength;
+    char *               tokenFile = NULL;
+    size_t               tokenFileSize = 0;
+    FILE *               stream;
+    bool                 sent;
+
+    if ( options.revision < 1 || options.revision > TOKEN_FILE_REVISION ) {
+        return SendError( descriptor, "request: Unsupported file revision \"%d\", supported revisions are 1 through %d.", options.revision, TOKEN_FILE_REVISION );
+    }
+
+    TokenCacheKey( worker->request, header->length, punchCardExtension, recover, &options, key );
+
+    if ( ( entry = FindCachedTokenFile( cache, key ) ) != NULL ) {
+        sent = SendResponse( descriptor, LEXER_SUCCESS, true, NULL, 0, entry->data, entry->size );
+        ReleaseCachedTokenFile( cache, entry );
+
+        return sent;
+    }
+
+    status = LexBuffer( &( worker->context ), worker->request, header->length, punchCardExtension, recover, &( worker->diagnostics ) );
+
+    // An export that fails is answered with its error like a lex error, the server goes on.
+    if ( status != LEXER_ERROR ) {
+        if ( ( stream = open_memstream( &tokenFile, &tokenFileSize ) ) == NULL ) {
+            return SendError( descriptor, "request: Out of memory." );
+        }
+
+        SetErrorTrap( &trap, NULL, 0, false, &( worker->diagnostics ) );
+
+        if ( setjmp( trap.jump ) == 0 ) {
+            ExportTokenFileTo( stream, &( worker->context.tokens ), &( worker->context.symbolTable ), &options );
+            ClearErrorTrap( &trap );
+        } else {
+            status = LEXER_ERROR;
+        }
+
+        fclose( stream );
+    }
+
+    message = FormatDiagnostics( &( worker->diagnostics ), &messageLength );
+    sent = SendResponse( descriptor, status, false, message, messageLength, tokenFile, status == LEXER_ERROR ? 0 : tokenFileSize );
+
+    if ( status == LEXER_SUCCESS ) {
+        InsertCachedTokenFile( cache, key, tokenFile, tokenFileSize );
+    } else {
+        free( tokenFile );
+    }
+
+    free( message );
+
+    return sent;
+}
+
+bool ServeRecompose( serverWorker_t * worker, int descriptor, requestHeader_t * header ) {
+/*
+====================
+=
+= ServeRecompose
+=
+= Answers a recompose request with the C source of its token file. A malformed token file is answered with its error,
+= the worker's context is left to be reset by the next request. A token file whose tokens or source would take more
+= than SERVER_DECODE_LIMIT bytes is turned down. Returns false if the response could not be sent.
+=
+====================
+*/
+
+    tokenFileOptions_t  options = { .revision = TOKEN_FILE_REVISION, .threads = 1, .tokenLimit = SERVER_DECODE_LIMIT / sizeof( token_t ) };
+    errorTrap_t         trap;
+    lexerStatus_t       status;
+    char *              message;
+    size_t              messageLength;
+    bool                sent;
+
+    ResetLexerContext( &( worker->context ) );
+    worker->result.size = 0;
+    worker->result.limit = SERVER_DECODE_LIMIT;
+
+    SetErrorTrap( &trap, NULL, 0, false, &( worker->diagnostics ) );
+
+    if ( setjmp( trap.jump ) == 0 ) {
+        ImportTokenBuffer( "payload", ( uint8_t * )worker->request, header->length, false, &options, &( worker->context.tokens ), &( worker->context.symbolTable ) );
+        ClearErrorTrap( &trap );
+
+        status = RecomposeBuffer( &( worker->context.tokens ), &( worker->context.symbolTable ), &( worker->result ), &( worker->diagnostics ) );
+    } else {
+        status = LEXER_ERROR;
+    }
+
+    worker->result.limit = 0;
+
+    if ( status == LEXER_ERROR && worker->diagnostics.size > 0 && worker->diagnostics.diagnostics[ worker->diagnostics.size - 1 ].kind == INPUT_TOO_LARGE_ERROR ) {
+        worker->diagnostics.size = 0;
+
+        return SendError( descriptor, "request: Payload decodes to more than the limit of %" PRIu64 " bytes.", ( uint64_t )SERVER_DECODE_LIMIT );
+    }
+
+    message = FormatDiagnostics( &( worker->diagnostics ), &messageLength );
+    sent = SendResponse( descriptor, status, false, message, messageLength, worker->result.data, status == LEXER_ERROR ? 0 : worker->result.size );
+    free( message );
+
+    return sent;
+}
+
+void WakeServer( server_t * server ) {
+/*
+====================
+=
+= WakeServer
+=
+= Wakes the poll loop of a server, so that it takes the connections returned to it and looks at whether it is stopping.
+=
+====================
+*/
+
+    // A full pipe already has the loop woken.
+    while ( write( server->wake[ 1 ], "", 1 ) < 0 && errno == EINTR );
+}
+
+void ReturnConnection( server_t * server, int descriptor ) {
+/*
+====================
+=
+= ReturnConnection
+=
+= Hands a connection a request was answered on back to the poll loop, which gives it to a worker again once its next
+= request comes.
+=
+====================
+*/
+
+    pthread_mutex_lock( &( server->returnedLock ) );
+
+    if ( server->returnedCount == server->returnedCapacity ) {
+        server->returnedCapacity = server->returnedCapacity == 0 ? 64 : 2 * server->returnedCapacity;
+
+        if ( ( server->returned = realloc( server->returned, server->returnedCapacity * sizeof( int ) ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    server->returned[ server->returnedCount++ ] = descriptor;
+
+    pthread_mutex_unlock( &( server->returnedLock ) );
+
+    WakeServer( server );
+}
+
+bool ServeRequest( serverWorker_t * worker, int descriptor ) {
+/*
+====================
+=
+= ServeRequest
+=
+= Answers the next request of a connection. Returns false if the connection is to be closed: the client hung up or
+= stalled past SERVER_REQUEST_TIMEOUT, sent something that is not a request, or asked the server to stop.
+=
+====================
+*/
+
+    server_t *       server = worker->server;
+    requestHeader_t  header;
+
+    if ( !ReadAll( descriptor, &header, sizeof( header ) ) ) {
+        return false;
+    }
+
+    if ( header.magic != SERVER_MAGIC ) {
+        SendError( descriptor, "request: Not a lexer server request." );
+        return false;
+    }
+
+    // The payload of a request that is too large is not read, the connection is closed after the error instead.
+    if ( header.length > SERVER_REQUEST_LIMIT ) {
+        SendError( descriptor, "request: Payload of %" PRIu64 " bytes is larger than the limit of %" PRIu64 ".", header.length, SERVER_REQUEST_LIMIT );
+        return false;
+    }
+
+    if ( header.length + 1 > worker->requestCapacity ) {
+        free( worker->request );
+        worker->requestCapacity = header.length + 1;
+
+        if ( ( worker->request = malloc( worker->requestCapacity ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    if ( !ReadAll( descriptor, worker->request, header.length ) ) {
+        return false;
+    }
+
+    if ( header.type == LEX_REQUEST ) {
+        return ServeLex( worker, descriptor, &header );
+    } else if ( header.type == RECOMPOSE_REQUEST ) {
+        return ServeRecompose( worker, descriptor, &header );
+    } else if ( header.type == SHUTDOWN_REQUEST ) {
+        atomic_store( &( server->stopping ), true );
+        SendResponse( descriptor, LEXER_SUCCESS, false, NULL, 0, NULL, 0 );
+        WakeServer( server );
+        return false;
+    }
+
+    return SendError( descriptor, "request: Unknown request type %d.", header.type );
+}
+
+void * ServerWorker( void * argument ) {
+/*
+====================
+=
+= ServerWorker
+=
+= Answers a request of each connection pushed by the poll loop of a server, with a lexer context and buffers that are
+= kept warm from one request to the next, until it pops the end of the connections. A connection goes back to the poll
+= loop between its requests, so that clients that keep theirs open while idle don't hold a worker.
+=
+====================
+*/
+
+    serverWorker_t *  worker = argument;
+    server_t *        server = worker->server;
+    int               descriptor;
+    bool              keep;
+
+    LexBuffer( &( worker->context ), WARM_UP_SOURCE, strlen( WARM_UP_SOURCE ), false, false, NULL );
+    RecomposeBuffer( &( worker->context.tokens ), &( worker->context.symbolTable ), &( worker->result ), NULL );
+
+    while ( ( descriptor = ( intptr_t )PopRing( &( server->connections ) ) ) >= 0 ) {
+        // Published before stopping is checked, so that a server that stops now either is seen here or sees the
+        // connection and shuts it down.
+        atomic_store( &( worker->connection ), descriptor );
+
+        keep = !atomic_load( &( server->stopping ) ) && ServeRequest( worker, descriptor );
+
+        atomic_store( &( worker->connection ), -1 );
+
+        if ( keep ) {
+            ReturnConnection( server, descriptor );
+        } else {
+            close( descriptor );
+        }
+    }
+
+    return NULL;
+}
+
+void ServeLexer( char * socketPath, int threads, size_t cacheLimit ) {
+/*
+====================
+=
+= ServeLexer
+=
+= Serves lex and recompose requests on a Unix socket at socketPath with threads workers, until a shutdown request. A
+= client keeps its connection for as many requests as it likes, see Server.h for the headers. Token files are cached
+= in memory up to cacheLimit bytes, or without a limit if it is 0.
+=
+= The calling thread polls the socket and every open connection, and pushes a connection to the workers only once a
+= request comes on it, so any number of idle clients can stay connected.
+=
+= Each worker owns a lexer context and buffers that are reused from one request to the next, so that a request costs
+= its lexing and nothing else: no process start, no table setup, no page faults in a fresh heap.
+=
+====================
+*/
+
+    struct sockaddr_un  address = { .sun_family = AF_UNIX };
+    struct timeval      timeout = { .tv_sec = SERVER_REQUEST_TIMEOUT };
+    int                 listener;
+    int                 descriptor;
+    server_t            server;
+    serverWorker_t *    workers;
+    struct pollfd *     polled;             // The wake pipe, the socket and then the idle connections
+    size_t              polledCount = 2;
+    size_t              polledCapacity = 64;
+    char                drain[ 64 ];
+
+    if ( strlen( socketPath ) >= sizeof( address.sun_path ) ) {
+        fprintf( stderr, "%s: Socket path is too long.\n", socketPath );
+        exit( 1 );
+    }
+
+    strcpy( address.sun_path, socketPath );
+
+    if ( ( listener = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 ) {
+        perror( "socket" );
+        exit( 1 );
+    }
+
+    // A socket left by a server that died is replaced, one that a live server answers on is not.
+    if ( connect( listener, ( struct sockaddr * )&address, sizeof( address ) ) == 0 ) {
+        fprintf( stderr, "%s: A server is already running on this socket.\n", socketPath );
+        exit( 1 );
+    }
+
+    close( listener );
+    unlink( socketPath );
+
+    if ( ( listener = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 || bind( listener, ( struct sockaddr * )&address, sizeof( address ) ) != 0 || listen( listener, SERVER_BACKLOG ) != 0 ) {
+        perror( socketPath );
+        exit( 1 );
+    }
+
+    // A client that hangs up before its response is sent is not a reason to stop.
+    signal( SIGPIPE, SIG_IGN );
+
+    if ( pipe( server.wake ) != 0 || fcntl( server.wake[ 0 ], F_SETFL, O_NONBLOCK ) != 0 || fcntl( server.wake[ 1 ], F_SETFL, O_NONBLOCK ) != 0 ) {
+        perror( "pipe" );
+        exit( 1 );
+    }
+
+    if ( ( polled = malloc( polledCapacity * sizeof( struct pollfd ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    polled[ 0 ] = ( struct pollfd ){ server.wake[ 0 ], POLLIN, 0 };
+    polled[ 1 ] = ( struct pollfd ){ listener, POLLIN, 0 };
+
+    server.socketPath = socketPath;
+    server.returned = NULL;
+    server.returnedCount = 0;
+    server.returnedCapacity = 0;
+    pthread_mutex_init( &( server.returnedLock ), NULL );
+    InitializeRing( &( server.connections ), SERVER_BACKLOG );
+    InitializeMemoryCache( &( server.cache ), cacheLimit );
+    atomic_init( &( server.stopping ), false );
+
+    if ( ( workers = malloc( threads * sizeof( serverWorker_t ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        workers[ i ].server = &server;
+        atomic_init( &( workers[ i ].connection ), -1 );
+        workers[ i ].context = InitializeLexerContext();
+        workers[ i ].diagnostics = InitializeDiagnosticList();
+        workers[ i ].request = NULL;
+        workers[ i ].requestCapacity = 0;
+        workers[ i ].result = InitializeOutputBuffer( NULL );
+
+        if ( pthread_create( &( workers[ i ].thread ), NULL, ServerWorker, &workers[ i ] ) != 0 ) {
+            fputs( "Could not create thread.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    while ( !atomic_load( &( server.stopping ) ) ) {
+        if ( poll( polled, polledCount, -1 ) < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+
+            perror( "poll" );
+            atomic_store( &( server.stopping ), true );
+            break;
+        }
+
+        if ( atomic_load( &( server.stopping ) ) ) {
+            break;
+        }
+
+        // Connections with a request, or that were hung up, go to the workers and are polled again once answered.
+        for ( size_t i = 2; i < polledCount; ) {
+            if ( polled[ i ].revents != 0 ) {
+                PushRing( &( server.connections ), ( void * )( intptr_t )polled[ i ].fd );
+                polled[ i ] = polled[ --polledCount ];
+            } else {
+                i++;
+            }
+        }
+
+        if ( polled[ 0 ].revents != 0 ) {
+            while ( read( server.wake[ 0 ], drain, sizeof( drain ) ) > 0 );
+        }
+
+        descriptor = -1;
+
+        if ( polled[ 1 ].revents != 0 && ( descriptor = accept( listener, NULL, NULL ) ) < 0 && errno != EINTR && errno != ECONNABORTED && errno != EAGAIN ) {
+            perror( "accept" );
+            atomic_store( &( server.stopping ), true );
+            break;
+        }
+
+        // A client that stalls in the middle of a request or doesn't read its response is hung up on.
+        if ( descriptor >= 0 ) {
+            setsockopt( descriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+            setsockopt( descriptor, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+        }
+
+        pthread_mutex_lock( &( server.returnedLock ) );
+
+        if ( polledCount + server.returnedCount + 1 > polledCapacity ) {
+            polledCapacity = 2 * ( polledCount + server.returnedCount + 1 );
+
+            if ( ( polled = realloc( polled, polledCapacity * sizeof( struct pollfd ) ) ) == NULL ) {
+                fputs( "Out of memory.\n", stderr );
+                exit( 1 );
+            }
+        }
+
+        for ( size_t i = 0; i < server.returnedCount; i++ ) {
+            polled[ polledCount++ ] = ( struct pollfd ){ server.returned[ i ], POLLIN, 0 };
+        }
+
+        server.returnedCount = 0;
+
+        pthread_mutex_unlock( &( server.returnedLock ) );
+
+        if ( descriptor >= 0 ) {
+            polled[ polledCount++ ] = ( struct pollfd ){ descriptor, POLLIN, 0 };
+        }
+    }
+
+    close( listener );
+    unlink( socketPath );
+
+    for ( size_t i = 2; i < polledCount; i++ ) {
+        close( polled[ i ].fd );
+    }
+
+    // Workers waiting on the rest of a request are woken by shutting its connection down, the others finish theirs.
+    for ( int i = 0; i < threads; i++ ) {
+        if ( ( descriptor = atomic_load( &( workers[ i ].connection ) ) ) >= 0 ) {
+            shutdown( descriptor, SHUT_RD );
+        }
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        PushRing( &( server.connections ), ( void * )( intptr_t )-1 );
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        pthread_join( workers[ i ].thread, NULL );
+        DestroyLexerContext( &( workers[ i ].context ) );
+        DestroyDiagnosticList( workers[ i ].diagnostics );
+        DestroyOutputBuffer( &( workers[ i ].result ) );
+        free( workers[ i ].request );
+    }
+
+    // Connections returned after the poll loop stopped.
+    for ( size_t i = 0; i < server.returnedCount; i++ ) {
+        close( server.returned[ i ] );
+    }
+
+    close( server.wake[ 0 ] );
+    close( server.wake[ 1 ] );
+    free( server.returned );
+    free( polled );
+    free( workers );
+    pthread_mutex_destroy( &( server.returnedLock ) );
+    DestroyMemoryCache( &( server.cache ) );
+    DestroyRing( &( server.connections ) );
+}
+
+lexerStatus_t RequestServer( char * socketPath, requestHeader_t * request, char * inputFilename, char * outputFilename ) {
+/*
+====================
+=
+= RequestServer
+=
+= Sends a request to the server on socketPath with the content of inputFilename as its payload, none for a shutdown,
+= and writes the result to outputFilename. The diagnostics sent back are printed to stderr.
+=
+= Returns the status of the response.
+=
+====================
+*/
+
+    struct sockaddr_un  address = { .sun_family = AF_UNIX };
+    int                 descriptor;
+    responseHeader_t    response;
+    char *              payload = NULL;
+    size_t              length = 0;
+    char *              message;
+    char *              result;
+    FILE *              output;
+    struct iovec        parts[ 2 ];
+
+    if ( strlen( socketPath ) >= sizeof( address.sun_path ) ) {
+        fprintf( stderr, "%s: Socket path is too long.\n", socketPath );
+        exit( 1 );
+    }
+
+    strcpy( address.sun_path, socketPath );
+
+    if ( ( descriptor = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 || connect( descriptor, ( struct sockaddr * )&address, sizeof( address ) ) != 0 ) {
+        perror( socketPath );
+        exit( 1 );
+    }
+
+    if ( request->type != SHUTDOWN_REQUEST ) {
+        payload = ReadBinaryFile( inputFilename, &length );
+    }
+
+    request->magic = SERVER_MAGIC;
+    request->length = length;
+    parts[ 0 ] = ( struct iovec ){ request, sizeof( requestHeader_t ) };
+    parts[ 1 ] = ( struct iovec ){ payload, length };
+
+    if ( !WriteAll( descriptor, parts, 2 ) || !ReadAll( descriptor, &response, sizeof( response ) ) || response.magic != SERVER_MAGIC ) {
+        fprintf( stderr, "%s: The server hung up.\n", socketPath );
+        exit( 1 );
+    }
+
+    free( payload );
+
+    if ( ( message = malloc( response.messageLength + 1 ) ) == NULL || ( result = malloc( response.length + 1 ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    if ( !ReadAll( descriptor, message, response.messageLength ) || !ReadAll( descriptor, result, response.length ) ) {
+        fprintf( stderr, "%s: The server hung up.\n", socketPath );
+        exit( 1 );
+    }
+
+    close( descriptor );
+
+    fwrite( message, 1, response.messageLength, stderr );
+
+    if ( response.status != LEXER_ERROR && request->type != SHUTDOWN_REQUEST ) {
+        if ( ( output = fopen( outputFilename, "wb" ) ) == NULL ) {
+            perror( outputFilename );
+            exit( 1 );
+        }
+
+        if ( fwrite( result, 1, response.length, output ) < response.length || fclose( output ) != 0 ) {
+            fputs( "Error writing to output file.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    free( message );
+    free( result );
+
+    return response.status;
+}
+#else
+void ServeLexer( char * socketPath, int threads, size_t cacheLimit ) {
+    fputs( "The lexer server needs Unix sockets, which this platform does not have.\n", stderr );
+    exit( 1 );
+}
+
+lexerStatus_t RequestServer( char * socketPath, requestHeader_t * request, char * inputFilename, char * outputFilename ) {
+    fputs( "The lexer server needs Unix sockets, which this platform does not have.\n", stderr );
+    exit( 1 );
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "Diagnostic.h"
+
+// First word of every request and response, "%TKD" in memory order on little-endian machines.
+#define SERVER_MAGIC 0x444B5425
+
+// Bytes a request may carry, the lexer counts in ints.
+#ifndef SERVER_REQUEST_LIMIT
+#define SERVER_REQUEST_LIMIT ( ( uint64_t )1 << 30 )
+#endif
+
+// Bytes the tokens and the result of a recompose request may take, a compressed token file can decode to far more than
+// its own length.
+#ifndef SERVER_DECODE_LIMIT
+#define SERVER_DECODE_LIMIT ( 4 * SERVER_REQUEST_LIMIT )
+#endif
+
+// Connections with a request not yet taken by a worker, the server stops polling while this many wait.
+#ifndef SERVER_BACKLOG
+#define SERVER_BACKLOG 64
+#endif
+
+// Seconds a client may take to send the rest of a request or to read its response before it is hung up on.
+#ifndef SERVER_REQUEST_TIMEOUT
+#define SERVER_REQUEST_TIMEOUT 30
+#endif
+
+// Hash buckets of the in-memory token cache of a server.
+#ifndef SERVER_CACHE_BUCKETS
+#define SERVER_CACHE_BUCKETS 4096
+#endif
+
+typedef enum {
+    LEX_REQUEST = 1,        // Payload is C source, the result a token file
+    RECOMPOSE_REQUEST,      // Payload is a token file, the result C source
+    SHUTDOWN_REQUEST,       // No payload, the server stops once the requests in progress are answered
+} requestType_t;
+
+enum requestFlags_t {
+    PUNCH_CARD_FLAG = 1,
+    RECOVER_FLAG = 2,
+    COMPRESS_FLAG = 4,
+    SORT_FLAG = 8,
+};
+
+// Both ends run on the same machine, so the headers are sent in its byte order.
+typedef struct {
+    uint32_t  magic;
+    uint8_t   type;        // A requestType_t
+    uint8_t   flags;       // requestFlags_t, for lex requests
+    uint8_t   revision;    // Of the token file to make, for lex requests
+    uint8_t   reserved;
+    uint64_t  length;      // Of the payload that follows
+} requestHeader_t;
+
+typedef struct {
+    uint32_t  magic;
+    uint8_t   status;          // A lexerStatus_t
+    uint8_t   cached;          // The result came from the token cache
+    uint16_t  reserved;
+    uint64_t  messageLength;   // Of the diagnostics text that follows, one per line
+    uint64_t  length;          // Of the result that follows the text, empty after an error
+} responseHeader_t;
+
+void ServeLexer( char * socketPath, int threads, size_t cacheLimit );
+lexerStatus_t RequestServer( char * socketPath, requestHeader_t * request, char * inputFilename, char * outputFilename );
+#endif
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "SharedSymbolTable.h"
+
+/*
+A shared symbol table interns symbol names for many threads at once and gives every name one id, the order it was
+first interned in, that never changes. Unlike symbolTable_t its ids are not bound to the 747 to 4818 hashes of a single
+file, so the tokens of many files can share them.
+
+Nothing is locked:
+
+    The slots are an open addressing table of pointers to the symbols, a symbol is added by a compare and swap of an
+    empty slot. A thread that loses the swap compares its name with the winner and probes on.
+
+    The names live in an append-only arena of blocks, space is taken from the current block with an atomic add and a
+    new block is pushed with a compare and swap when it runs out. Symbols are never moved or freed before the table.
+
+    The id is taken by the thread that won the slot, right after the swap. Threads finding the symbol before its id is
+    published wait for it, which takes no longer than the two stores that publish it.
+
+The number of slots is fixed, at most half of them are used.
+*/
+
+uint64_t NameHash( const char * name, size_t length ) {
+/*
+====================
+=
+= NameHash
+=
+= FNV-1a hash of a symbol name.
+=
+====================
+*/
+
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for ( size_t i = 0; i < length; i++ ) {
+        hash = ( hash ^ ( uint8_t )name[ i ] ) * 0x100000001B3;
+    }
+
+    return hash;
+}
+
+sharedSymbolTable_t InitializeSharedSymbolTable( size_t slotCount ) {
+/*
+====================
+=
+= InitializeSharedSymbolTable
+=
+= Initializes the sharedSymbolTable_t data structure, slotCount must be a power of two. The table holds up to half of
+= slotCount symbols.
+=
+= The table must not be copied once it is in use.
+=
+====================
+*/
+
+    sharedSymbolTable_t  table;
+
+    table.slotCount = slotCount;
+
+    if ( ( table.slots = calloc( slotCount, sizeof( sharedSymbol_t * ) ) ) == NULL || ( table.symbols = calloc( slotCount / 2, sizeof( sharedSymbol_t * ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    atomic_init( &table.count, 0 );
+    atomic_init( &table.blocks, NULL );
+
+    return table;
+}
+
+sharedSymbol_t * NewSharedSymbol( sharedSymbolTable_t * table, uint64_t hash, const char * name, size_t length ) {
+/*
+====================
+=
+= NewSharedSymbol
+=
+= Takes space for a symbol from the arena and fills it, without adding it to the slots.
+=
+====================
+*/
+
+    size_t            size = ( sizeof( sharedSymbol_t ) + length + 1 + 7 ) & ~( size_t )7;
+    symbolBlock_t *   block = atomic_load_explicit( &table->blocks, memory_order_acquire );
+    symbolBlock_t *   newBlock;
+    sharedSymbol_t *  symbol;
+    size_t            offset;
+
+    while ( true ) {
+        if ( block != NULL && ( offset = atomic_fetch_add_explicit( &block->used, size, memory_order_relaxed ) ) + size <= block->size ) {
+            symbol = ( sharedSymbol_t * )( block->data + offset );
+            break;
+        }
+
+        // The block is full, push a new one. Names longer than a block get a block of their own.
+        if ( ( newBlock = malloc( sizeof( symbolBlock_t ) + ( size > SYMBOL_BLOCK_SIZE ? size : SYMBOL_BLOCK_SIZE ) ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+
+        newBlock->next = block;
+        newBlock->size = size > SYMBOL_BLOCK_SIZE ? size : SYMBOL_BLOCK_SIZE;
+        atomic_init( &newBlock->used, size );
+
+        if ( atomic_compare_exchange_strong_explicit( &table->blocks, &block, newBlock, memory_order_acq_rel, memory_order_acquire ) ) {
+            symbol = ( sharedSymbol_t * )newBlock->data;
+            break;
+        }
+
+        // Another thread pushed a block first, block is now that one.
+        free( newBlock );
+    }
+
+    symbol->hash = hash;
+    atomic_init( &symbol->id, 0 );
+    symbol->length = length;
+    memcpy( symbol->name, name, length );
+    symbol->name[ length ] = '\0';
+
+    return symbol;
+}
+
+uint32_t InternSymbol( sharedSymbolTable_t * table, const char * name, size_t length ) {
+/*
+====================
+=
+= InternSymbol
+=
+= Returns the id of a symbol name, adding it to the table if it is not there yet. Safe to call from any number of
+= threads at once.
+=
+====================
+*/
+
+    uint64_t          hash = NameHash( name, length );
+    size_t            slot = hash & ( table->slotCount - 1 );
+    sharedSymbol_t *  symbol = NULL;
+    sharedSymbol_t *  found;
+    uint32_t          id;
+
+    while ( true ) {
+        found = atomic_load_explicit( &table->slots[ slot ], memory_order_acquire );
+
+        if ( found == NULL ) {
+            // The symbol is made once, even if the swap has to be tried at a later slot.
+            if ( symbol == NULL ) {
+                symbol = NewSharedSymbol( table, hash, name, length );
+            }
+
+            if ( atomic_compare_exchange_strong_explicit( &table->slots[ slot ], &found, symbol, memory_order_acq_rel, memory_order_acquire ) ) {
+                if ( ( id = atomic_fetch_add_explicit( &table->count, 1, memory_order_relaxed ) ) >= table->slotCount / 2 ) {
+                    fputs( "Maximum number of identifiers reached.\n", stderr );
+                    exit( 1 );
+                }
+
+                atomic_store_explicit( &table->symbols[ id ], symbol, memory_order_release );
+                atomic_store_explicit( &symbol->id, id + 1, memory_order_release );
+
+                return id;
+            }
+
+            // Another thread took the slot, found is now its symbol.
+        }
+
+        if ( found->hash == hash && found->length == length && !memcmp( found->name, name, length ) ) {
+            while ( ( id = atomic_load_explicit( &found->id, memory_order_acquire ) ) == 0 );
+
+            // A symbol made for a lost slot stays unused in the arena.
+            return id - 1;
+        }
+
+        slot = ( slot + 1 ) & ( table->slotCount - 1 );
+    }
+}
+
+const char * SharedSymbolName( sharedSymbolTable_t * table, uint32_t id ) {
+/*
+====================
+=
+= SharedSymbolName
+=
+= Returns the name of the symbol with an id returned by InternSymbol.
+=
+====================
+*/
+
+    return atomic_load_explicit( &table->symbols[ id ], memory_order_acquire )->name;
+}
+
+uint32_t SharedSymbolCount( sharedSymbolTable_t * table ) {
+/*
+====================
+=
+= SharedSymbolCount
+=
+= Returns the number of symbols in the table. While other threads are interning, some of the last ids may not be
+= readable yet.
+=
+====================
+*/
+
+    return atomic_load_explicit( &table->count, memory_order_acquire );
+}
+
+void DestroySharedSymbolTable( sharedSymbolTable_t * table ) {
+    symbolBlock_t *  block = atomic_load( &table->blocks );
+    symbolBlock_t *  next;
+
+    while ( block != NULL ) {
+        next = block->next;
+        free( block );
+        block = next;
+    }
+
+    free( table->slots );
+    free( table->symbols );
+}
\ No newline at end of file
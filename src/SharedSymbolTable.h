@@ -0,0 +1,38 @@
+#ifndef SHAREDSYMBOLTABLE_H
+#define SHAREDSYMBOLTABLE_H
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Size of the blocks of the name arena.
+#define SYMBOL_BLOCK_SIZE ( 1 << 16 )
+
+typedef struct {
+    uint64_t          hash;
+    _Atomic uint32_t  id;
+    uint32_t          length;
+    char              name[];
+} sharedSymbol_t;
+
+typedef struct _symbolBlock_t {
+    struct _symbolBlock_t *  next;
+    size_t                   size;
+    _Atomic size_t           used;
+    char                     data[];
+} symbolBlock_t;
+
+typedef struct {
+    sharedSymbol_t * _Atomic *  slots;
+    size_t                      slotCount;
+    sharedSymbol_t * _Atomic *  symbols;
+    _Atomic uint32_t            count;
+    symbolBlock_t * _Atomic     blocks;
+} sharedSymbolTable_t;
+
+uint64_t NameHash( const char * name, size_t length );
+sharedSymbolTable_t InitializeSharedSymbolTable( size_t slotCount );
+uint32_t InternSymbol( sharedSymbolTable_t * table, const char * name, size_t length );
+const char * SharedSymbolName( sharedSymbolTable_t * table, uint32_t id );
+uint32_t SharedSymbolCount( sharedSymbolTable_t * table );
+void DestroySharedSymbolTable( sharedSymbolTable_t * table );
+#endif
\ No newline at end of file
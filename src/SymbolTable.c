@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include "Hash.h"
 #include "TokenList.h"
+#include "Diagnostic.h"
 
 typedef char * symbol_t;
 
@@ -13,10 +14,15 @@ typedef struct _chartList_t {
     struct _chartList_t *  next;
 } chartStack_t;
 
+typedef struct {
+    chartStack_t *  next;
+} chartCursor_t;
+
 typedef struct {
     symbol_t *      table;
     chartStack_t *  chart;
     chartStack_t *  chartTail;
+    chartStack_t *  chartFree;
 } symbolTable_t;
 
 
@@ -37,125 +43,183 @@ symbolTable_t InitializeSymbolTable() {
 
     // The table field is the table itself.
     if ( ( symbolTable.table = calloc( SYMBOL_TABLE_SIZE, sizeof( symbol_t ) ) ) == NULL ) {
-        fputs( "Out of memory.\n", stderr );
-        exit( 1 );
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
     }
 
     // The chart field is a stack containing all symbols, useful when serializing the table.
     symbolTable.chart = NULL;
     symbolTable.chartTail = NULL;
 
+    // Chart entries left by ResetSymbolTable, reused before allocating new ones.
+    symbolTable.chartFree = NULL;
+
     return symbolTable;
 }
 
+void PushChart( symbolTable_t * symbolTable, token_t hash ) {
+/*
+====================
+=
+= PushChart
+=
+= Pushes a hash to the chart of a symbol table.
+=
+====================
+*/
+
+    chartStack_t * entry = symbolTable->chartFree;
+
+    if ( entry != NULL ) {
+        symbolTable->chartFree = entry->next;
+    } else if ( ( entry = malloc( sizeof( chartStack_t ) ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    if ( symbolTable->chart == NULL ) {
+        symbolTable->chart = entry;
+    } else {
+        ( symbolTable->chartTail )->next = entry;
+    }
+
+    symbolTable->chartTail = entry;
+    
+    ( symbolTable->chartTail )->hash = hash;
+    ( symbolTable->chartTail )->next = NULL;
+}
+
 token_t PushSymbol( symbolTable_t * symbolTable, symbol_t symbol, size_t length ) {
     token_t  hash = IdentifierHash( symbol, length );
     bool     cycled = false;
 
     // Circular probing
     while ( symbolTable->table[ hash ] != NULL ) {
-        // First check if the table is full
+        // If the token is already on the table return its hash
+        if ( !strncmp( symbol, symbolTable->table[ hash ], length ) && symbolTable->table[ hash ][ length ] == '\0' ) {
+            return hash;
+        }
+
+        hash++;
+
+        // Check if the table is full before cycling back to the first identifier hash
         if ( hash == SYMBOL_TABLE_SIZE ) {
             if ( cycled ) {
-                fputs( "Maximum number of identifiers reached.\n", stderr );
-                exit( 1 );
-            // Cycle
-            } else {
-                hash = 747;
-                cycled = true;
-            }
-        }
-        
-        if ( symbolTable->table[ hash ] == NULL ) {
-            // Position found
-            break;
-        } else {
-            // If the token is already on the table return its hash
-            if ( !memcmp( symbol, symbolTable->table[ hash ], length ) ) {
-                return hash;
+                RaiseError( symbol, SYMBOL_TABLE_FULL_ERROR, "Maximum number of identifiers reached." );
             }
+
+            hash = 747;
+            cycled = true;
         }
-        
-        hash++;
     }
 
-    // Push the symbol if it is new
-        if ( ( symbolTable->table[ hash ] = malloc( ( strlen( symbol ) + 1 ) * sizeof( char ) ) ) == NULL ) {
-            fputs( "Out of memory.\n", stderr );
-            exit( 1 );
-        }
-        memcpy( symbolTable->table[ hash ], symbol, length );
-        symbolTable->table[ hash ][ length ] = '\0';
+    // Push the symbol if it is new. It is charted first so that ResetSymbolTable finds the slot even if the copy fails.
+    PushChart( symbolTable, hash );
 
-    // Push to the chart
-    if ( symbolTable->chart == NULL ) {
-        if ( ( symbolTable->chart = malloc( sizeof( chartStack_t ) ) ) == NULL ) {
-            fputs( "Out of memory.\n", stderr );
-            exit( 1 );
-        }
-        symbolTable->chartTail = symbolTable->chart;
-    } else {
-        if ( ( ( symbolTable->chartTail )->next = malloc( sizeof( chartStack_t ) ) ) == NULL ) {
-            fputs( "Out of memory.\n", stderr );
-            exit( 1 );
-        }
-        symbolTable->chartTail = ( symbolTable->chartTail )->next;
+    if ( ( symbolTable->table[ hash ] = malloc( ( length + 1 ) * sizeof( char ) ) ) == NULL ) {
+        RaiseError( symbol, OUT_OF_MEMORY_ERROR, "Out of memory." );
     }
-    
-    ( symbolTable->chartTail )->hash = hash;
-    ( symbolTable->chartTail )->next = NULL;
+    memcpy( symbolTable->table[ hash ], symbol, length );
+    symbolTable->table[ hash ][ length ] = '\0';
 
     return hash;
 }
 
 bool PushSymbolToHash( symbolTable_t * symbolTable, symbol_t symbol, size_t length, token_t hash ) {
+/*
+====================
+=
+= PushSymbolToHash
+=
+= Pushes a symbol to a given hash, used when the hashes are already known, e.g. when reading a token file.
+=
+= Returns true if a symbol already at that hash was overridden.
+=
+====================
+*/
+
     bool override = false;
     
-    if ( symbolTable->table[ hash ] == NULL ) {
-        free( symbolTable->table[ hash ] );    
+    if ( symbolTable->table[ hash ] != NULL ) {
+        free( symbolTable->table[ hash ] );
         override = true;
-    }  
+    } else {
+        PushChart( symbolTable, hash );
+    }
     
-    symbolTable->table[ hash ] = malloc( ( length + 1 ) * sizeof( char ) );
-    strcpy( symbolTable->table[ hash ], symbol );
+    if ( ( symbolTable->table[ hash ] = malloc( ( length + 1 ) * sizeof( char ) ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+    memcpy( symbolTable->table[ hash ], symbol, length );
+    symbolTable->table[ hash ][ length ] = '\0';
 
     return override;
 }
 
-bool ReadChart( chartStack_t * chart, token_t * hash ) {
+chartCursor_t InitializeChartCursor( chartStack_t * chart ) {
+/*
+====================
+=
+= InitializeChartCursor
+=
+= Initializes a cursor at an entry of a chart, usually the first one of a symbol table. Like token cursors, chart cursors
+= can read at once from any threads as long as the chart doesn't change.
+=
+====================
+*/
+
+    chartCursor_t  cursor;
+
+    cursor.next = chart;
+
+    return cursor;
+}
+
+size_t ReadChart( chartCursor_t * cursor, size_t count, token_t * hashes ) {
 /*
 ====================
 =
 = ReadChart
 =
-= Reads symbols from the chart successively, the hash pointer is filled with the hash read.
+= Reads up to count hashes from the chart at the position of a cursor into hashes and moves the cursor past them.
 =
-= The first call must be with a valid chart value, subsequent calls may have any value for chart.
+= Returns the number of hashes read, fewer than count only at the end of the chart.
 =
-= The function returns true if as symbol was read and false when a symbol could not be read because the end was reached.
+====================
+*/
+
+    size_t  read = 0;
+
+    for ( ; read < count && cursor->next != NULL; read++ ) {
+        hashes[ read ] = cursor->next->hash;
+        cursor->next = cursor->next->next;
+    }
+
+    return read;
+}
+
+void ResetSymbolTable( symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= ResetSymbolTable
+=
+= Empties a symbol table so that it can be used for another file. Only the slots of the symbols in the chart are
+= cleared, and the chart entries are kept for the next symbols.
 =
 ====================
 */
-    
-    #define NOPE ( ( void * )1 )
-    
-    static chartStack_t * tail = NOPE;
 
-    if ( tail == NOPE ) {
-        tail = chart;
+    for ( chartStack_t * tracer = symbolTable->chart; tracer != NULL; tracer = tracer->next ) {
+        free( symbolTable->table[ tracer->hash ] );
+        symbolTable->table[ tracer->hash ] = NULL;
     }
-    
-    if ( tail == NULL ) {
-        tail = NOPE;
-        return false;
-    } else {
-        *hash = tail->hash;
-        tail = tail->next;
 
-        return true;
+    if ( symbolTable->chart != NULL ) {
+        ( symbolTable->chartTail )->next = symbolTable->chartFree;
+        symbolTable->chartFree = symbolTable->chart;
     }
 
-    #undef NOPE
+    symbolTable->chart = NULL;
+    symbolTable->chartTail = NULL;
 }
 
 void DestroySymbolTable( symbolTable_t symbolTable ) {
@@ -170,6 +234,11 @@ void DestroySymbolTable( symbolTable_t symbolTable ) {
         free( tracer );
         tracer = next;
     }
+
+    for ( tracer = symbolTable.chartFree; tracer != NULL; tracer = next ) {
+        next = tracer->next;
+        free( tracer );
+    }
     
     // Free the table
     free( symbolTable.table );
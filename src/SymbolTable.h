@@ -13,15 +13,23 @@ typedef struct _chartList_t {
     struct _chartList_t *  next;
 } chartStack_t;
 
+typedef struct {
+    chartStack_t *  next;
+} chartCursor_t;
+
 typedef struct {
     symbol_t *      table;
     chartStack_t *  chart;
     chartStack_t *  chartTail;
+    chartStack_t *  chartFree;
 } symbolTable_t;
 
 symbolTable_t InitializeSymbolTable();
+void PushChart( symbolTable_t * symbolTable, token_t hash );
 token_t PushSymbol( symbolTable_t * table, symbol_t symbol, size_t length );
 bool PushSymbolToHash( symbolTable_t * symbolTable, symbol_t symbol, size_t length, token_t hash );
-bool ReadChart( chartStack_t * chart, token_t * hash );
+chartCursor_t InitializeChartCursor( chartStack_t * chart );
+size_t ReadChart( chartCursor_t * cursor, size_t count, token_t * hashes );
+void ResetSymbolTable( symbolTable_t * symbolTable );
 void DestroySymbolTable( symbolTable_t table );
 #endif
\ No newline at end of file
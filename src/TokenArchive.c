@@ -0,0 +1,466 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "OutputBuffer.h"
+#include "SharedSymbolTable.h"
+#include "TokenFile.h"
+#include "TokenArchive.h"
+#include "Decompose.h"
+#include "File.h"
+
+/*
+A token archive holds the tokens of many source files in a single %TOK-002 file, with one symbol dictionary shared by
+all of them. It has three sections instead of the token and symbol sections of a token file, plus the usual checksum
+section:
+
+    ARCHIVE_DICTIONARY_SECTION (RAW_ENCODING)
+        count NUL-terminated symbol names, each name stored once for the whole archive.
+
+    ARCHIVE_DIRECTORY_SECTION (VARINT_ENCODING)
+        count entries, one per file, of varints: name length, followed by the name bytes, token encoding, token count,
+        token offset, token size, symbol count, symbol offset and symbol size. Offsets are in the data section.
+
+    ARCHIVE_DATA_SECTION (RAW_ENCODING)
+        The token bytes of each file, encoded as a token section (VARINT_ENCODING or RANS_ENCODING), and its symbol map:
+        symbol count pairs of varints, the hash of the symbol in the tokens of the file and the index of its name in
+        the dictionary.
+
+Hashes are kept per file, so the tokens of a file are stored exactly as in its own token file and only the names are
+shared. The reader maps the archive into memory and decodes only the files that are asked for.
+*/
+
+// Slots of the shared dictionary, it holds up to half as many names.
+#define ARCHIVE_DICTIONARY_SLOTS ( 1 << 20 )
+
+typedef struct {
+    char *          input;
+    outputBuffer_t  tokens;
+    outputBuffer_t  symbols;        // Pairs of uint32_t, the hash of a symbol and its id in the shared dictionary
+    uint64_t        tokenCount;
+    uint64_t        symbolCount;
+} archiveJob_t;
+
+typedef struct {
+    archiveJob_t *         jobs;
+    int                    count;
+    int                    next;
+    pthread_mutex_t        lock;
+    sharedSymbolTable_t *  dictionary;
+    bool                   punchCardExtension;
+    tokenFileOptions_t *   options;
+} archiveWork_t;
+
+void EncodeArchiveMember( archiveJob_t * job, sharedSymbolTable_t * dictionary, bool punchCardExtension, tokenFileOptions_t * options ) {
+/*
+====================
+=
+= EncodeArchiveMember
+=
+= Decomposes a file of an archive and encodes its tokens, interning its symbols in the dictionary. The symbol map is
+= kept with the dictionary ids, which depend on the order the threads got to the symbols in, until they are renumbered.
+=
+====================
+*/
+
+    tokenList_t    tokens;
+    symbolTable_t  symbolTable;
+    chartCursor_t  chart;
+    token_t        hash;
+    uint32_t       pair[ 2 ];
+
+    Decompose( job->input, punchCardExtension, &tokens, &symbolTable );
+
+    job->tokens = InitializeOutputBuffer( NULL );
+    job->symbols = InitializeOutputBuffer( NULL );
+    job->tokenCount = tokens.size;
+    job->symbolCount = 0;
+
+    EncodeBlock( &tokens, 0, tokens.size, &( job->tokens ), options->compress );
+
+    chart = InitializeChartCursor( symbolTable.chart );
+
+    while ( ReadChart( &chart, 1, &hash ) ) {
+        pair[ 0 ] = hash;
+        pair[ 1 ] = InternSymbol( dictionary, symbolTable.table[ hash ], strlen( symbolTable.table[ hash ] ) );
+        PushBytes( &( job->symbols ), ( char * )pair, sizeof( pair ) );
+        job->symbolCount++;
+    }
+
+    DestroySymbolTable( symbolTable );
+    DestroyTokenList( tokens );
+}
+
+void * ArchiveWorker( void * argument ) {
+/*
+====================
+=
+= ArchiveWorker
+=
+= Encodes the files of an archive until none are left.
+=
+====================
+*/
+
+    archiveWork_t *  work = argument;
+    int              next;
+
+    while ( true ) {
+        pthread_mutex_lock( &( work->lock ) );
+        next = work->next < work->count ? work->next++ : -1;
+        pthread_mutex_unlock( &( work->lock ) );
+
+        if ( next == -1 ) {
+            return NULL;
+        }
+
+        EncodeArchiveMember( &( work->jobs[ next ] ), work->dictionary, work->punchCardExtension, work->options );
+    }
+}
+
+void ExportTokenArchive( char * outputFilename, char ** inputFilenames, int inputCount, int threads, bool punchCardExtension, tokenFileOptions_t * options ) {
+/*
+====================
+=
+= ExportTokenArchive
+=
+= Decomposes a number of source files on threads threads and exports them all to a single token archive.
+=
+= The threads intern the symbols of their files straight into the shared dictionary, in the order they get to them.
+= The dictionary is then renumbered in the order of the first use of every symbol, going through the files in the
+= order they were given, so that the archive is the same whatever the number of threads.
+=
+====================
+*/
+
+    sharedSymbolTable_t  dictionary = InitializeSharedSymbolTable( ARCHIVE_DICTIONARY_SLOTS );
+    archiveWork_t        work = { NULL, inputCount, 0, PTHREAD_MUTEX_INITIALIZER, &dictionary, punchCardExtension, options };
+    section_t            sections[ 3 ] = { { 0 } };
+    outputBuffer_t       sectionData[ 3 ];
+    pthread_t            threadIds[ threads ];
+    uint32_t             symbolCount;
+    uint32_t *           order;
+    uint32_t *           renumbered;
+    uint32_t             pair[ 2 ];
+    uint64_t             offset;
+    FILE *               output;
+
+    if ( ( work.jobs = malloc( inputCount * sizeof( archiveJob_t ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    for ( int i = 0; i < inputCount; i++ ) {
+        work.jobs[ i ].input = inputFilenames[ i ];
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        if ( pthread_create( &threadIds[ i ], NULL, ArchiveWorker, &work ) != 0 ) {
+            fputs( "Could not start a thread.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        pthread_join( threadIds[ i ], NULL );
+    }
+
+    pthread_mutex_destroy( &( work.lock ) );
+
+    symbolCount = SharedSymbolCount( &dictionary );
+
+    // order holds the dictionary ids in the order they are written, renumbered the index each id is written at. One
+    // more entry than needed keeps an archive without symbols from allocating nothing.
+    if ( ( order = malloc( ( symbolCount + 1 ) * sizeof( uint32_t ) ) ) == NULL || ( renumbered = malloc( ( symbolCount + 1 ) * sizeof( uint32_t ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    memset( renumbered, 0xFF, ( symbolCount + 1 ) * sizeof( uint32_t ) );
+
+    for ( uint32_t i = 0, next = 0; i < ( uint32_t )inputCount; i++ ) {
+        for ( size_t j = 0; j < work.jobs[ i ].symbols.size; j += sizeof( pair ) ) {
+            memcpy( pair, work.jobs[ i ].symbols.data + j, sizeof( pair ) );
+
+            if ( renumbered[ pair[ 1 ] ] == UINT32_MAX ) {
+                order[ next ] = pair[ 1 ];
+                renumbered[ pair[ 1 ] ] = next++;
+            }
+        }
+    }
+
+    sectionData[ 0 ] = InitializeOutputBuffer( NULL );
+    sectionData[ 1 ] = InitializeOutputBuffer( NULL );
+    sectionData[ 2 ] = InitializeOutputBuffer( NULL );
+
+    for ( uint32_t i = 0; i < symbolCount; i++ ) {
+        const char * name = SharedSymbolName( &dictionary, order[ i ] );
+
+        PushBytes( &sectionData[ 0 ], name, strlen( name ) + 1 );
+    }
+
+    // The files are laid out in the order they were given.
+    for ( int i = 0; i < inputCount; i++ ) {
+        archiveJob_t * job = &( work.jobs[ i ] );
+
+        // Directory entry
+        PushVarint( &sectionData[ 1 ], strlen( job->input ) );
+        PushBytes( &sectionData[ 1 ], job->input, strlen( job->input ) );
+        PushVarint( &sectionData[ 1 ], options->compress ? RANS_ENCODING : VARINT_ENCODING );
+        PushVarint( &sectionData[ 1 ], job->tokenCount );
+
+        offset = sectionData[ 2 ].size;
+        PushBytes( &sectionData[ 2 ], job->tokens.data, job->tokens.size );
+        PushVarint( &sectionData[ 1 ], offset );
+        PushVarint( &sectionData[ 1 ], job->tokens.size );
+
+        // Symbol map
+        offset = sectionData[ 2 ].size;
+
+        for ( size_t j = 0; j < job->symbols.size; j += sizeof( pair ) ) {
+            memcpy( pair, job->symbols.data + j, sizeof( pair ) );
+            PushVarint( &sectionData[ 2 ], pair[ 0 ] );
+            PushVarint( &sectionData[ 2 ], renumbered[ pair[ 1 ] ] );
+        }
+
+        PushVarint( &sectionData[ 1 ], job->symbolCount );
+        PushVarint( &sectionData[ 1 ], offset );
+        PushVarint( &sectionData[ 1 ], sectionData[ 2 ].size - offset );
+
+        DestroyOutputBuffer( &( job->tokens ) );
+        DestroyOutputBuffer( &( job->symbols ) );
+    }
+
+    sections[ 0 ].type = ARCHIVE_DICTIONARY_SECTION;
+    sections[ 0 ].encoding = RAW_ENCODING;
+    sections[ 0 ].count = symbolCount;
+    sections[ 1 ].type = ARCHIVE_DIRECTORY_SECTION;
+    sections[ 1 ].encoding = VARINT_ENCODING;
+    sections[ 1 ].count = inputCount;
+    sections[ 2 ].type = ARCHIVE_DATA_SECTION;
+    sections[ 2 ].encoding = RAW_ENCODING;
+
+    if ( ( output = fopen( outputFilename, "wb" ) ) == NULL ) {
+        perror( outputFilename );
+        exit( 1 );
+    }
+
+    WriteTokenFile( output, 2, sections, sectionData, 3 );
+    fclose( output );
+
+    for ( int i = 0; i < 3; i++ ) {
+        DestroyOutputBuffer( &sectionData[ i ] );
+    }
+
+    DestroySharedSymbolTable( &dictionary );
+    free( renumbered );
+    free( order );
+    free( work.jobs );
+}
+
+tokenArchive_t OpenTokenArchive( char * inputFilename, bool verify ) {
+/*
+====================
+=
+= OpenTokenArchive
+=
+= Maps a token archive into memory and reads its dictionary, the archive must be closed with CloseTokenArchive.
+=
+= With verify set the whole archive is checked against its checksums first.
+=
+====================
+*/
+
+    tokenArchive_t   archive = { 0 };
+    uint32_t         sectionCount;
+    section_t        section;
+    const char *     name;
+    const char *     end;
+    bool             found[ 3 ] = { false, false, false };
+
+    archive.filename = inputFilename;
+    archive.file = MapFile( inputFilename, &archive.length );
+
+    if ( archive.length < 12 || memcmp( archive.file, "%TOK-002", 8 ) ) {
+        fprintf( stderr, "%s: Not a token archive.\n", inputFilename );
+        exit( 1 );
+    }
+
+    if ( verify ) {
+        VerifyTokenFile( inputFilename, archive.file, archive.length, false );
+    }
+
+    memcpy( &sectionCount, archive.file + 8, 4 );
+
+    if ( ( archive.length - 12 ) / sizeof( section_t ) < sectionCount ) {
+        fprintf( stderr, "Malformed archive \"%s\": Section table is truncated.\n", inputFilename );
+        exit( 1 );
+    }
+
+    for ( uint32_t i = 0; i < sectionCount; i++ ) {
+        memcpy( &section, archive.file + 12 + i * sizeof( section_t ), sizeof( section_t ) );
+
+        if ( section.offset > archive.length || section.size > archive.length - section.offset ) {
+            fprintf( stderr, "Malformed archive \"%s\": Section %u is out of the file bounds.\n", inputFilename, i );
+            exit( 1 );
+        }
+
+        if ( section.type == ARCHIVE_DICTIONARY_SECTION ) {
+            if ( section.count > section.size || ( section.size > 0 && archive.file[ section.offset + section.size - 1 ] != '\0' ) ) {
+                fprintf( stderr, "Malformed archive \"%s\": Dictionary section is truncated.\n", inputFilename );
+                exit( 1 );
+            }
+
+            if ( ( archive.symbols = malloc( ( section.count + 1 ) * sizeof( char * ) ) ) == NULL ) {
+                fputs( "Out of memory.\n", stderr );
+                exit( 1 );
+            }
+
+            // The names point into the mapped file.
+            name = ( char * )archive.file + section.offset;
+            end = name + section.size;
+
+            for ( archive.symbolCount = 0; archive.symbolCount < section.count && name < end; archive.symbolCount++ ) {
+                archive.symbols[ archive.symbolCount ] = name;
+                name += strlen( name ) + 1;
+            }
+
+            found[ 0 ] = true;
+        } else if ( section.type == ARCHIVE_DIRECTORY_SECTION ) {
+            archive.directory = archive.file + section.offset;
+            archive.directoryEnd = archive.directory + section.size;
+            archive.memberCount = section.count;
+            found[ 1 ] = true;
+        } else if ( section.type == ARCHIVE_DATA_SECTION ) {
+            archive.data = archive.file + section.offset;
+            archive.dataSize = section.size;
+            found[ 2 ] = true;
+        }
+    }
+
+    if ( !found[ 0 ] || !found[ 1 ] || !found[ 2 ] ) {
+        fprintf( stderr, "%s: Not a token archive.\n", inputFilename );
+        exit( 1 );
+    }
+
+    return archive;
+}
+
+bool ReadArchiveMember( tokenArchive_t * archive, const uint8_t ** position, archiveMember_t * member ) {
+/*
+====================
+=
+= ReadArchiveMember
+=
+= Reads the directory entry at position and moves position to the next one.
+=
+= position must start at archive->directory. Returns false at the end of the directory.
+=
+====================
+*/
+
+    uint64_t  nameLength;
+
+    if ( *position >= archive->directoryEnd ) {
+        return false;
+    }
+
+    if ( !ReadVarint( position, archive->directoryEnd, &nameLength ) || nameLength > ( uint64_t )( archive->directoryEnd - *position ) ) {
+        fprintf( stderr, "Malformed archive \"%s\": Directory could not be decoded.\n", archive->filename );
+        exit( 1 );
+    }
+
+    member->name = ( char * )*position;
+    member->nameLength = nameLength;
+    *position += nameLength;
+
+    if ( !ReadVarint( position, archive->directoryEnd, &member->encoding )
+      || !ReadVarint( position, archive->directoryEnd, &member->tokenCount )
+      || !ReadVarint( position, archive->directoryEnd, &member->tokenOffset )
+      || !ReadVarint( position, archive->directoryEnd, &member->tokenSize )
+      || !ReadVarint( position, archive->directoryEnd, &member->symbolCount )
+      || !ReadVarint( position, archive->directoryEnd, &member->symbolOffset )
+      || !ReadVarint( position, archive->directoryEnd, &member->symbolSize ) ) {
+        fprintf( stderr, "Malformed archive \"%s\": Directory could not be decoded.\n", archive->filename );
+        exit( 1 );
+    }
+
+    if ( member->tokenOffset > archive->dataSize || member->tokenSize > archive->dataSize - member->tokenOffset
+      || member->symbolOffset > archive->dataSize || member->symbolSize > archive->dataSize - member->symbolOffset ) {
+        fprintf( stderr, "Malformed archive \"%s\": File \"%.*s\" is out of the data section bounds.\n", archive->filename, ( int )member->nameLength, member->name );
+        exit( 1 );
+    }
+
+    return true;
+}
+
+bool FindArchiveMember( tokenArchive_t * archive, char * name, archiveMember_t * member ) {
+/*
+====================
+=
+= FindArchiveMember
+=
+= Looks a file up by name in the directory of the archive.
+=
+= Returns false if the archive has no such file.
+=
+====================
+*/
+
+    const uint8_t *  position = archive->directory;
+    size_t           length = strlen( name );
+
+    while ( ReadArchiveMember( archive, &position, member ) ) {
+        if ( member->nameLength == length && !memcmp( member->name, name, length ) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ImportArchiveMember( tokenArchive_t * archive, archiveMember_t * member, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= ImportArchiveMember
+=
+= Imports the tokens and the symbols of one file of the archive.
+=
+= tokens and symbolTable are initialized by the function and the caller is responsible for destroying them.
+=
+====================
+*/
+
+    const uint8_t *  position = archive->data + member->symbolOffset;
+    const uint8_t *  end = position + member->symbolSize;
+    uint64_t         hash;
+    uint64_t         index;
+
+    *tokens = InitializeTokenList();
+    *symbolTable = InitializeSymbolTable();
+
+    for ( uint64_t i = 0; i < member->symbolCount; i++ ) {
+        if ( !ReadVarint( &position, end, &hash ) || !ReadVarint( &position, end, &index ) || index >= archive->symbolCount ) {
+            fprintf( stderr, "Malformed archive \"%s\": Symbols of \"%.*s\" could not be decoded.\n", archive->filename, ( int )member->nameLength, member->name );
+            exit( 1 );
+        }
+
+        ImportSymbol( archive->filename, 2, symbolTable, hash, ( char * )archive->symbols[ index ] );
+    }
+
+    if ( ( member->encoding != VARINT_ENCODING && member->encoding != RANS_ENCODING )
+      || !DecodeBlocks( archive->data + member->tokenOffset, member->tokenSize, member->encoding, member->tokenCount, tokens ) ) {
+        fprintf( stderr, "Malformed archive \"%s\": Tokens of \"%.*s\" could not be decoded.\n", archive->filename, ( int )member->nameLength, member->name );
+        exit( 1 );
+    }
+}
+
+void CloseTokenArchive( tokenArchive_t * archive ) {
+    free( archive->symbols );
+    UnmapFile( archive->file, archive->length );
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef TOKENARCHIVE_H
+#define TOKENARCHIVE_H
+#include <stdint.h>
+#include <stdbool.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "TokenFile.h"
+
+typedef struct {
+    const char *  name;
+    size_t        nameLength;
+    uint64_t      encoding;
+    uint64_t      tokenCount;
+    uint64_t      tokenOffset;
+    uint64_t      tokenSize;
+    uint64_t      symbolCount;
+    uint64_t      symbolOffset;
+    uint64_t      symbolSize;
+} archiveMember_t;
+
+typedef struct {
+    char *            filename;
+    uint8_t *         file;
+    size_t            length;
+    const char **     symbols;
+    uint64_t          symbolCount;
+    const uint8_t *   directory;
+    const uint8_t *   directoryEnd;
+    uint64_t          memberCount;
+    const uint8_t *   data;
+    uint64_t          dataSize;
+} tokenArchive_t;
+
+void ExportTokenArchive( char * outputFilename, char ** inputFilenames, int inputCount, int threads, bool punchCardExtension, tokenFileOptions_t * options );
+tokenArchive_t OpenTokenArchive( char * inputFilename, bool verify );
+bool ReadArchiveMember( tokenArchive_t * archive, const uint8_t ** position, archiveMember_t * member );
+bool FindArchiveMember( tokenArchive_t * archive, char * name, archiveMember_t * member );
+void ImportArchiveMember( tokenArchive_t * archive, archiveMember_t * member, tokenList_t * tokens, symbolTable_t * symbolTable );
+void CloseTokenArchive( tokenArchive_t * archive );
+#endif
\ No newline at end of file
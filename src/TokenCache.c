@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "File.h"
+#include "Crc32c.h"
+#include "TokenFile.h"
+#include "TokenCache.h"
+#include "Checkpoint.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#include <sys/utime.h>
+#define MakeDirectory( path ) _mkdir( path )
+#define getpid _getpid
+#else
+#include <unistd.h>
+#include <utime.h>
+#define MakeDirectory( path ) mkdir( path, 0777 )
+#endif
+
+// Temporary files older than this were left by a process that died while publishing, and are removed by a trim.
+#define TOKEN_CACHE_STALE_SECONDS 3600
+
+typedef struct {
+    char *    name;
+    uint64_t  size;
+    time_t    used;
+} cacheEntry_t;
+
+uint64_t HashContent( const void * data, size_t size ) {
+/*
+====================
+=
+= HashContent
+=
+= Returns a 64 bit hash of size bytes of data, 8 bytes at a time: each word is mixed in with a rotate, xor and multiply,
+= and the result goes through the finalizer of MurmurHash3 so that every bit depends on every input bit.
+=
+====================
+*/
+
+    const uint8_t *  bytes = data;
+    uint64_t         hash = size * 0x9E3779B97F4A7C15;
+    uint64_t         word;
+
+    for ( ; size >= 8; size -= 8, bytes += 8 ) {
+        memcpy( &word, bytes, 8 );
+        hash = ( ( hash << 5 | hash >> 59 ) ^ word ) * 0x517CC1B727220A95;
+    }
+
+    word = 0;
+    memcpy( &word, bytes, size );
+    hash = ( ( hash << 5 | hash >> 59 ) ^ word ) * 0x517CC1B727220A95;
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCD;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+tokenCache_t OpenTokenCache( char * directory, uint64_t limit ) {
+/*
+====================
+=
+= OpenTokenCache
+=
+= Opens the token cache in directory, creating the directory if needed. Many processes may use the same cache at once.
+=
+====================
+*/
+
+    tokenCache_t cache;
+
+    if ( MakeDirectory( directory ) == -1 && errno != EEXIST ) {
+        perror( directory );
+        exit( 1 );
+    }
+
+    if ( ( cache.directory = malloc( strlen( directory ) + 1 ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    strcpy( cache.directory, directory );
+    cache.limit = limit;
+    cache.published = 0;
+    cache.temporaries = 0;
+    pthread_mutex_init( &( cache.lock ), NULL );
+
+    return cache;
+}
+
+void TokenCacheKey( const char * source, size_t length, bool punchCardExtension, bool recover, tokenFileOptions_t * options, char * key ) {
+/*
+====================
+=
+= TokenCacheKey
+=
+= Fills key, of TOKEN_CACHE_KEY_SIZE characters, with the name of the cache entry of a source file of length bytes
+= decomposed with the given options: the CRC32C and HashContent of its bytes, its length and every option that changes
+= the token file made from it.
+=
+====================
+*/
+
+    snprintf( key, TOKEN_CACHE_KEY_SIZE, "%08" PRIx32 "%016" PRIx64 "-%" PRIx64 "-v%dr%dp%dl%dc%ds%di%zu.tok",
+              Crc32c( 0, source, length ), HashContent( source, length ), ( uint64_t )length, TOKEN_CACHE_VERSION,
+              options->revision, punchCardExtension, recover, options->compress, options->sortSymbols, options->indexInterval );
+}
+
+char * TokenCachePath( tokenCache_t * cache, const char * name ) {
+/*
+====================
+=
+= TokenCachePath
+=
+= Returns the path of a file of the cache, which must be freed by the caller.
+=
+====================
+*/
+
+    char * path = malloc( strlen( cache->directory ) + strlen( name ) + 2 );
+
+    if ( path == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    sprintf( path, "%s/%s", cache->directory, name );
+
+    return path;
+}
+
+char * MapCacheEntry( tokenCache_t * cache, const char * name, size_t * length ) {
+/*
+====================
+=
+= MapCacheEntry
+=
+= Maps the entry of the cache called name and marks it as just used. Returns NULL if there is no such entry, the
+= mapping must be unmapped with UnmapFile otherwise.
+=
+====================
+*/
+
+    char *  path = TokenCachePath( cache, name );
+    char *  entry;
+
+    // Another process may remove the entry at any time, the mapping keeps it readable once made.
+    if ( ( entry = TryMapFile( path, length ) ) != NULL ) {
+        // The modification time of an entry is when it was last used, for TrimTokenCache.
+        utime( path, NULL );
+    }
+
+    free( path );
+
+    return entry;
+}
+
+bool PublishCacheEntry( tokenCache_t * cache, const char * name, const void * data, size_t length ) {
+/*
+====================
+=
+= PublishCacheEntry
+=
+= Adds length bytes of data to the cache as the entry called name, which ends in one of the extensions TrimTokenCache
+= knows.
+=
+= The entry is written under a temporary name unique to the process and the call, and renamed to its name once
+= complete, so a reader never sees half an entry and concurrent writers of the same entry, which write the same bytes,
+= just replace each other's. Returns false if the entry could not be written, the cache is then left as it was.
+=
+====================
+*/
+
+    char      temporaryName[ TOKEN_CACHE_KEY_SIZE + 48 ];
+    char *    temporary;
+    char *    path = TokenCachePath( cache, name );
+    FILE *    fp;
+    uint64_t  number;
+    bool      written = false;
+
+    pthread_mutex_lock( &( cache->lock ) );
+    number = cache->temporaries++;
+    pthread_mutex_unlock( &( cache->lock ) );
+
+    snprintf( temporaryName, sizeof( temporaryName ), "%s.%ld.%" PRIu64 ".tmp", name, ( long )getpid(), number );
+    temporary = TokenCachePath( cache, temporaryName );
+
+    if ( ( fp = fopen( temporary, "wb" ) ) != NULL ) {
+        written = fwrite( data, 1, length, fp ) == length;
+        written = fclose( fp ) == 0 && written;
+
+#ifdef _WIN32
+        // rename doesn't replace files on Windows.
+        remove( path );
+#endif
+
+        if ( !written || rename( temporary, path ) != 0 ) {
+            remove( temporary );
+            written = false;
+        }
+    }
+
+    if ( written ) {
+        pthread_mutex_lock( &( cache->lock ) );
+        cache->published += length;
+        pthread_mutex_unlock( &( cache->lock ) );
+    }
+
+    free( temporary );
+    free( path );
+
+    return written;
+}
+
+bool FetchTokenEntry( tokenCache_t * cache, char * key, char * outputFilename ) {
+/*
+====================
+=
+= FetchTokenEntry
+=
+= Looks up the entry of a key made by TokenCacheKey. On a hit the entry is mapped and written to outputFilename, and
+= marked as just used, and the function returns true. On a miss nothing is written and it returns false.
+=
+====================
+*/
+
+    size_t  length;
+    char *  entry;
+    FILE *  output;
+    bool    hit = false;
+
+    if ( ( entry = MapCacheEntry( cache, key, &length ) ) != NULL ) {
+        if ( ( output = fopen( outputFilename, "wb" ) ) == NULL ) {
+            perror( outputFilename );
+            exit( 1 );
+        }
+
+        if ( fwrite( entry, 1, length, output ) < length || fclose( output ) != 0 ) {
+            fputs( "Error writing to output file.\n", stderr );
+            exit( 1 );
+        }
+
+        UnmapFile( entry, length );
+
+        hit = true;
+    }
+
+    return hit;
+}
+
+bool FetchTokenFile( tokenCache_t * cache, char * inputFilename, char * outputFilename, bool punchCardExtension, bool recover, tokenFileOptions_t * options, char * key ) {
+/*
+====================
+=
+= FetchTokenFile
+=
+= Looks up the token file of a source file in the cache, filling key (TOKEN_CACHE_KEY_SIZE characters) with its
+= entry name for a later PublishTokenFile.
+=
+= On a hit the entry is written to outputFilename, see FetchTokenEntry, and the function returns true: the source was
+= only hashed. On a miss nothing is written and it returns false.
+=
+====================
+*/
+
+    size_t  length;
+    char *  source = MapFile( inputFilename, &length );
+
+    TokenCacheKey( source, length, punchCardExtension, recover, options, key );
+    UnmapFile( source, length );
+
+    return FetchTokenEntry( cache, key, outputFilename );
+}
+
+bool PublishTokenFile( tokenCache_t * cache, char * key, char * outputFilename ) {
+/*
+====================
+=
+= PublishTokenFile
+=
+= Adds the token file just written to outputFilename to the cache, under the key filled by FetchTokenFile or made by
+= TokenCacheKey, see PublishCacheEntry. Returns false if the entry could not be written.
+=
+====================
+*/
+
+    size_t  length;
+    char *  tokenFile = MapFile( outputFilename, &length );
+    bool    written = PublishCacheEntry( cache, key, tokenFile, length );
+
+    UnmapFile( tokenFile, length );
+
+    return written;
+}
+
+int CompareCacheEntries( const void * a, const void * b ) {
+/*
+====================
+=
+= CompareCacheEntries
+=
+= Orders cache entries least recently used first.
+=
+====================
+*/
+
+    const cacheEntry_t * first = a;
+    const cacheEntry_t * second = b;
+
+    return ( first->used > second->used ) - ( first->used < second->used );
+}
+
+void TrimTokenCache( tokenCache_t * cache ) {
+/*
+====================
+=
+= TrimTokenCache
+=
+= Removes the least recently used entries of the cache, token files and checkpoints, until they take no more than its
+= limit, if it has one, along with the temporary files left by processes that died while publishing.
+=
+= Other processes may trim the same cache at once, an entry one of them already removed is just skipped.
+=
+====================
+*/
+
+    DIR *           stream = opendir( cache->directory );
+    struct dirent * file;
+    struct stat     status;
+    cacheEntry_t *  entries = NULL;
+    size_t          count = 0;
+    size_t          capacity = 0;
+    uint64_t        total = 0;
+    size_t          length;
+    char *          path;
+
+    if ( stream == NULL ) {
+        return;
+    }
+
+    while ( ( file = readdir( stream ) ) != NULL ) {
+        length = strlen( file->d_name );
+        path = TokenCachePath( cache, file->d_name );
+
+        if ( stat( path, &status ) != 0 || S_ISDIR( status.st_mode ) ) {
+            free( path );
+        } else if ( length > 4 && !strcmp( file->d_name + length - 4, ".tmp" ) ) {
+            if ( time( NULL ) - status.st_mtime > TOKEN_CACHE_STALE_SECONDS ) {
+                remove( path );
+            }
+
+            free( path );
+        } else if ( ( length > 4 && !strcmp( file->d_name + length - 4, ".tok" ) ) || ( length > strlen( CHECKPOINT_EXTENSION ) && !strcmp( file->d_name + length - strlen( CHECKPOINT_EXTENSION ), CHECKPOINT_EXTENSION ) ) ) {
+            if ( count == capacity ) {
+                capacity = capacity == 0 ? 256 : capacity * 2;
+
+                if ( ( entries = realloc( entries, capacity * sizeof( cacheEntry_t ) ) ) == NULL ) {
+                    fputs( "Out of memory.\n", stderr );
+                    exit( 1 );
+                }
+            }
+
+            entries[ count++ ] = ( cacheEntry_t ){ path, status.st_size, status.st_mtime };
+            total += status.st_size;
+        } else {
+            free( path );
+        }
+    }
+
+    closedir( stream );
+
+    if ( count > 0 ) {
+        qsort( entries, count, sizeof( cacheEntry_t ), CompareCacheEntries );
+    }
+
+    for ( size_t i = 0; i < count; i++ ) {
+        if ( cache->limit > 0 && total > cache->limit ) {
+            remove( entries[ i ].name );
+            total -= entries[ i ].size;
+        }
+
+        free( entries[ i ].name );
+    }
+
+    free( entries );
+}
+
+void CloseTokenCache( tokenCache_t * cache ) {
+/*
+====================
+=
+= CloseTokenCache
+=
+= Trims the cache if this process added to it and it has a limit, and frees it.
+=
+====================
+*/
+
+    if ( cache->published > 0 && cache->limit > 0 ) {
+        TrimTokenCache( cache );
+    }
+
+    pthread_mutex_destroy( &( cache->lock ) );
+    free( cache->directory );
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef TOKENCACHE_H
+#define TOKENCACHE_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "TokenFile.h"
+
+// Bytes the entries of a token cache may take before the least recently used ones are removed.
+#ifndef TOKEN_CACHE_SIZE
+#define TOKEN_CACHE_SIZE ( ( uint64_t )1 << 30 )
+#endif
+
+// Part of every key, to be raised whenever the lexer or the exporter change the token files they make.
+#define TOKEN_CACHE_VERSION 1
+
+#define TOKEN_CACHE_KEY_SIZE 128
+
+typedef struct {
+    char *           directory;
+    uint64_t         limit;        // Bytes the entries may take, 0 for no limit
+    uint64_t         published;    // Bytes added by this process, the cache is only trimmed if some were
+    uint64_t         temporaries;  // Temporary files made by this process, for their names
+    pthread_mutex_t  lock;
+} tokenCache_t;
+
+uint64_t HashContent( const void * data, size_t size );
+tokenCache_t OpenTokenCache( char * directory, uint64_t limit );
+void TokenCacheKey( const char * source, size_t length, bool punchCardExtension, bool recover, tokenFileOptions_t * options, char * key );
+char * MapCacheEntry( tokenCache_t * cache, const char * name, size_t * length );
+bool PublishCacheEntry( tokenCache_t * cache, const char * name, const void * data, size_t length );
+bool FetchTokenEntry( tokenCache_t * cache, char * key, char * outputFilename );
+bool FetchTokenFile( tokenCache_t * cache, char * inputFilename, char * outputFilename, bool punchCardExtension, bool recover, tokenFileOptions_t * options, char * key );
+bool PublishTokenFile( tokenCache_t * cache, char * key, char * outputFilename );
+void TrimTokenCache( tokenCache_t * cache );
+void CloseTokenCache( tokenCache_t * cache );
+#endif
\ No newline at end of file
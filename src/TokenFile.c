@@ -0,0 +1,1572 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "OutputBuffer.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
+#include "Tokens.h"
+#include "File.h"
+#include "Rans.h"
+#include "Crc32c.h"
+#include "TokenStream.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+/*
+A %TOK-002 file is laid out as follows, all integers are little-endian:
+
+    8 bytes              Signature (%TOK-002)
+    4 bytes              Number of sections
+    32 bytes * sections  Section table, one section_t per section
+    ...                  Section data, at the offsets given in the section table
+
+Sections of unknown types are skipped by the reader, so new sections can be added without a new revision.
+
+The last section is the checksum section (RAW_ENCODING): the CRC32C of the header and the section table, followed by the
+CRC32C of each of the count sections before it, all as 32-bit integers. Files without one are not checked.
+
+The token section (VARINT_ENCODING) stores each token id as an unsigned LEB128 varint. Integer constant payloads and the
+characters of string literals, header names and character constants are varints as well, so ASCII text takes a byte
+per character. Floating constants are stored as their raw words. The count field is the number of 4-byte token words
+the section decodes to, the same as the size of the token list.
+
+A token section may instead use RANS_ENCODING, where the VARINT_ENCODING bytes are compressed with the order-0 rANS
+coder in Rans.c. The frequency model is stored at the start of the section.
+
+With an index the token section is made of blocks of a fixed number of lines each, every block decoding on its own
+(for RANS_ENCODING every block is a separate rANS block). The index section (RAW_ENCODING) starts with the number of
+lines per block as a 64-bit integer, followed by count pairs of 64-bit integers: the index of the first token word of a
+block and the offset of the block in the token section. Block k starts at line k * interval + 1. Lines are counted by
+the newline tokens, so they are the lines of the recomposed source, where multi-line comments take a single line.
+
+Without an index, a RANS_ENCODING token section of more than EXPORT_BLOCK_TOKENS token words is made of rANS blocks of
+about that many words each, so that they can be compressed in parallel. A VARINT_ENCODING section is the same whether
+it was encoded in blocks or not.
+
+The symbol section (VARINT_ENCODING) stores each symbol as a varint hash followed by its NUL-terminated name, in chart
+order. The count field is the number of symbols.
+
+A symbol section may instead use FRONT_CODED_ENCODING, where the symbols are sorted by name and every name only stores
+what it doesn't share with the previous one: each symbol is a varint shared prefix length, a varint suffix length, a
+varint hash and the suffix bytes. Every SYMBOL_RESTART_INTERVAL symbols the prefix starts over, and the section ends
+with the offsets of those restart points as 32-bit integers followed by their number as a 32-bit integer. A name is
+found by a binary search on the restart points, then a scan of at most SYMBOL_RESTART_INTERVAL symbols.
+*/
+
+static_assert( sizeof( section_t ) == 32, "section_t is not 32 bytes." );
+
+typedef struct {
+    const char *  data;
+    size_t        size;
+    uint64_t      offset;
+} filePiece_t;
+
+typedef struct {
+    size_t            count;
+    size_t            next;
+    bool              write;
+    pthread_mutex_t   lock;
+
+    // Encoding
+    tokenList_t *     tokens;
+    size_t *          bounds;
+    outputBuffer_t *  blocks;
+    bool              compress;
+
+    // Writing
+    filePiece_t *     pieces;
+    int               descriptor;
+    atomic_bool       failed;        // A piece could not be written, raised on the calling thread
+} exportWork_t;
+
+payload_t TokenPayload( token_t token, size_t * words ) {
+/*
+====================
+=
+= TokenPayload
+=
+= Returns the kind of payload that follows a token in a token list and fills words with the number of payload words.
+=
+= For CHARACTER_SEQUENCE_PAYLOAD words is 1, the length word, which is then followed by that many characters.
+=
+====================
+*/
+
+    switch ( token ) {
+        case CHARACTER_STRING_LITERAL_TOKEN:
+        case UTF_8_STRING_LITERAL_TOKEN:
+        case WCHAR_UNDERSCORE_T_STRING_LITERAL_TOKEN:
+        case UTF_16_STRING_LITERAL_TOKEN:
+        case UTF_32_STRING_LITERAL_TOKEN:
+        case HEADER_NAME_LESS_GREATER_TOKEN:
+        case HEADER_NAME_QUOTES_TOKEN:
+        case ERROR_TOKEN:
+            *words = 1;
+            return CHARACTER_SEQUENCE_PAYLOAD;
+        case CHARACTER_CONSTANT_TOKEN:
+        case UTF_8_CHARACTER_CONSTANT_TOKEN:
+        case WCHAR_UNDERSCORE_T_CHARACTER_CONSTANT_TOKEN:
+        case UTF_16_CHARACTER_CONSTANT_TOKEN:
+        case UTF_32_CHARACTER_CONSTANT_TOKEN:
+            *words = 1;
+            return CHARACTER_PAYLOAD;
+        case INT_CONSTANT_TOKEN:
+        case UNSIGNED_INT_CONSTANT_TOKEN:
+        case LONG_INT_CONSTANT_TOKEN:
+        case UNSIGNED_LONG_INT_CONSTANT_TOKEN:
+            *words = 1;
+            return INTEGER_PAYLOAD;
+        case LONG_LONG_INT_CONSTANT_TOKEN:
+        case UNSIGNED_LONG_LONG_INT_CONSTANT_TOKEN:
+            *words = 2;
+            return INTEGER_PAYLOAD;
+        case FLOAT_CONSTANT_TOKEN:
+        case UNDERSCORE_DECIMAL32_CONSTANT_TOKEN:
+            *words = 1;
+            return FLOATING_PAYLOAD;
+        case DOUBLE_CONSTANT_TOKEN:
+        case UNDERSCORE_DECIMAL64_CONSTANT_TOKEN:
+            *words = 2;
+            return FLOATING_PAYLOAD;
+        case LONG_DOUBLE_CONSTANT_TOKEN:
+        case UNDERSCORE_DECIMAL128_CONSTANT_TOKEN:
+            *words = 4;
+            return FLOATING_PAYLOAD;
+        default:
+            *words = 0;
+            return NO_PAYLOAD;
+    }
+}
+
+size_t TokenWords( tokenList_t * tokens, size_t position ) {
+/*
+====================
+=
+= TokenWords
+=
+= Returns the number of words taken by the token at position and its payload, never going past the end of the list.
+=
+====================
+*/
+
+    size_t  words;
+    size_t  remaining = tokens->size - position;
+
+    if ( TokenPayload( tokens->tokens[ position ], &words ) == CHARACTER_SEQUENCE_PAYLOAD && remaining > 1 ) {
+        words += tokens->tokens[ position + 1 ];
+    }
+
+    return words + 1 < remaining ? words + 1 : remaining;
+}
+
+size_t SkipLines( tokenList_t * tokens, size_t position, size_t lines ) {
+/*
+====================
+=
+= SkipLines
+=
+= Returns the position of the token that follows the lines-th newline token from position, or the size of the list if
+= there are not that many lines left.
+=
+====================
+*/
+
+    while ( lines > 0 && position < tokens->size ) {
+        if ( tokens->tokens[ position ] == '\n' ) {
+            lines--;
+        }
+
+        position += TokenWords( tokens, position );
+    }
+
+    return position;
+}
+
+void PushVarint( outputBuffer_t * output, uint64_t value ) {
+/*
+====================
+=
+= PushVarint
+=
+= Pushes an unsigned LEB128 varint: 7 bits per byte, least significant first, with the high bit set on all bytes but
+= the last.
+=
+====================
+*/
+
+    char  bytes[ 10 ];
+    int   length = 0;
+
+    do {
+        bytes[ length ] = value & 0x7F;
+        value >>= 7;
+
+        if ( value != 0 ) {
+            bytes[ length ] |= 0x80;
+        }
+
+        length++;
+    } while ( value != 0 );
+
+    PushBytes( output, bytes, length );
+}
+
+bool ReadVarint( const uint8_t ** position, const uint8_t * end, uint64_t * value ) {
+/*
+====================
+=
+= ReadVarint
+=
+= Reads an unsigned LEB128 varint at position and advances position past it.
+=
+= Returns false if the varint runs past end or is longer than 64 bits.
+=
+====================
+*/
+
+    int  shift = 0;
+
+    *value = 0;
+
+    while ( *position < end && shift < 64 ) {
+        uint8_t byte = *( *position )++;
+
+        *value |= ( uint64_t )( byte & 0x7F ) << shift;
+
+        if ( !( byte & 0x80 ) ) {
+            return true;
+        }
+
+        shift += 7;
+    }
+
+    return false;
+}
+
+void EncodeTokens( tokenList_t * tokens, size_t first, size_t last, outputBuffer_t * output ) {
+/*
+====================
+=
+= EncodeTokens
+=
+= Encodes the tokens from first up to, but not including, last into a VARINT_ENCODING token section.
+=
+= first must be at a token, not inside the payload of one.
+=
+====================
+*/
+
+    size_t     position = first;
+    token_t    token;
+    size_t     words;
+    payload_t  payload;
+
+    while ( position < last ) {
+        token = tokens->tokens[ position++ ];
+
+        PushVarint( output, token );
+        payload = TokenPayload( token, &words );
+
+        // The characters that follow the length word are varints too.
+        if ( payload == CHARACTER_SEQUENCE_PAYLOAD && position < last ) {
+            words += tokens->tokens[ position ];
+        }
+
+        while ( words > 0 && position < last ) {
+            if ( payload == FLOATING_PAYLOAD ) {
+                PushBytes( output, ( char * )&( tokens->tokens[ position ] ), sizeof( token_t ) );
+            } else {
+                PushVarint( output, tokens->tokens[ position ] );
+            }
+
+            position++;
+            words--;
+        }
+    }
+}
+
+bool DecodeTokens( const uint8_t * data, size_t size, uint64_t count, tokenList_t * tokens ) {
+/*
+====================
+=
+= DecodeTokens
+=
+= Decodes a VARINT_ENCODING token section, appending the tokens to tokens.
+=
+= Returns false if the section is malformed or doesn't decode to count tokens.
+=
+====================
+*/
+
+    const uint8_t *  position = data;
+    const uint8_t *  end = data + size;
+    uint64_t         value;
+    size_t           words;
+    payload_t        payload;
+    token_t          word;
+    size_t           first = tokens->size;
+
+    while ( position < end ) {
+        if ( !ReadVarint( &position, end, &value ) || value > UINT32_MAX ) {
+            return false;
+        }
+
+        PushToken( tokens, value );
+        payload = TokenPayload( value, &words );
+
+        while ( words > 0 ) {
+            if ( payload == FLOATING_PAYLOAD ) {
+                if ( ( size_t )( end - position ) < sizeof( token_t ) ) {
+                    return false;
+                }
+
+                memcpy( &word, position, sizeof( token_t ) );
+                position += sizeof( token_t );
+            } else {
+                if ( !ReadVarint( &position, end, &value ) || value > UINT32_MAX ) {
+                    return false;
+                }
+
+                word = value;
+
+                // The length word of a character sequence is followed by that many characters.
+                if ( payload == CHARACTER_SEQUENCE_PAYLOAD ) {
+                    payload = CHARACTER_PAYLOAD;
+                    words += word;
+                }
+            }
+
+            PushToken( tokens, word );
+            words--;
+        }
+    }
+
+    return tokens->size - first == count;
+}
+
+void EncodeSymbols( symbolTable_t * symbolTable, outputBuffer_t * output, uint64_t * count ) {
+/*
+====================
+=
+= EncodeSymbols
+=
+= Encodes the symbols of a symbol table, in chart order, into a VARINT_ENCODING symbol section.
+=
+= count is filled with the number of symbols encoded.
+=
+====================
+*/
+
+    chartCursor_t  chart = InitializeChartCursor( symbolTable->chart );
+    token_t        hash;
+
+    *count = 0;
+
+    while ( ReadChart( &chart, 1, &hash ) ) {
+        PushVarint( output, hash );
+        PushBytes( output, symbolTable->table[ hash ], strlen( symbolTable->table[ hash ] ) + 1 );
+        ( *count )++;
+    }
+}
+
+int CompareSymbols( const void * a, const void * b ) {
+    return strcmp( **( symbol_t ** )a, **( symbol_t ** )b );
+}
+
+void EncodeSortedSymbols( symbolTable_t * symbolTable, outputBuffer_t * output, uint64_t * count ) {
+/*
+====================
+=
+= EncodeSortedSymbols
+=
+= Encodes the symbols of a symbol table, sorted by name, into a FRONT_CODED_ENCODING symbol section.
+=
+= count is filled with the number of symbols encoded.
+=
+====================
+*/
+
+    symbol_t **       names;
+    outputBuffer_t    restarts = InitializeOutputBuffer( NULL );
+    chartCursor_t     chart = InitializeChartCursor( symbolTable->chart );
+    token_t           hash;
+    size_t            shared;
+    size_t            length;
+    uint32_t          offset;
+    uint32_t          restartCount = 0;
+
+    *count = 0;
+
+    for ( chartStack_t * tracer = symbolTable->chart; tracer != NULL; tracer = tracer->next ) {
+        ( *count )++;
+    }
+
+    // Pointers to the table entries are sorted, so that a name still gives its hash by its position in the table.
+    if ( ( names = malloc( ( *count + 1 ) * sizeof( symbol_t * ) ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    *count = 0;
+
+    while ( ReadChart( &chart, 1, &hash ) ) {
+        names[ ( *count )++ ] = &( symbolTable->table[ hash ] );
+    }
+
+    qsort( names, *count, sizeof( symbol_t * ), CompareSymbols );
+
+    for ( uint64_t i = 0; i < *count; i++ ) {
+        shared = 0;
+
+        if ( i % SYMBOL_RESTART_INTERVAL == 0 ) {
+            offset = output->size;
+            PushBytes( &restarts, ( char * )&offset, 4 );
+            restartCount++;
+        } else {
+            while ( ( *names[ i ] )[ shared ] != '\0' && ( *names[ i ] )[ shared ] == ( *names[ i - 1 ] )[ shared ] ) {
+                shared++;
+            }
+        }
+
+        length = strlen( *names[ i ] );
+
+        PushVarint( output, shared );
+        PushVarint( output, length - shared );
+        PushVarint( output, names[ i ] - symbolTable->table );
+        PushBytes( output, *names[ i ] + shared, length - shared );
+    }
+
+    PushBytes( output, restarts.data, restarts.size );
+    PushBytes( output, ( char * )&restartCount, 4 );
+
+    DestroyOutputBuffer( &restarts );
+    free( names );
+}
+
+bool ReadSortedSymbol( const uint8_t ** position, const uint8_t * end, outputBuffer_t * name, uint64_t * hash ) {
+/*
+====================
+=
+= ReadSortedSymbol
+=
+= Reads the symbol at position in a FRONT_CODED_ENCODING symbol section, name must hold the name of the previous symbol
+= and is replaced by the NUL-terminated name of this one.
+=
+= Returns false if the symbol is malformed.
+=
+====================
+*/
+
+    uint64_t  shared;
+    uint64_t  length;
+
+    if ( !ReadVarint( position, end, &shared ) || !ReadVarint( position, end, &length ) || !ReadVarint( position, end, hash )
+      || shared > name->size || length > ( uint64_t )( end - *position ) ) {
+        return false;
+    }
+
+    name->size = shared;
+    PushBytes( name, ( char * )*position, length );
+    PushByte( name, '\0' );
+    name->size--;
+    *position += length;
+
+    return memchr( name->data, '\0', name->size ) == NULL;
+}
+
+bool SortedSymbolRestarts( const uint8_t * data, size_t size, const uint8_t ** restarts, uint32_t * restartCount ) {
+/*
+====================
+=
+= SortedSymbolRestarts
+=
+= Finds the restart points at the end of a FRONT_CODED_ENCODING symbol section.
+=
+= Returns false if the section is too short for them.
+=
+====================
+*/
+
+    if ( size < 4 ) {
+        return false;
+    }
+
+    memcpy( restartCount, data + size - 4, 4 );
+
+    if ( ( size - 4 ) / 4 < *restartCount ) {
+        return false;
+    }
+
+    *restarts = data + size - 4 - *restartCount * 4;
+
+    return true;
+}
+
+bool DecodeSortedSymbols( char * inputFilename, const uint8_t * data, size_t size, uint64_t count, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= DecodeSortedSymbols
+=
+= Decodes a FRONT_CODED_ENCODING symbol section, pushing the symbols to symbolTable.
+=
+= Returns false if the section is malformed.
+=
+====================
+*/
+
+    const uint8_t *  position = data;
+    const uint8_t *  end;
+    uint32_t         restartCount;
+    uint64_t         hash;
+    outputBuffer_t   name;
+
+    if ( !SortedSymbolRestarts( data, size, &end, &restartCount ) ) {
+        return false;
+    }
+
+    name = InitializeOutputBuffer( NULL );
+
+    for ( uint64_t i = 0; i < count; i++ ) {
+        if ( !ReadSortedSymbol( &position, end, &name, &hash ) ) {
+            DestroyOutputBuffer( &name );
+            return false;
+        }
+
+        ImportSymbol( inputFilename, 2, symbolTable, hash, name.data );
+    }
+
+    DestroyOutputBuffer( &name );
+
+    return position == end;
+}
+
+bool FindSortedSymbol( const uint8_t * data, size_t size, const char * name, token_t * hash ) {
+/*
+====================
+=
+= FindSortedSymbol
+=
+= Looks a name up in a FRONT_CODED_ENCODING symbol section without decoding the whole section, hash is filled with the
+= hash of the symbol if it is found.
+=
+= Returns false if the section has no such name.
+=
+====================
+*/
+
+    const uint8_t *  restarts;
+    const uint8_t *  position;
+    const uint8_t *  end;
+    uint32_t         restartCount;
+    uint32_t         offset;
+    uint32_t         low = 0;
+    uint32_t         high;
+    uint64_t         symbol;
+    outputBuffer_t   key;
+    int              comparison = 1;
+
+    if ( !SortedSymbolRestarts( data, size, &restarts, &restartCount ) || restartCount == 0 ) {
+        return false;
+    }
+
+    key = InitializeOutputBuffer( NULL );
+    high = restartCount - 1;
+
+    // Find the last restart point whose name is not after the name looked up, restart points hold whole names.
+    while ( low < high ) {
+        uint32_t middle = low + ( high - low + 1 ) / 2;
+
+        memcpy( &offset, restarts + middle * 4, 4 );
+        position = data + offset;
+        key.size = 0;
+
+        if ( offset >= ( size_t )( restarts - data ) || !ReadSortedSymbol( &position, restarts, &key, &symbol ) ) {
+            break;
+        }
+
+        if ( strcmp( key.data, name ) <= 0 ) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    // Scan the symbols from that restart point up to the next one.
+    memcpy( &offset, restarts + low * 4, 4 );
+    position = data + offset;
+    end = restarts;
+    key.size = 0;
+
+    if ( low + 1 < restartCount ) {
+        memcpy( &offset, restarts + ( low + 1 ) * 4, 4 );
+        end = data + offset;
+    }
+
+    if ( position > restarts || end > restarts ) {
+        end = position;
+    }
+
+    while ( position < end && ReadSortedSymbol( &position, end, &key, &symbol ) ) {
+        if ( ( comparison = strcmp( key.data, name ) ) >= 0 ) {
+            break;
+        }
+    }
+
+    DestroyOutputBuffer( &key );
+
+    if ( comparison == 0 ) {
+        *hash = symbol;
+    }
+
+    return comparison == 0;
+}
+
+void * ExportWorker( void * argument ) {
+/*
+====================
+=
+= ExportWorker
+=
+= Encodes blocks of a token section into their own buffers until none are left, or writes pieces of a file to their
+= offsets.
+=
+====================
+*/
+
+    exportWork_t *  work = argument;
+    size_t          next;
+
+    while ( true ) {
+        pthread_mutex_lock( &( work->lock ) );
+        next = work->next < work->count ? work->next++ : SIZE_MAX;
+        pthread_mutex_unlock( &( work->lock ) );
+
+        if ( next == SIZE_MAX ) {
+            return NULL;
+        }
+
+        if ( work->write ) {
+#ifndef _WIN32
+            if ( !WriteAt( work->descriptor, work->pieces[ next ].data, work->pieces[ next ].size, work->pieces[ next ].offset ) ) {
+                atomic_store( &( work->failed ), true );
+            }
+#endif
+        } else {
+            work->blocks[ next ] = InitializeOutputBuffer( NULL );
+            EncodeBlock( work->tokens, work->bounds[ next ], work->bounds[ next + 1 ], &( work->blocks[ next ] ), work->compress );
+        }
+    }
+}
+
+void RunExportWorkers( exportWork_t * work, int threads, bool write ) {
+/*
+====================
+=
+= RunExportWorkers
+=
+= Runs one pass of ExportWorker on threads threads, or on the calling thread alone for a single thread.
+=
+====================
+*/
+
+    pthread_t threadIds[ threads > 1 ? threads : 1 ];
+
+    work->next = 0;
+    work->write = write;
+
+    if ( threads <= 1 ) {
+        ExportWorker( work );
+        return;
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        if ( pthread_create( &threadIds[ i ], NULL, ExportWorker, work ) != 0 ) {
+            fputs( "Could not start a thread.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    for ( int i = 0; i < threads; i++ ) {
+        pthread_join( threadIds[ i ], NULL );
+    }
+}
+
+bool WriteTokenFileBlocks( FILE * output, int revision, section_t * sections, outputBuffer_t * sectionData, uint32_t sectionCount, outputBuffer_t * blocks, size_t blockCount, int threads ) {
+/*
+====================
+=
+= WriteTokenFileBlocks
+=
+= Writes the header, the section table and the section data of a sectioned token file.
+=
+= The offset and size of each section are filled in from sectionData. A checksum section is added after the given
+= sections. If blocks is not NULL the data of the first section is its blockCount buffers, one after the other, instead
+= of sectionData[ 0 ].
+=
+= With more than one thread the pieces of the file go at offsets known up front, so they are written at once with
+= WriteAt where it is available. The offsets are taken from where the stream is, and the stream is left after the
+= file, as if it had been written in order. Streams that can't be written at an offset, pipes and memory streams, are
+= written in order.
+=
+= Returns false if the file could not be written, for the caller to raise a WRITE_ERROR once it has freed the data.
+=
+====================
+*/
+
+    outputBuffer_t  header;
+    char            signature[ 9 ];
+    uint32_t        tableCount = sectionCount + 1;
+    uint64_t        offset = 8 + 4 + tableCount * sizeof( section_t );
+    section_t       checksumSection = { .type = CHECKSUM_SECTION, .encoding = RAW_ENCODING, .count = sectionCount };
+    uint32_t        checksums[ tableCount ];
+    filePiece_t *   pieces;
+    size_t          pieceCount = 0;
+    exportWork_t    work = { .lock = PTHREAD_MUTEX_INITIALIZER };
+    off_t           start = -1;
+    bool            written = true;
+
+    atomic_init( &( work.failed ), false );
+
+    if ( ( pieces = malloc( ( sectionCount + blockCount + 2 ) * sizeof( filePiece_t ) ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    header = InitializeOutputBuffer( NULL );
+
+    pieces[ pieceCount++ ] = ( filePiece_t ){ NULL, 0, 0 };
+
+    // Lay the sections out and checksum them, a section in blocks is checksummed block after block.
+    for ( uint32_t i = 0; i < sectionCount; i++ ) {
+        sections[ i ].offset = offset;
+        checksums[ i + 1 ] = 0;
+
+        for ( size_t j = 0; j < ( i == 0 && blocks != NULL ? blockCount : 1 ); j++ ) {
+            outputBuffer_t * data = i == 0 && blocks != NULL ? &blocks[ j ] : &sectionData[ i ];
+
+            checksums[ i + 1 ] = Crc32c( checksums[ i + 1 ], data->data, data->size );
+            pieces[ pieceCount++ ] = ( filePiece_t ){ data->data, data->size, offset };
+            offset += data->size;
+        }
+
+        sections[ i ].size = offset - sections[ i ].offset;
+    }
+
+    checksumSection.offset = offset;
+    checksumSection.size = 4 + sectionCount * 4;
+
+    snprintf( signature, sizeof( signature ), "%%TOK-%03d", revision );
+    PushBytes( &header, signature, 8 );
+    PushBytes( &header, ( char * )&tableCount, 4 );
+    PushBytes( &header, ( char * )sections, sectionCount * sizeof( section_t ) );
+    PushBytes( &header, ( char * )&checksumSection, sizeof( section_t ) );
+
+    // Checksums of the header and section table, then of every section.
+    checksums[ 0 ] = Crc32c( 0, header.data, header.size );
+
+    pieces[ 0 ] = ( filePiece_t ){ header.data, header.size, 0 };
+    pieces[ pieceCount++ ] = ( filePiece_t ){ ( char * )checksums, checksumSection.size, offset };
+
+#ifndef _WIN32
+    // The stream is flushed first so that its position is the one of its descriptor.
+    if ( threads > 1 && fflush( output ) == 0 && ( work.descriptor = fileno( output ) ) != -1 && ( start = ftello( output ) ) != -1 && lseek( work.descriptor, 0, SEEK_CUR ) == start ) {
+        for ( size_t i = 0; i < pieceCount; i++ ) {
+            pieces[ i ].offset += start;
+        }
+
+        work.pieces = pieces;
+        work.count = pieceCount;
+
+        RunExportWorkers( &work, threads, true );
+
+        written = !atomic_load( &( work.failed ) ) && fseeko( output, start + offset + checksumSection.size, SEEK_SET ) == 0;
+    } else
+#endif
+    {
+        for ( size_t i = 0; written && i < pieceCount; i++ ) {
+            written = fwrite( pieces[ i ].data, 1, pieces[ i ].size, output ) == pieces[ i ].size;
+        }
+    }
+
+    pthread_mutex_destroy( &( work.lock ) );
+    DestroyOutputBuffer( &header );
+    free( pieces );
+
+    return written;
+}
+
+void WriteTokenFile( FILE * output, int revision, section_t * sections, outputBuffer_t * sectionData, uint32_t sectionCount ) {
+/*
+====================
+=
+= WriteTokenFile
+=
+= Writes the header, the section table and the section data of a sectioned token file, see WriteTokenFileBlocks.
+=
+====================
+*/
+
+    if ( !WriteTokenFileBlocks( output, revision, sections, sectionData, sectionCount, NULL, 0, 1 ) ) {
+        RaiseError( NULL, WRITE_ERROR, "Error writing to output file." );
+    }
+}
+
+void VerifyTokenFile( char * inputFilename, const uint8_t * file, size_t length, bool yolo ) {
+/*
+====================
+=
+= VerifyTokenFile
+=
+= Checks the header and the sections of a sectioned token file against the CRC32C checksums of its checksum section.
+=
+= Files without a checksum section are not checked. With yolo set, mismatches only print a warning.
+=
+====================
+*/
+
+    uint32_t         sectionCount;
+    section_t        section;
+    section_t        checksumSection = { 0 };
+    const uint8_t *  checksums;
+    uint32_t         checksum;
+    uint32_t         mismatches = 0;
+
+    if ( length < 12 ) {
+        return;
+    }
+
+    memcpy( &sectionCount, file + 8, 4 );
+
+    if ( ( length - 12 ) / sizeof( section_t ) < sectionCount ) {
+        return;
+    }
+
+    for ( uint32_t i = 0; i < sectionCount; i++ ) {
+        memcpy( &section, file + 12 + i * sizeof( section_t ), sizeof( section_t ) );
+
+        if ( section.type == CHECKSUM_SECTION ) {
+            checksumSection = section;
+        }
+    }
+
+    if ( checksumSection.type != CHECKSUM_SECTION ) {
+        return;
+    }
+
+    if ( checksumSection.offset > length || checksumSection.size > length - checksumSection.offset
+      || checksumSection.count > sectionCount || checksumSection.size < 4 + checksumSection.count * 4 ) {
+        RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Checksum section is out of the file bounds.", inputFilename );
+    }
+
+    checksums = file + checksumSection.offset;
+
+    memcpy( &checksum, checksums, 4 );
+    mismatches += Crc32c( 0, file, 12 + sectionCount * sizeof( section_t ) ) != checksum;
+
+    for ( uint32_t i = 0; i < checksumSection.count; i++ ) {
+        memcpy( &section, file + 12 + i * sizeof( section_t ), sizeof( section_t ) );
+        memcpy( &checksum, checksums + 4 + i * 4, 4 );
+
+        if ( section.offset > length || section.size > length - section.offset || Crc32c( 0, file + section.offset, section.size ) != checksum ) {
+            mismatches++;
+        }
+    }
+
+    if ( mismatches > 0 ) {
+        if ( yolo ) {
+            fprintf( stderr, "%s: Checksum check failed: expect instability from YOLO mode.\n", inputFilename );
+        } else {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: Checksum mismatch. File corrupted.\n"
+                                                    "Rerun with --yolo to ignore all checks.", inputFilename );
+        }
+    }
+}
+
+void ExportRevision1( FILE * output, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= ExportRevision1
+=
+= Exports a series of tokens and a symbol table as a %TOK-001 file, as specified in Appendix 2 of "The Tokens" document.
+=
+====================
+*/
+
+    // Signature (%TOK-001)
+    if ( fwrite( "\x25\x54\x4F\x4B\x2D\x30\x30\x31", 1, 8, output ) < 8 ) {
+        RaiseError( NULL, WRITE_ERROR, "Error writing to output file." );
+    }
+
+    // The amount of tokens
+    if ( fwrite( &( tokens->size ), sizeof( token_t ), 1, output ) < 1 ) {
+        RaiseError( NULL, WRITE_ERROR, "Error writing to output file." );
+    }
+
+    // The tokens
+    if ( fwrite( tokens->tokens, sizeof( token_t ), tokens->size, output ) < tokens->size ) {
+        RaiseError( NULL, WRITE_ERROR, "Error writing to output file." );
+    }
+
+    // Symbol table
+    chartCursor_t  chart = InitializeChartCursor( symbolTable->chart );
+    token_t        hash;
+
+    while ( ReadChart( &chart, 1, &hash ) ) {
+        // Hash
+        if ( fwrite( &hash, 4, 1, output ) < 1 ) {
+            RaiseError( NULL, WRITE_ERROR, "Error writing to output file." );
+        }
+
+        // Name
+        if ( fwrite( symbolTable->table[ hash ], sizeof( char ), strlen( symbolTable->table[ hash ] ) + 1, output ) < strlen( symbolTable->table[ hash ] ) + 1 ) {
+            RaiseError( NULL, WRITE_ERROR, "Error writing to output file." );
+        }
+    }
+}
+
+void EncodeBlock( tokenList_t * tokens, size_t first, size_t last, outputBuffer_t * output, bool compress ) {
+/*
+====================
+=
+= EncodeBlock
+=
+= Encodes the tokens from first up to last as a block of the token section, compressed with rANS if compress is set.
+=
+====================
+*/
+
+    if ( compress ) {
+        outputBuffer_t encoded = InitializeOutputBuffer( NULL );
+
+        EncodeTokens( tokens, first, last, &encoded );
+        RansEncode( ( uint8_t * )encoded.data, encoded.size, output );
+
+        DestroyOutputBuffer( &encoded );
+    } else {
+        EncodeTokens( tokens, first, last, output );
+    }
+}
+
+void ExportRevision2( FILE * output, tokenList_t * tokens, symbolTable_t * symbolTable, tokenFileOptions_t * options ) {
+/*
+====================
+=
+= ExportRevision2
+=
+= Exports a series of tokens and a symbol table as a %TOK-002 file.
+=
+= With options->compress set the token section is compressed with rANS.
+=
+= With options->indexInterval set the token section is split in blocks of that many lines and an index section is added.
+= Otherwise it is split in blocks of EXPORT_BLOCK_TOKENS token words, which only shows in compressed sections.
+=
+= The blocks are encoded on options->threads threads, and their offsets in the section are the sums of the sizes of
+= the blocks before them. The output does not depend on the number of threads.
+=
+====================
+*/
+
+    section_t       sections[ 3 ];
+    outputBuffer_t  sectionData[ 3 ];
+    uint32_t        sectionCount = 2;
+    exportWork_t    work = { .tokens = tokens, .compress = options->compress, .lock = PTHREAD_MUTEX_INITIALIZER };
+    size_t          capacity = 2;
+    size_t          first = 0;
+    uint64_t        offset = 0;
+    size_t *        bounds;
+    bool            written;
+
+    if ( ( work.bounds = malloc( capacity * sizeof( size_t ) ) ) == NULL ) {
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    work.bounds[ 0 ] = 0;
+
+    // Block bounds, always at least one block.
+    do {
+        size_t last;
+
+        if ( options->indexInterval > 0 ) {
+            last = SkipLines( tokens, first, options->indexInterval );
+        } else {
+            for ( last = first; last < tokens->size && last - first < EXPORT_BLOCK_TOKENS; last += TokenWords( tokens, last ) );
+        }
+
+        if ( work.count + 2 > capacity ) {
+            capacity *= 2;
+
+            if ( ( bounds = realloc( work.bounds, capacity * sizeof( size_t ) ) ) == NULL ) {
+                free( work.bounds );
+                RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+            }
+
+            work.bounds = bounds;
+        }
+
+        work.bounds[ ++( work.count ) ] = first = last < tokens->size ? last : tokens->size;
+    } while ( first < tokens->size );
+
+    if ( ( work.blocks = malloc( work.count * sizeof( outputBuffer_t ) ) ) == NULL ) {
+        free( work.bounds );
+        RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
+    }
+
+    RunExportWorkers( &work, work.count > 1 ? options->threads : 1, false );
+
+    sections[ 0 ].type = TOKEN_SECTION;
+    sections[ 0 ].encoding = options->compress ? RANS_ENCODING : VARINT_ENCODING;
+    sections[ 0 ].count = tokens->size;
+
+    if ( options->indexInterval > 0 ) {
+        uint64_t  entry[ 2 ];
+        uint64_t  interval = options->indexInterval;
+
+        sectionData[ 2 ] = InitializeOutputBuffer( NULL );
+        sections[ 2 ].type = INDEX_SECTION;
+        sections[ 2 ].encoding = RAW_ENCODING;
+        sections[ 2 ].count = work.count;
+        sectionCount = 3;
+
+        PushBytes( &sectionData[ 2 ], ( char * )&interval, 8 );
+
+        for ( size_t i = 0; i < work.count; i++ ) {
+            entry[ 0 ] = work.bounds[ i ];
+            entry[ 1 ] = offset;
+            PushBytes( &sectionData[ 2 ], ( char * )entry, 16 );
+            offset += work.blocks[ i ].size;
+        }
+    }
+
+    sectionData[ 0 ] = InitializeOutputBuffer( NULL );
+    sectionData[ 1 ] = InitializeOutputBuffer( NULL );
+    sections[ 1 ].type = SYMBOL_SECTION;
+
+    if ( options->sortSymbols ) {
+        EncodeSortedSymbols( symbolTable, &sectionData[ 1 ], &( sections[ 1 ].count ) );
+        sections[ 1 ].encoding = FRONT_CODED_ENCODING;
+    } else {
+        EncodeSymbols( symbolTable, &sectionData[ 1 ], &( sections[ 1 ].count ) );
+        sections[ 1 ].encoding = VARINT_ENCODING;
+    }
+
+    written = WriteTokenFileBlocks( output, 2, sections, sectionData, sectionCount, work.blocks, work.count, work.count > 1 ? options->threads : 1 );
+
+    for ( uint32_t i = 0; i < sectionCount; i++ ) {
+        DestroyOutputBuffer( &sectionData[ i ] );
+    }
+
+    for ( size_t i = 0; i < work.count; i++ ) {
+        DestroyOutputBuffer( &( work.blocks[ i ] ) );
+    }
+
+    pthread_mutex_destroy( &( work.lock ) );
+    free( work.blocks );
+    free( work.bounds );
+
+    // Raised only once everything is freed, so that a trapped error leaks nothing.
+    if ( !written ) {
+        RaiseError( NULL, WRITE_ERROR, "Error writing to output file." );
+    }
+}
+
+void ExportTokenFileTo( FILE * output, tokenList_t * tokens, symbolTable_t * symbolTable, tokenFileOptions_t * options ) {
+/*
+====================
+=
+= ExportTokenFileTo
+=
+= Exports a series of tokens and a symbol table to an open file, as a tokens file of the revision given in options.
+=
+= The file may be any stream open for writing and is written from where it is. With more than one thread in options
+= the sections of files that can be written at an offset are written at once, see WriteTokenFileBlocks.
+=
+====================
+*/
+
+    if ( options->revision == 1 ) {
+        ExportRevision1( output, tokens, symbolTable );
+    } else if ( options->revision == 3 ) {
+        tokenStream_t stream = InitializeTokenStream( output, options->compress );
+        FinishTokenStream( &stream, tokens, symbolTable );
+    } else {
+        ExportRevision2( output, tokens, symbolTable, options );
+    }
+}
+
+void ExportTokenFile( char * outputFilename, tokenList_t * tokens, symbolTable_t * symbolTable, tokenFileOptions_t * options ) {
+/*
+====================
+=
+= ExportTokenFile
+=
+= Exports a series of tokens and a symbol table to a tokens file of the revision given in options.
+=
+= A file that can't be opened or written raises a WRITE_ERROR, see RaiseError. The file is closed before any error of
+= the export goes on to the caller, and is left for the caller to remove.
+=
+====================
+*/
+
+    FILE *            output = fopen( outputFilename, "wb" );
+    diagnosticList_t  diagnostics;
+    diagnostic_t      diagnostic;
+    errorTrap_t       trap;
+
+    if ( output == NULL ) {
+        RaiseError( NULL, WRITE_ERROR, "%s: %s", outputFilename, strerror( errno ) );
+    }
+
+    diagnostics = InitializeDiagnosticList();
+    SetErrorTrap( &trap, NULL, 0, false, &diagnostics );
+
+    if ( setjmp( trap.jump ) != 0 ) {
+        diagnostic = diagnostics.diagnostics[ 0 ];
+        DestroyDiagnosticList( diagnostics );
+        fclose( output );
+
+        RaiseError( NULL, diagnostic.kind, "%s", diagnostic.message );
+    }
+
+    ExportTokenFileTo( output, tokens, symbolTable, options );
+    ClearErrorTrap( &trap );
+    DestroyDiagnosticList( diagnostics );
+
+    if ( fclose( output ) != 0 ) {
+        RaiseError( NULL, WRITE_ERROR, "%s: Error writing to output file.", outputFilename );
+    }
+}
+
+void ImportSymbol( char * inputFilename, int revision, symbolTable_t * symbolTable, uint64_t symbol, char * name ) {
+/*
+====================
+=
+= ImportSymbol
+=
+= Checks the range of a symbol read from a token file and pushes it to the symbol table.
+=
+====================
+*/
+
+    if ( symbol >= 4819 ) {
+        RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Symbol \"%s\" has value %" PRIu64 ", above upper limit 4819 for file revision %d.", inputFilename, name, symbol, revision );
+    } else if ( symbol < 128 ) {
+        RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Symbol \"%s\" has value %" PRIu64 ", bellow lower limit 128 for file revision %d.", inputFilename, name, symbol, revision );
+    }
+
+    PushSymbolToHash( symbolTable, name, strlen( name ), symbol );
+}
+
+void ImportRevision1( char * inputFilename, const uint8_t * file, size_t length, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= ImportRevision1
+=
+= Imports the tokens and symbols of a %TOK-001 file.
+=
+====================
+*/
+
+    uint32_t  tokenCount;
+    token_t   token;
+    uint32_t  symbol;
+    size_t    position;
+    char *    terminator;
+
+    // Token count
+    if ( length < 12 ) {
+        RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: Error reading file.", inputFilename );
+    }
+
+    memcpy( &tokenCount, file + 8, 4 );
+
+    if ( ( length - 12 ) / 4 < tokenCount ) {
+        RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: Error reading file.", inputFilename );
+    }
+
+    for ( uint32_t i = 0; i < tokenCount; i++ ) {
+        memcpy( &token, file + 12 + i * 4, 4 );
+        PushToken( tokens, token );
+    }
+
+    // Symbol table
+    position = 12 + ( size_t )tokenCount * 4;
+
+    while ( length - position >= 4 ) {
+        memcpy( &symbol, file + position, 4 );
+        position += 4;
+
+        if ( ( terminator = memchr( file + position, '\0', length - position ) ) == NULL ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: Error reading file.", inputFilename );
+        }
+
+        ImportSymbol( inputFilename, 1, symbolTable, symbol, ( char * )file + position );
+        position = terminator - ( char * )file + 1;
+    }
+}
+
+bool DecodeBlocks( const uint8_t * data, size_t size, uint32_t encoding, uint64_t count, tokenList_t * tokens ) {
+/*
+====================
+=
+= DecodeBlocks
+=
+= Decodes a run of whole blocks of a token section, which must decode to count tokens.
+=
+= The RANS_ENCODING blocks may decode to no more than the VARINT_ENCODING bytes that count tokens can take, so that a
+= malformed section can't make more than its count says.
+=
+====================
+*/
+
+    const uint8_t *  position = data;
+    const uint8_t *  end = data + size;
+    outputBuffer_t   decompressed;
+    bool             decoded;
+
+    if ( encoding == VARINT_ENCODING ) {
+        return DecodeTokens( data, size, count, tokens );
+    }
+
+    if ( count > UINT64_MAX / VARINT_TOKEN_BYTES ) {
+        return false;
+    }
+
+    decompressed = InitializeOutputBuffer( NULL );
+
+    while ( position < end ) {
+        if ( !RansDecode( &position, end, count * VARINT_TOKEN_BYTES - decompressed.size, &decompressed ) ) {
+            DestroyOutputBuffer( &decompressed );
+            return false;
+        }
+    }
+
+    decoded = DecodeTokens( ( uint8_t * )decompressed.data, decompressed.size, count, tokens );
+    DestroyOutputBuffer( &decompressed );
+
+    return decoded;
+}
+
+size_t ImportRevision2( char * inputFilename, const uint8_t * file, size_t length, tokenFileOptions_t * options, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= ImportRevision2
+=
+= Imports the tokens and symbols of a %TOK-002 file.
+=
+= If options->firstLine is set and the file has an index, only the blocks holding the requested lines are decoded.
+=
+= Returns the line number of the first imported token.
+=
+====================
+*/
+
+    uint32_t          sectionCount;
+    section_t         section;
+    section_t         tokenSection = { 0 };
+    section_t         indexSection = { 0 };
+    const uint8_t *   position;
+    const uint8_t *   end;
+    uint64_t          symbol;
+    char *            terminator;
+    uint64_t          firstBlock[ 2 ] = { 0, 0 };
+    uint64_t          lastBlock[ 2 ];
+    size_t            baseLine = 1;
+
+    if ( length < 12 ) {
+        RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: Error reading file.", inputFilename );
+    }
+
+    memcpy( &sectionCount, file + 8, 4 );
+
+    if ( ( length - 12 ) / sizeof( section_t ) < sectionCount ) {
+        RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Section table is truncated.", inputFilename );
+    }
+
+    for ( uint32_t i = 0; i < sectionCount; i++ ) {
+        memcpy( &section, file + 12 + i * sizeof( section_t ), sizeof( section_t ) );
+
+        if ( section.offset > length || section.size > length - section.offset ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Section %u is out of the file bounds.", inputFilename, i );
+        }
+
+        position = file + section.offset;
+        end = position + section.size;
+
+        if ( section.type == TOKEN_SECTION ) {
+            if ( section.encoding != VARINT_ENCODING && section.encoding != RANS_ENCODING ) {
+                RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: Unsupported token section encoding %u.", inputFilename, section.encoding );
+            }
+
+            tokenSection = section;
+        } else if ( section.type == INDEX_SECTION ) {
+            if ( section.size < 8 || ( section.size - 8 ) / 16 < section.count ) {
+                RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Index section is truncated.", inputFilename );
+            }
+
+            indexSection = section;
+        } else if ( section.type == ARCHIVE_DIRECTORY_SECTION ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: File is a token archive, list its files with -list and extract them with -x.", inputFilename );
+        } else if ( section.type == SYMBOL_SECTION && section.encoding == FRONT_CODED_ENCODING ) {
+            if ( !DecodeSortedSymbols( inputFilename, position, section.size, section.count, symbolTable ) ) {
+                RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Symbol section could not be decoded.", inputFilename );
+            }
+        } else if ( section.type == SYMBOL_SECTION ) {
+            if ( section.encoding != VARINT_ENCODING ) {
+                RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: Unsupported symbol section encoding %u.", inputFilename, section.encoding );
+            }
+
+            while ( position < end ) {
+                if ( !ReadVarint( &position, end, &symbol ) || ( terminator = memchr( position, '\0', end - position ) ) == NULL ) {
+                    RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Symbol section could not be decoded.", inputFilename );
+                }
+
+                ImportSymbol( inputFilename, 2, symbolTable, symbol, ( char * )position );
+                position = ( uint8_t * )terminator + 1;
+            }
+        }
+        // Sections of other types are skipped.
+    }
+
+    // The whole token section by default, or the blocks that hold the requested lines if there is an index.
+    lastBlock[ 0 ] = tokenSection.count;
+    lastBlock[ 1 ] = tokenSection.size;
+
+    if ( options->firstLine > 0 && indexSection.count > 0 ) {
+        uint64_t  interval;
+        uint64_t  first;
+        uint64_t  last;
+
+        memcpy( &interval, file + indexSection.offset, 8 );
+
+        if ( interval == 0 ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Index interval is 0.", inputFilename );
+        }
+
+        first = ( options->firstLine - 1 ) / interval;
+        last = ( options->lastLine + interval - 1 ) / interval;
+
+        if ( first < indexSection.count ) {
+            memcpy( firstBlock, file + indexSection.offset + 8 + first * 16, 16 );
+            baseLine = first * interval + 1;
+        } else {
+            firstBlock[ 0 ] = tokenSection.count;
+            firstBlock[ 1 ] = tokenSection.size;
+            baseLine = options->firstLine;
+        }
+
+        if ( last < indexSection.count ) {
+            memcpy( lastBlock, file + indexSection.offset + 8 + last * 16, 16 );
+        }
+
+        if ( firstBlock[ 0 ] > lastBlock[ 0 ] || firstBlock[ 1 ] > lastBlock[ 1 ] || lastBlock[ 0 ] > tokenSection.count || lastBlock[ 1 ] > tokenSection.size ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Index entries are out of the token section bounds.", inputFilename );
+        }
+    }
+
+    if ( options->tokenLimit > 0 && lastBlock[ 0 ] - firstBlock[ 0 ] > options->tokenLimit ) {
+        RaiseError( NULL, INPUT_TOO_LARGE_ERROR, "%s: Token section holds more than the limit of %zu tokens.", inputFilename, options->tokenLimit );
+    }
+
+    if ( !DecodeBlocks( file + tokenSection.offset + firstBlock[ 1 ], lastBlock[ 1 ] - firstBlock[ 1 ], tokenSection.encoding, lastBlock[ 0 ] - firstBlock[ 0 ], tokens ) ) {
+        RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Token section could not be decoded.", inputFilename );
+    }
+
+    return baseLine;
+}
+
+void ImportTokenBuffer( char * inputFilename, const uint8_t * file, size_t length, bool yolo, tokenFileOptions_t * options, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= ImportTokenBuffer
+=
+= Imports the tokens and the symbol table of a tokens file of any supported revision that is already in memory, like
+= ImportTokenFile, into tokens and symbolTable, which must be initialized and empty. inputFilename only names the file
+= in the error messages.
+=
+= A malformed file raises a MALFORMED_FILE_ERROR, see RaiseError. A file that would decode to more than
+= options->tokenLimit tokens raises an INPUT_TOO_LARGE_ERROR; %TOK-001 files hold their tokens uncompressed, so only
+= their length bounds them.
+=
+====================
+*/
+
+    size_t     baseLine = 1;
+
+    // Signature check
+    char signature[ 9 ];
+    signature[ 8 ] = '\0';
+
+    if ( length < 8 ) {
+        RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: Error reading file.", inputFilename );
+    }
+
+    memcpy( signature, file, 8 );
+
+    // Check signature prefix ("%TOK-")
+    if ( memcmp( signature, "\x25\x54\x4F\x4B\x2D", 5 ) ) {
+        if ( yolo ) {
+            fprintf( stderr, "%s: Signature check failed: expect instability from YOLO mode.\n", inputFilename );
+        } else {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: File signature mismatch. File potentially corrupted.\n"
+                                                    "Rerun with --yolo to ignore all checks.", inputFilename );
+        }
+
+    }
+
+    // Check revision number
+    int revision = strtol( signature + 5, NULL, 10 );
+
+    if ( revision > TOKEN_FILE_REVISION ) {
+        if ( yolo ) {
+            fprintf( stderr, "%s: File revision check failed (got %d, maximum supported is %d): expect instability from YOLO mode.\n", inputFilename, revision, TOKEN_FILE_REVISION );
+        } else {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "%s: Unsupported file revision \"%d\", maximum supported revision is %d.\n"
+                                                    "Rerun with --yolo to ignore all checks.", inputFilename, revision, TOKEN_FILE_REVISION );
+        }
+    }
+
+    if ( revision == 2 && !options->skipChecksums ) {
+        VerifyTokenFile( inputFilename, file, length, yolo );
+    }
+
+    if ( revision <= 1 ) {
+        ImportRevision1( inputFilename, file, length, tokens, symbolTable );
+    } else if ( revision == 3 ) {
+        ImportRevision3( inputFilename, file, length, options->tokenLimit, tokens, symbolTable );
+    } else {
+        baseLine = ImportRevision2( inputFilename, file, length, options, tokens, symbolTable );
+    }
+
+    // Trim the imported tokens down to the requested lines.
+    if ( options->firstLine > 0 ) {
+        size_t first = SkipLines( tokens, 0, options->firstLine > baseLine ? options->firstLine - baseLine : 0 );
+        size_t last = SkipLines( tokens, first, options->lastLine - options->firstLine + 1 );
+
+        memmove( tokens->tokens, tokens->tokens + first, ( last - first ) * sizeof( token_t ) );
+        tokens->size = last - first;
+    }
+}
+
+void ImportTokenFile( char * inputFilename, bool yolo, tokenFileOptions_t * options, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= ImportTokenFile
+=
+= Imports the tokens and the symbol table of a tokens file of any supported revision.
+=
+= tokens and symbolTable are initialized by the function and the caller is responsible for destroying them.
+=
+= With yolo set, signature, revision and checksum mismatches only print a warning. With options->skipChecksums set the
+= checksums are not checked at all.
+=
+= If options->firstLine is set only the tokens of lines firstLine to options->lastLine are imported. Files with an index
+= only have the blocks holding those lines decoded.
+=
+====================
+*/
+
+    size_t     length;
+    uint8_t *  file = ReadBinaryFile( inputFilename, &length );
+
+    *tokens = InitializeTokenList();
+    *symbolTable = InitializeSymbolTable();
+
+    ImportTokenBuffer( inputFilename, file, length, yolo, options, tokens, symbolTable );
+
+    free( file );
+}
+
+bool FindTokenFileSymbol( char * inputFilename, char * name, token_t * hash ) {
+/*
+====================
+=
+= FindTokenFileSymbol
+=
+= Looks up an identifier by name in a token file, hash is filled with its hash if the file uses it.
+=
+= Sorted symbol sections are searched without decoding them, other symbol sections are scanned and files of other
+= revisions are imported whole.
+=
+====================
+*/
+
+    size_t           length;
+    uint8_t *        file = MapFile( inputFilename, &length );
+    uint32_t         sectionCount;
+    section_t        section;
+    const uint8_t *  position;
+    const uint8_t *  end;
+    uint64_t         symbol;
+    char *           terminator;
+    bool             found = false;
+
+    if ( length < 12 || memcmp( file, "%TOK-002", 8 ) ) {
+        tokenFileOptions_t  options = { 0 };
+        tokenList_t         tokens;
+        symbolTable_t       symbolTable;
+        token_t             symbolHash;
+        chartCursor_t       chart;
+
+        UnmapFile( file, length );
+        ImportTokenFile( inputFilename, false, &options, &tokens, &symbolTable );
+
+        chart = InitializeChartCursor( symbolTable.chart );
+
+        while ( !found && ReadChart( &chart, 1, &symbolHash ) ) {
+            if ( !strcmp( symbolTable.table[ symbolHash ], name ) ) {
+                *hash = symbolHash;
+                found = true;
+            }
+        }
+
+        DestroySymbolTable( symbolTable );
+        DestroyTokenList( tokens );
+
+        return found;
+    }
+
+    memcpy( &sectionCount, file + 8, 4 );
+
+    for ( uint32_t i = 0; i < sectionCount && ( length - 12 ) / sizeof( section_t ) > i; i++ ) {
+        memcpy( &section, file + 12 + i * sizeof( section_t ), sizeof( section_t ) );
+
+        if ( section.type != SYMBOL_SECTION || section.offset > length || section.size > length - section.offset ) {
+            continue;
+        }
+
+        position = file + section.offset;
+        end = position + section.size;
+
+        if ( section.encoding == FRONT_CODED_ENCODING ) {
+            found = FindSortedSymbol( position, section.size, name, hash );
+        } else {
+            while ( !found && position < end && ReadVarint( &position, end, &symbol ) && ( terminator = memchr( position, '\0', end - position ) ) != NULL ) {
+                if ( !strcmp( ( char * )position, name ) ) {
+                    *hash = symbol;
+                    found = true;
+                }
+
+                position = ( uint8_t * )terminator + 1;
+            }
+        }
+    }
+
+    UnmapFile( file, length );
+
+    return found;
+}
\ No newline at end of file
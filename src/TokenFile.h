@@ -0,0 +1,89 @@
+#ifndef TOKENFILE_H
+#define TOKENFILE_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "OutputBuffer.h"
+
+#define TOKEN_FILE_REVISION 3
+
+enum sectionType_t {
+    TOKEN_SECTION     = 1,
+    SYMBOL_SECTION    = 2,
+    INDEX_SECTION     = 3,
+
+    // Token archives, see TokenArchive.c
+    ARCHIVE_DICTIONARY_SECTION  = 4,
+    ARCHIVE_DIRECTORY_SECTION   = 5,
+    ARCHIVE_DATA_SECTION        = 6,
+
+    CHECKSUM_SECTION  = 7
+};
+
+enum sectionEncoding_t {
+    RAW_ENCODING          = 0,
+    VARINT_ENCODING       = 1,
+    RANS_ENCODING         = 2,
+    FRONT_CODED_ENCODING  = 3
+};
+
+#define SYMBOL_RESTART_INTERVAL 16
+
+// Bytes a token word takes at most in VARINT_ENCODING, as a varint of 32 bits or as a raw floating word.
+#define VARINT_TOKEN_BYTES 5
+
+// Token words per block of a token section without an index.
+#ifndef EXPORT_BLOCK_TOKENS
+#define EXPORT_BLOCK_TOKENS ( 1 << 20 )
+#endif
+
+typedef struct {
+    uint32_t  type;
+    uint32_t  encoding;
+    uint64_t  offset;
+    uint64_t  size;
+    uint64_t  count;
+} section_t;
+
+typedef enum {
+    NO_PAYLOAD,
+    CHARACTER_SEQUENCE_PAYLOAD,
+    CHARACTER_PAYLOAD,
+    INTEGER_PAYLOAD,
+    FLOATING_PAYLOAD
+} payload_t;
+
+typedef struct {
+    int     revision;
+    bool    compress;
+    bool    sortSymbols;
+    bool    skipChecksums;
+    size_t  indexInterval;   // Lines per indexed block, 0 for no index
+    size_t  firstLine;       // Lines of the recomposed output to import, 0 for all of them
+    size_t  lastLine;
+    int     threads;         // Threads to export large token sections on
+    size_t  tokenLimit;      // Tokens an import may decode, 0 for no limit
+} tokenFileOptions_t;
+
+payload_t TokenPayload( token_t token, size_t * words );
+void PushVarint( outputBuffer_t * output, uint64_t value );
+bool ReadVarint( const uint8_t ** position, const uint8_t * end, uint64_t * value );
+size_t TokenWords( tokenList_t * tokens, size_t position );
+size_t SkipLines( tokenList_t * tokens, size_t position, size_t lines );
+void EncodeTokens( tokenList_t * tokens, size_t first, size_t last, outputBuffer_t * output );
+bool DecodeTokens( const uint8_t * data, size_t size, uint64_t count, tokenList_t * tokens );
+void EncodeBlock( tokenList_t * tokens, size_t first, size_t last, outputBuffer_t * output, bool compress );
+bool DecodeBlocks( const uint8_t * data, size_t size, uint32_t encoding, uint64_t count, tokenList_t * tokens );
+bool WriteTokenFileBlocks( FILE * output, int revision, section_t * sections, outputBuffer_t * sectionData, uint32_t sectionCount, outputBuffer_t * blocks, size_t blockCount, int threads );
+void WriteTokenFile( FILE * output, int revision, section_t * sections, outputBuffer_t * sectionData, uint32_t sectionCount );
+bool FindSortedSymbol( const uint8_t * data, size_t size, const char * name, token_t * hash );
+bool FindTokenFileSymbol( char * inputFilename, char * name, token_t * hash );
+void VerifyTokenFile( char * inputFilename, const uint8_t * file, size_t length, bool yolo );
+void ImportSymbol( char * inputFilename, int revision, symbolTable_t * symbolTable, uint64_t symbol, char * name );
+void ExportTokenFileTo( FILE * output, tokenList_t * tokens, symbolTable_t * symbolTable, tokenFileOptions_t * options );
+void ExportTokenFile( char * outputFilename, tokenList_t * tokens, symbolTable_t * symbolTable, tokenFileOptions_t * options );
+void ImportTokenBuffer( char * inputFilename, const uint8_t * file, size_t length, bool yolo, tokenFileOptions_t * options, tokenList_t * tokens, symbolTable_t * symbolTable );
+void ImportTokenFile( char * inputFilename, bool yolo, tokenFileOptions_t * options, tokenList_t * tokens, symbolTable_t * symbolTable );
+#endif
\ No newline at end of file
@@ -1,42 +1,46 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
+#include "Diagnostic.h"
 
 typedef uint32_t token_t;
 
-typedef struct _tokenNode_t {
-    token_t                token;
-    struct _tokenNode_t *  next;
-} tokenNode_t;
-
 typedef struct _tokenList_t {
-    tokenNode_t *  head;
-    tokenNode_t *  tail;
-    size_t         size;
+    token_t *  tokens;
+    size_t     size;
+    size_t     capacity;
 } tokenList_t;
 
+typedef struct {
+    tokenList_t *  list;
+    size_t         position;
+} tokenCursor_t;
+
 tokenList_t InitializeTokenList() {
 /*
 ====================
 =
 = InitializeTokenList
 =
-= Initializes the tokenArray_t data structure.
+= Initializes the tokenList_t data structure.
+=
+= The tokens are stored contiguously, so any token can be reached by its index.
 =
 ====================
 */
 
     tokenList_t tokenList;
 
-    tokenList.head = NULL;
-    tokenList.tail = NULL;
+    tokenList.tokens = NULL;
     tokenList.size = 0;
+    tokenList.capacity = 0;
 
     return tokenList;
 }
 
-tokenNode_t * PushToken( tokenList_t * tokens, token_t token ) {
+size_t PushToken( tokenList_t * tokens, token_t token ) {
 /*
 ====================
 =
@@ -44,36 +48,30 @@ tokenNode_t * PushToken( tokenList_t * tokens, token_t token ) {
 =
 = Pushes a token to a tokenList_t structure.
 =
-= Returns the tail.
+= Returns the index of the token, which stays valid as the list grows, unlike a pointer to it.
 =
 ====================
 */
     
-    // No elements on the list
-    if ( tokens->tail == NULL ) {
-        if ( ( tokens->head = malloc( sizeof( tokenNode_t ) ) ) == NULL ) {
-            fputs( "Out of memory.\n", stderr );
-            exit( 1 );
-        }
-        tokens->tail = tokens->head;
-    // Elements already present
-    } else {
-        if ( ( ( tokens->tail )->next = malloc( sizeof( tokenNode_t ) ) ) == NULL ) {
-            fputs( "Out of memory.\n", stderr );
-            exit( 1 );
+    if ( tokens->size == tokens->capacity ) {
+        size_t     capacity = tokens->capacity == 0 ? 1024 : tokens->capacity * 2;
+        token_t *  grown;
+
+        // The list is left untouched on failure, so that it can still be destroyed if the error is trapped.
+        if ( ( grown = realloc( tokens->tokens, capacity * sizeof( token_t ) ) ) == NULL ) {
+            RaiseError( NULL, OUT_OF_MEMORY_ERROR, "Out of memory." );
         }
-        tokens->tail = ( tokens->tail )->next;
-    }
 
-    ( tokens->size )++;
+        tokens->tokens = grown;
+        tokens->capacity = capacity;
+    }
 
-    ( tokens->tail )->token = token;
-    ( tokens->tail )->next = NULL;
+    tokens->tokens[ tokens->size ] = token;
 
-    return tokens->tail;
+    return ( tokens->size )++;
 }
 
-tokenNode_t * PushData( tokenList_t * tokens, void * data, size_t size ) {
+size_t PushData( tokenList_t * tokens, void * data, size_t size ) {
 /*
 ====================
 =
@@ -81,12 +79,12 @@ tokenNode_t * PushData( tokenList_t * tokens, void * data, size_t size ) {
 =
 = Pushes arbitrary data to a tokenList_t structure.
 =
-= Returns the tail.
+= Returns the index of the last token pushed.
 =
 ====================
 */
 
-    tokenNode_t * tail;
+    size_t tail = 0;
 
     // Push whole 4 byte segments
     while ( size >= 4 ) {
@@ -98,68 +96,56 @@ tokenNode_t * PushData( tokenList_t * tokens, void * data, size_t size ) {
     // Push remaining bytes
     if ( size > 0 ) {
         tail = PushToken( tokens, 0x00000000 );
-        void * position = &( tail->token );
-    
+
         // This assert should never fail.
         static_assert( sizeof( char ) == 1, "A char is not a byte." );
-        while ( size > 0 ) {
-            *( char * )position = *( char * )data;
-            position = ( char * )position + 1;
-            size -= 1;
-        }
+        memcpy( &( tokens->tokens[ tail ] ), data, size );
     }
 
     return tail;
 }
 
-int ReadTokens( tokenNode_t * head, size_t count, void * buffer ) {
+tokenCursor_t InitializeTokenCursor( tokenList_t * tokens ) {
 /*
 ====================
 =
-= ReadTokens
+= InitializeTokenCursor
 =
-= Reads a certain number of tokens from a tokenNode_t structure into a buffer.
+= Initializes a cursor at the first token of a list. A cursor holds all the state of a reader, so any number of them can
+= read the same or different lists at once, from any threads, as long as the lists don't change.
 =
-= Successive calls with NULL or the same head value read successive tokens from the list.
+====================
+*/
+
+    tokenCursor_t  cursor;
+
+    cursor.list = tokens;
+    cursor.position = 0;
+
+    return cursor;
+}
+
+size_t ReadTokens( tokenCursor_t * cursor, size_t count, void * buffer ) {
+/*
+====================
 =
-= Passing a different head value will reset the current position on the list.
+= ReadTokens
 =
-= Returns the number of tokens successfully read.
+= Reads up to count tokens from the position of a cursor into a buffer and moves the cursor past them.
+=
+= Returns the number of tokens read, fewer than count only at the end of the list.
 =
 ====================
 */
     
-    static tokenNode_t *  tracer = NULL;
-    static tokenNode_t *  list = NULL;
-    size_t                read = 0;
-
-    // Begin reading a different list if it is not NULL or the same list.
-    if ( head != NULL && head != list ) {
-        list = head;
-        tracer = head;
-    }
-
-    while ( tracer != NULL && read < count ) {
-        ( ( token_t * )buffer )[ read ] = tracer->token;
-        tracer = tracer->next;
-        read++;
-    }
+    size_t  read = cursor->list->size - cursor->position < count ? cursor->list->size - cursor->position : count;
 
-    if ( read < count ) {
-        list = NULL;
-    }
+    memcpy( buffer, cursor->list->tokens + cursor->position, read * sizeof( token_t ) );
+    cursor->position += read;
 
     return read;
 }
 
 void DestroyTokenList( tokenList_t tokenList ) {
-    tokenNode_t *  tracer = tokenList.head;
-    tokenNode_t *  next;
-
-    // Free the linkedList
-    while ( tracer != NULL ) {
-        next = tracer->next;
-        free( tracer );
-        tracer = next;
-    }
+    free( tokenList.tokens );
 }
\ No newline at end of file
@@ -5,20 +5,21 @@
 
 typedef uint32_t token_t;
 
-typedef struct _tokenNode_t {
-    token_t                token;
-    struct _tokenNode_t *  next;
-} tokenNode_t;
-
 typedef struct _tokenList_t {
-    tokenNode_t *  head;
-    tokenNode_t *  tail;
-    size_t         size;
+    token_t *  tokens;
+    size_t     size;
+    size_t     capacity;
 } tokenList_t;
 
+typedef struct {
+    tokenList_t *  list;
+    size_t         position;
+} tokenCursor_t;
+
 tokenList_t InitializeTokenList();
-tokenNode_t * PushToken( tokenList_t * tokens, token_t token );
-tokenNode_t * PushData( tokenList_t * tokens, void * data, size_t size );
-int ReadTokens( tokenNode_t * head, size_t count, void * buffer );
+size_t PushToken( tokenList_t * tokens, token_t token );
+size_t PushData( tokenList_t * tokens, void * data, size_t size );
+tokenCursor_t InitializeTokenCursor( tokenList_t * tokens );
+size_t ReadTokens( tokenCursor_t * cursor, size_t count, void * buffer );
 void DestroyTokenList( tokenList_t tokenList );
 #endif
\ No newline at end of file
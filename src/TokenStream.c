@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdbool.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "OutputBuffer.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
+#include "TokenStream.h"
+
+/*
+A %TOK-003 file is a stream of frames that can be written while the source is being lexed and read while it is being
+written, e.g. through a pipe. Nothing in it depends on the total number of tokens:
+
+    8 bytes              Signature (%TOK-003)
+    ...                  Frames
+
+Every frame is a type byte, a varint payload size and the payload:
+
+    SYMBOL_FRAME         varint symbol count, followed by that many varint hashes, each followed by its NUL-terminated
+                         name. Only the symbols added since the previous symbol frame are written, always before the
+                         first token frame that uses them.
+
+    TOKEN_FRAME          varint encoding (VARINT_ENCODING or RANS_ENCODING), varint token count and the tokens, encoded
+                         as a token section of a %TOK-002 file. Frames only end between tokens.
+
+    TRAILER_FRAME        varint total token count, varint total symbol count and varint number of frames before the
+                         trailer. It ends the stream, a stream without a trailer is truncated.
+
+Frames of unknown types are skipped by the reader.
+*/
+
+void PushFrame( tokenStream_t * stream, int type, outputBuffer_t * payload ) {
+/*
+====================
+=
+= PushFrame
+=
+= Pushes a frame with its header to the stream.
+=
+====================
+*/
+
+    PushByte( &( stream->output ), type );
+    PushVarint( &( stream->output ), payload->size );
+    PushBytes( &( stream->output ), payload->data, payload->size );
+
+    if ( type != TRAILER_FRAME ) {
+        stream->frameCount++;
+    }
+}
+
+tokenStream_t InitializeTokenStream( FILE * file, bool compress ) {
+/*
+====================
+=
+= InitializeTokenStream
+=
+= Initializes the tokenStream_t data structure and writes the signature of a %TOK-003 file to file.
+=
+= With compress set the token frames are compressed with rANS.
+=
+====================
+*/
+
+    tokenStream_t  stream;
+
+    stream.output = InitializeOutputBuffer( file );
+    stream.lastSymbol = NULL;
+    stream.compress = compress;
+    stream.tokenCount = 0;
+    stream.symbolCount = 0;
+    stream.frameCount = 0;
+
+    PushBytes( &( stream.output ), "%TOK-003", 8 );
+
+    return stream;
+}
+
+void PushTokenFrame( tokenStream_t * stream, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= PushTokenFrame
+=
+= Writes the symbols added to symbolTable since the last frame and all the tokens of tokens as new frames, then flushes
+= the stream so that a reader on the other side of a pipe gets them right away.
+=
+= tokens must end between two tokens. The caller empties it afterwards to keep the memory use bounded.
+=
+====================
+*/
+
+    outputBuffer_t  payload = InitializeOutputBuffer( NULL );
+    chartStack_t *  symbol = stream->lastSymbol == NULL ? symbolTable->chart : stream->lastSymbol->next;
+    uint64_t        count = 0;
+
+    // Symbol delta
+    for ( chartStack_t * tracer = symbol; tracer != NULL; tracer = tracer->next ) {
+        count++;
+    }
+
+    if ( count > 0 ) {
+        PushVarint( &payload, count );
+
+        for ( ; symbol != NULL; symbol = symbol->next ) {
+            PushVarint( &payload, symbol->hash );
+            PushBytes( &payload, symbolTable->table[ symbol->hash ], strlen( symbolTable->table[ symbol->hash ] ) + 1 );
+        }
+
+        PushFrame( stream, SYMBOL_FRAME, &payload );
+        stream->symbolCount += count;
+        stream->lastSymbol = symbolTable->chartTail;
+    }
+
+    // Tokens
+    if ( tokens->size > 0 ) {
+        payload.size = 0;
+        PushVarint( &payload, stream->compress ? RANS_ENCODING : VARINT_ENCODING );
+        PushVarint( &payload, tokens->size );
+        EncodeBlock( tokens, 0, tokens->size, &payload, stream->compress );
+
+        PushFrame( stream, TOKEN_FRAME, &payload );
+        stream->tokenCount += tokens->size;
+    }
+
+    DestroyOutputBuffer( &payload );
+
+    FlushOutputBuffer( &( stream->output ) );
+    fflush( stream->output.file );
+}
+
+void FinishTokenStream( tokenStream_t * stream, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= FinishTokenStream
+=
+= Writes the remaining symbols and tokens, followed by the trailer, and destroys the stream.
+=
+====================
+*/
+
+    outputBuffer_t  payload = InitializeOutputBuffer( NULL );
+
+    PushTokenFrame( stream, tokens, symbolTable );
+
+    PushVarint( &payload, stream->tokenCount );
+    PushVarint( &payload, stream->symbolCount );
+    PushVarint( &payload, stream->frameCount );
+    PushFrame( stream, TRAILER_FRAME, &payload );
+
+    DestroyOutputBuffer( &payload );
+    DestroyOutputBuffer( &( stream->output ) );
+    fflush( stream->output.file );
+}
+
+void DecodeFrame( tokenStreamReader_t * reader, int type, const uint8_t * data, size_t size, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= DecodeFrame
+=
+= Decodes the payload of a frame, appending tokens to tokens and symbols to symbolTable.
+=
+====================
+*/
+
+    const uint8_t *  position = data;
+    const uint8_t *  end = data + size;
+    uint64_t         encoding;
+    uint64_t         count;
+    uint64_t         symbol;
+    uint64_t         totals[ 3 ];
+    char *           terminator;
+
+    if ( type == TOKEN_FRAME ) {
+        if ( !ReadVarint( &position, end, &encoding ) || !ReadVarint( &position, end, &count )
+          || ( encoding != VARINT_ENCODING && encoding != RANS_ENCODING ) ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Token frame %" PRIu64 " could not be decoded.", reader->inputFilename, reader->frameCount );
+        }
+
+        if ( reader->tokenLimit > 0 && count > reader->tokenLimit - reader->tokenCount ) {
+            RaiseError( NULL, INPUT_TOO_LARGE_ERROR, "%s: Token frames hold more than the limit of %zu tokens.", reader->inputFilename, reader->tokenLimit );
+        }
+
+        if ( !DecodeBlocks( position, end - position, encoding, count, tokens ) ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Token frame %" PRIu64 " could not be decoded.", reader->inputFilename, reader->frameCount );
+        }
+
+        reader->tokenCount += count;
+        reader->frameCount++;
+    } else if ( type == SYMBOL_FRAME ) {
+        bool decoded = ReadVarint( &position, end, &count );
+
+        for ( uint64_t i = 0; decoded && i < count; i++ ) {
+            if ( !ReadVarint( &position, end, &symbol ) || ( terminator = memchr( position, '\0', end - position ) ) == NULL ) {
+                decoded = false;
+                break;
+            }
+
+            ImportSymbol( reader->inputFilename, 3, symbolTable, symbol, ( char * )position );
+            position = ( uint8_t * )terminator + 1;
+        }
+
+        if ( !decoded ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Symbol frame %" PRIu64 " could not be decoded.", reader->inputFilename, reader->frameCount );
+        }
+
+        reader->symbolCount += count;
+        reader->frameCount++;
+    } else if ( type == TRAILER_FRAME ) {
+        for ( int i = 0; i < 3; i++ ) {
+            if ( !ReadVarint( &position, end, &totals[ i ] ) ) {
+                totals[ i ] = UINT64_MAX;
+            }
+        }
+
+        if ( totals[ 0 ] != reader->tokenCount || totals[ 1 ] != reader->symbolCount || totals[ 2 ] != reader->frameCount ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Trailer does not match the frames read.", reader->inputFilename );
+        }
+    } else {
+        // Frames of unknown types are skipped, but still counted.
+        reader->frameCount++;
+    }
+}
+
+tokenStreamReader_t InitializeTokenStreamReader( char * inputFilename, FILE * file ) {
+/*
+====================
+=
+= InitializeTokenStreamReader
+=
+= Initializes the tokenStreamReader_t data structure and checks the signature of the %TOK-003 stream read from file.
+=
+====================
+*/
+
+    tokenStreamReader_t  reader;
+    char                 signature[ 8 ];
+
+    if ( fread( signature, 1, 8, file ) < 8 || memcmp( signature, "%TOK-003", 8 ) ) {
+        fprintf( stderr, "%s: Not a %%TOK-003 token stream.\n", inputFilename );
+        exit( 1 );
+    }
+
+    reader.inputFilename = inputFilename;
+    reader.file = file;
+    reader.payload = InitializeOutputBuffer( NULL );
+    reader.tokenCount = 0;
+    reader.symbolCount = 0;
+    reader.frameCount = 0;
+    reader.tokenLimit = 0;
+
+    return reader;
+}
+
+int ReadTokenFrame( tokenStreamReader_t * reader, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= ReadTokenFrame
+=
+= Reads the next frame of the stream, blocking until it is complete, and decodes it into tokens or symbolTable.
+=
+= Returns the type of the frame, TRAILER_FRAME at the end of the stream.
+=
+====================
+*/
+
+    int       type = fgetc( reader->file );
+    int       byte;
+    uint64_t  size = 0;
+
+    // Frame header
+    for ( int shift = 0; type != EOF; shift += 7 ) {
+        if ( ( byte = fgetc( reader->file ) ) == EOF || shift > 63 ) {
+            type = EOF;
+            break;
+        }
+
+        size |= ( uint64_t )( byte & 0x7F ) << shift;
+
+        if ( !( byte & 0x80 ) ) {
+            break;
+        }
+    }
+
+    reader->payload.size = 0;
+
+    if ( type == EOF || !ReserveOutputBuffer( &( reader->payload ), size ) || fread( reader->payload.data, 1, size, reader->file ) < size ) {
+        fprintf( stderr, "Malformed file \"%s\": Stream ends before its trailer.\n", reader->inputFilename );
+        exit( 1 );
+    }
+
+    DecodeFrame( reader, type, ( uint8_t * )reader->payload.data, size, tokens, symbolTable );
+
+    return type;
+}
+
+void DestroyTokenStreamReader( tokenStreamReader_t * reader ) {
+    DestroyOutputBuffer( &( reader->payload ) );
+}
+
+void ImportRevision3( char * inputFilename, const uint8_t * file, size_t length, size_t tokenLimit, tokenList_t * tokens, symbolTable_t * symbolTable ) {
+/*
+====================
+=
+= ImportRevision3
+=
+= Imports the tokens and symbols of a whole %TOK-003 file that is already in memory. Frames that would take the tokens
+= past tokenLimit, unless it is 0, raise an INPUT_TOO_LARGE_ERROR.
+=
+====================
+*/
+
+    tokenStreamReader_t  reader = { .inputFilename = inputFilename, .tokenLimit = tokenLimit };
+    const uint8_t *      position = file + 8;
+    const uint8_t *      end = file + length;
+    uint64_t             size;
+    int                  type;
+
+    do {
+        if ( position == end ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Stream ends before its trailer.", inputFilename );
+        }
+
+        type = *position++;
+
+        if ( !ReadVarint( &position, end, &size ) || size > ( uint64_t )( end - position ) ) {
+            RaiseError( NULL, MALFORMED_FILE_ERROR, "Malformed file \"%s\": Stream ends before its trailer.", inputFilename );
+        }
+
+        DecodeFrame( &reader, type, position, size, tokens, symbolTable );
+        position += size;
+    } while ( type != TRAILER_FRAME );
+}
\ No newline at end of file
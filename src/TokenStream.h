@@ -0,0 +1,45 @@
+#ifndef TOKENSTREAM_H
+#define TOKENSTREAM_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "OutputBuffer.h"
+#include "TokenFile.h"
+
+#define TOKEN_FRAME_SIZE ( 1 << 16 )
+
+enum frameType_t {
+    TOKEN_FRAME    = 1,
+    SYMBOL_FRAME   = 2,
+    TRAILER_FRAME  = 3
+};
+
+typedef struct {
+    outputBuffer_t  output;
+    chartStack_t *  lastSymbol;
+    bool            compress;
+    uint64_t        tokenCount;
+    uint64_t        symbolCount;
+    uint64_t        frameCount;
+} tokenStream_t;
+
+typedef struct {
+    char *          inputFilename;
+    FILE *          file;
+    outputBuffer_t  payload;
+    uint64_t        tokenCount;
+    uint64_t        symbolCount;
+    uint64_t        frameCount;
+    size_t          tokenLimit;     // Tokens the frames may decode, 0 for no limit
+} tokenStreamReader_t;
+
+tokenStream_t InitializeTokenStream( FILE * file, bool compress );
+void PushTokenFrame( tokenStream_t * stream, tokenList_t * tokens, symbolTable_t * symbolTable );
+void FinishTokenStream( tokenStream_t * stream, tokenList_t * tokens, symbolTable_t * symbolTable );
+tokenStreamReader_t InitializeTokenStreamReader( char * inputFilename, FILE * file );
+int ReadTokenFrame( tokenStreamReader_t * reader, tokenList_t * tokens, symbolTable_t * symbolTable );
+void DestroyTokenStreamReader( tokenStreamReader_t * reader );
+void ImportRevision3( char * inputFilename, const uint8_t * file, size_t length, size_t tokenLimit, tokenList_t * tokens, symbolTable_t * symbolTable );
+#endif
\ No newline at end of file
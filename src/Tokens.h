@@ -111,6 +111,7 @@ enum tokenHashes_t {
     WCHAR_UNDERSCORE_T_STRING_LITERAL_TOKEN         = 130, // L"string"
     UTF_16_STRING_LITERAL_TOKEN                     = 131, // u"string"
     UTF_32_STRING_LITERAL_TOKEN                     = 132, // U"string"
+    ERROR_TOKEN                                     = 133, // Bytes skipped by the recovery mode of the lexer
     HEADER_NAME_LESS_GREATER_TOKEN                  = 140, // #include <header.h>
     HEADER_NAME_QUOTES_TOKEN                        = 141, // #include "header.h"
     CHARACTER_CONSTANT_TOKEN                        = 151, // 'c'
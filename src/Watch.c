@@ -0,0 +1,627 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include "TokenList.h"
+#include "SymbolTable.h"
+#include "TokenFile.h"
+#include "Diagnostic.h"
+#include "Decompose.h"
+#include "Library.h"
+#include "TokenCache.h"
+#include "File.h"
+#include "Ring.h"
+#include "Batch.h"
+#include "Watch.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <signal.h>
+#include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#define WATCH_EVENTS ( IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO )
+
+typedef struct {
+    char *  input;
+    char *  output;
+} watchJob_t;
+
+typedef struct {
+    ring_t                jobs;
+    pthread_t             thread;
+    bool                  punchCardExtension;
+    bool                  recover;
+    tokenFileOptions_t *  options;
+    tokenCache_t *        cache;
+} watchWorker_t;
+
+typedef struct {
+    int              notify;
+    char *           root;
+    char *           outputDirectory;
+    char **          directories;        // Path of every watch descriptor, NULL once it is removed
+    int              directoryCapacity;
+    char **          changed;            // Set of the source files changed since the last dispatch, open addressing
+    size_t           changedCount;
+    size_t           changedCapacity;
+    watchWorker_t *  workers;
+    int              threads;
+} watcher_t;
+
+static volatile sig_atomic_t  stopWatching = 0;
+
+void StopWatching( int signalNumber ) {
+    ( void )signalNumber;
+    stopWatching = 1;
+}
+
+int64_t Milliseconds() {
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( int64_t )now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+bool IsSourceName( const char * name ) {
+    size_t length = strlen( name );
+
+    return length > 2 && name[ length - 2 ] == '.' && ( name[ length - 1 ] == 'c' || name[ length - 1 ] == 'h' );
+}
+
+char * JoinPath( const char * directory, const char * name, const char * extension ) {
+/*
+====================
+=
+= JoinPath
+=
+= Returns directory/name followed by extension, which must be freed by the caller.
+=
+====================
+*/
+
+    char * path = malloc( strlen( directory ) + strlen( name ) + strlen( extension ) + 2 );
+
+    if ( path == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    sprintf( path, "%s/%s%s", directory, name, extension );
+
+    return path;
+}
+
+void MarkChanged( watcher_t * watcher, const char * path ) {
+/*
+====================
+=
+= MarkChanged
+=
+= Adds a source file to the files to lex at the next dispatch, once however many times it changes before then.
+=
+====================
+*/
+
+    size_t  slot;
+    char ** changed;
+
+    if ( 2 * ( watcher->changedCount + 1 ) > watcher->changedCapacity ) {
+        size_t capacity = watcher->changedCapacity == 0 ? 256 : 2 * watcher->changedCapacity;
+
+        if ( ( changed = calloc( capacity, sizeof( char * ) ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+
+        for ( size_t i = 0; i < watcher->changedCapacity; i++ ) {
+            if ( watcher->changed[ i ] != NULL ) {
+                for ( slot = HashContent( watcher->changed[ i ], strlen( watcher->changed[ i ] ) ) % capacity; changed[ slot ] != NULL; slot = ( slot + 1 ) % capacity );
+
+                changed[ slot ] = watcher->changed[ i ];
+            }
+        }
+
+        free( watcher->changed );
+        watcher->changed = changed;
+        watcher->changedCapacity = capacity;
+    }
+
+    for ( slot = HashContent( path, strlen( path ) ) % watcher->changedCapacity; watcher->changed[ slot ] != NULL; slot = ( slot + 1 ) % watcher->changedCapacity ) {
+        if ( !strcmp( watcher->changed[ slot ], path ) ) {
+            return;
+        }
+    }
+
+    if ( ( watcher->changed[ slot ] = malloc( strlen( path ) + 1 ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    strcpy( watcher->changed[ slot ], path );
+    watcher->changedCount++;
+}
+
+void DispatchChanges( watcher_t * watcher ) {
+/*
+====================
+=
+= DispatchChanges
+=
+= Hands the changed files to the workers. A file always goes to the same worker, so that its versions are lexed in the
+= order they were seen and an older one never replaces the token file of a newer one.
+=
+====================
+*/
+
+    watchJob_t * job;
+
+    for ( size_t i = 0; i < watcher->changedCapacity; i++ ) {
+        if ( watcher->changed[ i ] == NULL ) {
+            continue;
+        }
+
+        if ( ( job = malloc( sizeof( watchJob_t ) ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+
+        job->input = watcher->changed[ i ];
+        job->output = JoinPath( watcher->outputDirectory, job->input + strlen( watcher->root ) + 1, ".tok" );
+
+        PushRing( &( watcher->workers[ HashContent( job->input, strlen( job->input ) ) % watcher->threads ].jobs ), job );
+
+        watcher->changed[ i ] = NULL;
+    }
+
+    watcher->changedCount = 0;
+}
+
+void WatchDirectory( watcher_t * watcher, char * directory ) {
+/*
+====================
+=
+= WatchDirectory
+=
+= Watches a directory and the ones under it, and marks every source file in them as changed. The watch is added before
+= the directory is read, so that a file created meanwhile is seen one way or the other.
+=
+====================
+*/
+
+    int              watch = inotify_add_watch( watcher->notify, directory, WATCH_EVENTS | IN_ONLYDIR );
+    DIR *            stream;
+    struct dirent *  entry;
+    struct stat      status;
+    char *           path;
+
+    // The directory may already be gone again.
+    if ( watch < 0 ) {
+        if ( errno == ENOSPC ) {
+            fprintf( stderr, "%s: Out of inotify watches, raise fs.inotify.max_user_watches.\n", directory );
+        }
+
+        return;
+    }
+
+    if ( watch >= watcher->directoryCapacity ) {
+        int capacity = watch < 2 * watcher->directoryCapacity ? 2 * watcher->directoryCapacity : watch + 64;
+
+        if ( ( watcher->directories = realloc( watcher->directories, capacity * sizeof( char * ) ) ) == NULL ) {
+            fputs( "Out of memory.\n", stderr );
+            exit( 1 );
+        }
+
+        memset( watcher->directories + watcher->directoryCapacity, 0, ( capacity - watcher->directoryCapacity ) * sizeof( char * ) );
+        watcher->directoryCapacity = capacity;
+    }
+
+    // A directory reached again through a symbolic link is already watched under its first name.
+    if ( watcher->directories[ watch ] != NULL && strcmp( watcher->directories[ watch ], directory ) ) {
+        return;
+    }
+
+    free( watcher->directories[ watch ] );
+
+    if ( ( watcher->directories[ watch ] = malloc( strlen( directory ) + 1 ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    strcpy( watcher->directories[ watch ], directory );
+
+    if ( ( stream = opendir( directory ) ) == NULL ) {
+        return;
+    }
+
+    while ( ( entry = readdir( stream ) ) != NULL ) {
+        if ( !strcmp( entry->d_name, "." ) || !strcmp( entry->d_name, ".." ) ) {
+            continue;
+        }
+
+        path = JoinPath( directory, entry->d_name, "" );
+
+        if ( stat( path, &status ) == 0 ) {
+            if ( S_ISDIR( status.st_mode ) ) {
+                WatchDirectory( watcher, path );
+            } else if ( IsSourceName( entry->d_name ) ) {
+                MarkChanged( watcher, path );
+            }
+        }
+
+        free( path );
+    }
+
+    closedir( stream );
+}
+
+void ForgetDirectory( watcher_t * watcher, const char * directory ) {
+/*
+====================
+=
+= ForgetDirectory
+=
+= Stops watching a directory that was moved away or removed, and the ones under it. A directory moved within the tree
+= is watched again under its new name by the event of its arrival.
+=
+====================
+*/
+
+    size_t length = strlen( directory );
+
+    for ( int i = 0; i < watcher->directoryCapacity; i++ ) {
+        char * path = watcher->directories[ i ];
+
+        if ( path != NULL && !strncmp( path, directory, length ) && ( path[ length ] == '\0' || path[ length ] == '/' ) ) {
+            inotify_rm_watch( watcher->notify, i );
+            free( path );
+            watcher->directories[ i ] = NULL;
+        }
+    }
+}
+
+void HandleEvent( watcher_t * watcher, struct inotify_event * event ) {
+/*
+====================
+=
+= HandleEvent
+=
+= Follows an event of the tree: directories that appear are watched, those that leave are forgotten, and source files
+= that are written, created, renamed or removed are marked as changed. Whether a changed file is still there is only
+= looked at when it is lexed.
+=
+====================
+*/
+
+    char * path;
+
+    // Events were lost, the whole tree is looked at again.
+    if ( event->mask & IN_Q_OVERFLOW ) {
+        WatchDirectory( watcher, watcher->root );
+        return;
+    }
+
+    if ( event->wd < 0 || event->wd >= watcher->directoryCapacity || watcher->directories[ event->wd ] == NULL ) {
+        return;
+    }
+
+    if ( event->mask & IN_IGNORED ) {
+        free( watcher->directories[ event->wd ] );
+        watcher->directories[ event->wd ] = NULL;
+        return;
+    }
+
+    if ( event->len == 0 ) {
+        return;
+    }
+
+    path = JoinPath( watcher->directories[ event->wd ], event->name, "" );
+
+    if ( event->mask & IN_ISDIR ) {
+        if ( event->mask & ( IN_CREATE | IN_MOVED_TO ) ) {
+            WatchDirectory( watcher, path );
+        } else if ( event->mask & IN_MOVED_FROM ) {
+            ForgetDirectory( watcher, path );
+        }
+    } else if ( IsSourceName( event->name ) ) {
+        MarkChanged( watcher, path );
+    }
+
+    free( path );
+}
+
+bool ReplaceTokenFile( char * temporary, char * output ) {
+/*
+====================
+=
+= ReplaceTokenFile
+=
+= Renames a token file written under a temporary name over the one it replaces. On failure the error is printed and
+= the temporary file removed, the old token file is left as it was. Returns whether it was replaced.
+=
+====================
+*/
+
+    if ( rename( temporary, output ) != 0 ) {
+        perror( output );
+        remove( temporary );
+        return false;
+    }
+
+    return true;
+}
+
+void UpdateTokenFile( watchWorker_t * worker, watchJob_t * job, lexerContext_t * context, diagnosticList_t * diagnostics ) {
+/*
+====================
+=
+= UpdateTokenFile
+=
+= Brings the token file of a changed source file up to date. It is written under a temporary name and renamed over the
+= old one, so that a reader sees either version whole. A source file that is gone, or that can no longer be lexed to
+= the end, loses its token file rather than keeping the one of an older version. A token file that can't be written
+= is reported and skipped.
+=
+====================
+*/
+
+    size_t         length;
+    char *         source = TryReadBinaryFile( job->input, &length );
+    char           key[ TOKEN_CACHE_KEY_SIZE ];
+    char *         temporary;
+    lexerStatus_t  status;
+    errorTrap_t    trap;
+
+    if ( source == NULL ) {
+        remove( job->output );
+        return;
+    }
+
+    if ( ( temporary = malloc( strlen( job->output ) + 32 ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    sprintf( temporary, "%s.%ld.tmp", job->output, ( long )getpid() );
+
+    MakeParentDirectories( job->output );
+
+    if ( worker->cache != NULL ) {
+        TokenCacheKey( source, length, worker->punchCardExtension, worker->recover, worker->options, key );
+
+        if ( FetchTokenEntry( worker->cache, key, temporary ) ) {
+            ReplaceTokenFile( temporary, job->output );
+            free( temporary );
+            free( source );
+            return;
+        }
+    }
+
+    status = LexBuffer( context, source, length, worker->punchCardExtension, worker->recover, diagnostics );
+
+    if ( status != LEXER_SUCCESS ) {
+        PrintDiagnostics( stderr, job->input, diagnostics );
+    }
+
+    if ( status == LEXER_ERROR ) {
+        remove( job->output );
+    } else {
+        // A token file that can't be written is skipped like a lex error, the watch goes on.
+        SetErrorTrap( &trap, NULL, 0, false, diagnostics );
+
+        if ( setjmp( trap.jump ) != 0 ) {
+            PrintDiagnostics( stderr, job->input, diagnostics );
+            remove( temporary );
+            free( temporary );
+            free( source );
+            return;
+        }
+
+        ExportTokenFile( temporary, &( context->tokens ), &( context->symbolTable ), worker->options );
+        ClearErrorTrap( &trap );
+
+        // Files with errors are left out of the cache, so that their diagnostics are printed again the next time.
+        if ( ReplaceTokenFile( temporary, job->output ) && worker->cache != NULL && status == LEXER_SUCCESS ) {
+            PublishTokenFile( worker->cache, key, job->output );
+        }
+    }
+
+    free( temporary );
+    free( source );
+}
+
+void * WatchWorker( void * argument ) {
+/*
+====================
+=
+= WatchWorker
+=
+= Updates the token files of the changed files pushed to a worker until it pops a NULL.
+=
+====================
+*/
+
+    watchWorker_t *   worker = argument;
+    watchJob_t *      job;
+    lexerContext_t    context = InitializeLexerContext();
+    diagnosticList_t  diagnostics = InitializeDiagnosticList();
+
+    while ( ( job = PopRing( &( worker->jobs ) ) ) != NULL ) {
+        UpdateTokenFile( worker, job, &context, &diagnostics );
+
+        free( job->input );
+        free( job->output );
+        free( job );
+    }
+
+    DestroyDiagnosticList( diagnostics );
+    DestroyLexerContext( &context );
+
+    return NULL;
+}
+
+void WatchBatch( char * input, char * outputDirectory, int threads, bool punchCardExtension, bool recover, tokenFileOptions_t * options, tokenCache_t * cache ) {
+/*
+====================
+=
+= WatchBatch
+=
+= Decomposes every .c and .h file under the input directory into a token file under outputDirectory, like a batch, and
+= then keeps the token files up to date as the files change, until the program is interrupted.
+=
+= Changes are followed with inotify, nothing is polled. They are gathered until none came for WATCH_DEBOUNCE_MS, or
+= for at most WATCH_DEBOUNCE_LIMIT_MS, and the files that changed are lexed once each on threads workers that keep
+= their lexer contexts. With a cache, which may be NULL, the files are looked up in it and added to it as in a batch.
+=
+= Lexical errors never stop the watch: they are printed and the file is skipped, or recovered from with recover set.
+=
+====================
+*/
+
+    watcher_t           watcher = { 0 };
+    tokenFileOptions_t  fileOptions = *options;
+    struct sigaction    action = { 0 };
+    struct pollfd       events;
+    struct stat         status;
+    int64_t             firstChange = 0;
+    int64_t             lastChange = 0;
+    int                 timeout;
+    ssize_t             length;
+    _Alignas( struct inotify_event ) char buffer[ 64 << 10 ];
+
+    if ( stat( input, &status ) == -1 || !S_ISDIR( status.st_mode ) ) {
+        fprintf( stderr, "%s: Only directories can be watched.\n", input );
+        exit( 1 );
+    }
+
+    if ( ( watcher.notify = inotify_init1( IN_CLOEXEC ) ) < 0 ) {
+        perror( "inotify" );
+        exit( 1 );
+    }
+
+    // The files themselves are the unit of work, each is exported on a single thread.
+    fileOptions.threads = 1;
+
+    watcher.root = input;
+    watcher.outputDirectory = outputDirectory;
+    watcher.threads = threads < 1 ? 1 : threads;
+
+    if ( ( watcher.workers = malloc( watcher.threads * sizeof( watchWorker_t ) ) ) == NULL ) {
+        fputs( "Out of memory.\n", stderr );
+        exit( 1 );
+    }
+
+    for ( int i = 0; i < watcher.threads; i++ ) {
+        watchWorker_t * worker = &( watcher.workers[ i ] );
+
+        InitializeRing( &( worker->jobs ), WATCH_QUEUE_SIZE );
+        worker->punchCardExtension = punchCardExtension;
+        worker->recover = recover;
+        worker->options = &fileOptions;
+        worker->cache = cache;
+
+        if ( pthread_create( &( worker->thread ), NULL, WatchWorker, worker ) != 0 ) {
+            fputs( "Could not start a thread.\n", stderr );
+            exit( 1 );
+        }
+    }
+
+    // Interrupting the watch finishes the files already seen before leaving.
+    action.sa_handler = StopWatching;
+    sigaction( SIGINT, &action, NULL );
+    sigaction( SIGTERM, &action, NULL );
+
+    WatchDirectory( &watcher, input );
+    DispatchChanges( &watcher );
+
+    events.fd = watcher.notify;
+    events.events = POLLIN;
+
+    while ( !stopWatching ) {
+        timeout = -1;
+
+        if ( watcher.changedCount == 0 ) {
+            firstChange = 0;
+        } else {
+            int64_t deadline = lastChange + WATCH_DEBOUNCE_MS < firstChange + WATCH_DEBOUNCE_LIMIT_MS ? lastChange + WATCH_DEBOUNCE_MS : firstChange + WATCH_DEBOUNCE_LIMIT_MS;
+
+            timeout = deadline > Milliseconds() ? deadline - Milliseconds() : 0;
+        }
+
+        if ( poll( &events, 1, timeout ) < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+
+            perror( "poll" );
+            break;
+        }
+
+        if ( !( events.revents & POLLIN ) ) {
+            DispatchChanges( &watcher );
+            continue;
+        }
+
+        if ( ( length = read( watcher.notify, buffer, sizeof( buffer ) ) ) < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+
+            perror( "inotify" );
+            break;
+        }
+
+        for ( char * position = buffer; position < buffer + length; ) {
+            struct inotify_event * event = ( struct inotify_event * )position;
+
+            HandleEvent( &watcher, event );
+            position += sizeof( struct inotify_event ) + event->len;
+        }
+
+        if ( watcher.changedCount > 0 ) {
+            lastChange = Milliseconds();
+
+            if ( firstChange == 0 ) {
+                firstChange = lastChange;
+            }
+        }
+
+        // Changes that keep coming past the limit are dispatched with the ones that waited.
+        if ( watcher.changedCount > 0 && lastChange - firstChange >= WATCH_DEBOUNCE_LIMIT_MS ) {
+            DispatchChanges( &watcher );
+        }
+    }
+
+    DispatchChanges( &watcher );
+
+    for ( int i = 0; i < watcher.threads; i++ ) {
+        PushRing( &( watcher.workers[ i ].jobs ), NULL );
+    }
+
+    for ( int i = 0; i < watcher.threads; i++ ) {
+        pthread_join( watcher.workers[ i ].thread, NULL );
+        DestroyRing( &( watcher.workers[ i ].jobs ) );
+    }
+
+    for ( int i = 0; i < watcher.directoryCapacity; i++ ) {
+        free( watcher.directories[ i ] );
+    }
+
+    close( watcher.notify );
+    free( watcher.directories );
+    free( watcher.changed );
+    free( watcher.workers );
+}
+#else
+void WatchBatch( char * input, char * outputDirectory, int threads, bool punchCardExtension, bool recover, tokenFileOptions_t * options, tokenCache_t * cache ) {
+    fputs( "Watching needs inotify, which this platform does not have.\n", stderr );
+    exit( 1 );
+}
+#endif
\ No newline at end of file
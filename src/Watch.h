@@ -0,0 +1,23 @@
+#ifndef WATCH_H
+#define WATCH_H
+#include <stdbool.h>
+#include "TokenFile.h"
+#include "TokenCache.h"
+
+// Milliseconds without a change before the changed files are lexed, so that a burst of writes is lexed once.
+#ifndef WATCH_DEBOUNCE_MS
+#define WATCH_DEBOUNCE_MS 10
+#endif
+
+// Milliseconds a changed file may wait while changes keep coming, so that a long burst doesn't hold it back forever.
+#ifndef WATCH_DEBOUNCE_LIMIT_MS
+#define WATCH_DEBOUNCE_LIMIT_MS 200
+#endif
+
+// Files queued to a watch worker at once, the watcher waits for room past this.
+#ifndef WATCH_QUEUE_SIZE
+#define WATCH_QUEUE_SIZE 256
+#endif
+
+void WatchBatch( char * input, char * outputDirectory, int threads, bool punchCardExtension, bool recover, tokenFileOptions_t * options, tokenCache_t * cache );
+#endif
\ No newline at end of file
@@ -2,9 +2,16 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <inttypes.h>
 #include "TokenList.h"
 #include "SymbolTable.h"
 #include "Decompose.h"
+#include "Checkpoint.h"
+#include "TokenArchive.h"
+#include "Batch.h"
+#include "TokenCache.h"
+#include "Server.h"
+#include "Watch.h"
 #include "Recompose/Recompose.h"
 
 typedef struct {
@@ -13,27 +20,83 @@ typedef struct {
     char *  output;
     int     mode;
     bool    yolo;
+    char ** inputs;
+    int     inputCount;
+    char *  member;
+    char *  symbol;
+    int     threads;
+    bool    pipeline;
+    bool    recover;
+    char *  cacheDirectory;
+    size_t  cacheLimit;
+    char *  server;
+    size_t  firstSourceLine;    // Lines of the source file to decompose, 0 for all of them
+    size_t  lastSourceLine;
+
+    tokenFileOptions_t  fileOptions;
 } options_t;
 
 enum mode_t {
     DECOMPOSE,
     RECOMPOSE,
-    ROUNDTRIP
+    ROUNDTRIP,
+    ARCHIVE,
+    EXTRACT,
+    LIST,
+    FIND,
+    BATCH,
+    SERVE,
+    STOP,
+    WATCH
 };
 
+void ParseLineRange( char * option, char * range, size_t * first, size_t * last ) {
+/*
+====================
+=
+= ParseLineRange
+=
+= Reads a line range given as "first:last", or "line" for a single line, into first and last. Exits on a malformed one.
+=
+====================
+*/
+
+    char * separator = NULL;
+
+    if ( range != NULL ) {
+        *first = strtoul( range, &separator, 10 );
+        *last = *separator == ':' ? strtoul( separator + 1, NULL, 10 ) : *first;
+    }
+
+    if ( separator == NULL || *first == 0 || *last < *first ) {
+        fprintf( stderr, "Line ranges of %s are given as \"first:last\", starting at line 1.\n", option );
+        exit( 1 );
+    }
+}
+
 int main( int argc, char *argv[] ) {
-    options_t  options = { .punchCardExtention = false, .output = "a.tok", .mode = DECOMPOSE, .yolo = false };
+    options_t       options = { .punchCardExtention = false, .output = NULL, .mode = DECOMPOSE, .yolo = false, .cacheLimit = TOKEN_CACHE_SIZE, .fileOptions = { .revision = 2, .compress = false } };
+    bool            clean = true;
+    tokenCache_t    cache;
+    tokenCache_t *  tokenCache = NULL;
 
     // Option gathering
     if ( argc >= 2 ) {
         options.input = argv[ 1 ];
+        options.inputs = argv + 1;
+        options.inputCount = 1;
     } else {
         fputs( "Please enter a filename or file path as the first argument.\n", stderr );
         fprintf( stderr, "%s\n", argv[ 0 ] );
         for ( unsigned int i = 0; i < strlen( argv[ 0 ] ) - 4; i++ ) {
             fputc( ' ', stderr );
         }
-        fputs( "here ^", stderr );
+        fputs( "here ^\n", stderr );
+        fputs( "\n"
+               "Line ranges count two different kinds of lines:\n"
+               "  -sourcelines A:B  decomposes lines A to B of the C source file, as it is on disk.\n"
+               "  -r -lines A:B     recomposes lines A to B of the recomposed output, where a comment is a single space\n"
+               "                    and a line continuation is gone, so they may not be the lines of the source file.\n", stderr );
         exit( 1 );
     }
     
@@ -51,35 +114,232 @@ int main( int argc, char *argv[] ) {
             options.mode = ROUNDTRIP;
         } else if ( !strcmp( argv[ i ], "-yolo" ) ) {
             options.yolo = true;
+        } else if ( !strcmp( argv[ i ], "-compress" ) ) {
+            options.fileOptions.compress = true;
+        } else if ( !strcmp( argv[ i ], "-rev" ) ) {
+            if ( i + 1 < argc ) {
+                options.fileOptions.revision = strtol( argv[ i + 1 ], NULL, 10 );
+                i++;
+            }
+
+            if ( options.fileOptions.revision < 1 || options.fileOptions.revision > TOKEN_FILE_REVISION ) {
+                fprintf( stderr, "Unsupported file revision \"%d\", supported revisions are 1 through %d.\n", options.fileOptions.revision, TOKEN_FILE_REVISION );
+                exit( 1 );
+            }
+        } else if ( !strcmp( argv[ i ], "-index" ) ) {
+            if ( i + 1 < argc ) {
+                options.fileOptions.indexInterval = strtoul( argv[ i + 1 ], NULL, 10 );
+                i++;
+            }
+        } else if ( !strcmp( argv[ i ], "-lines" ) ) {
+            // Lines of the recomposed output.
+            ParseLineRange( "-lines", i + 1 < argc ? argv[ ++i ] : NULL, &options.fileOptions.firstLine, &options.fileOptions.lastLine );
+        } else if ( !strcmp( argv[ i ], "-sourcelines" ) ) {
+            // Lines of the source file, which differ from the recomposed ones once a comment spans lines.
+            ParseLineRange( "-sourcelines", i + 1 < argc ? argv[ ++i ] : NULL, &options.firstSourceLine, &options.lastSourceLine );
+        } else if ( !strcmp( argv[ i ], "-archive" ) ) {
+            options.mode = ARCHIVE;
+        } else if ( !strcmp( argv[ i ], "-x" ) ) {
+            options.mode = EXTRACT;
+
+            if ( i + 1 < argc ) {
+                options.member = argv[ i + 1 ];
+                i++;
+            } else {
+                fputs( "-x needs the name of a file in the archive.\n", stderr );
+                exit( 1 );
+            }
+        } else if ( !strcmp( argv[ i ], "-batch" ) ) {
+            options.mode = BATCH;
+        } else if ( !strcmp( argv[ i ], "-pipeline" ) ) {
+            options.mode = BATCH;
+            options.pipeline = true;
+        } else if ( !strcmp( argv[ i ], "-j" ) ) {
+            if ( i + 1 < argc ) {
+                options.threads = strtol( argv[ i + 1 ], NULL, 10 );
+                i++;
+            }
+        } else if ( !strcmp( argv[ i ], "-recover" ) ) {
+            options.recover = true;
+        } else if ( !strcmp( argv[ i ], "-nocheck" ) ) {
+            options.fileOptions.skipChecksums = true;
+        } else if ( !strcmp( argv[ i ], "-sort" ) ) {
+            options.fileOptions.sortSymbols = true;
+        } else if ( !strcmp( argv[ i ], "-find" ) ) {
+            options.mode = FIND;
+
+            if ( i + 1 < argc ) {
+                options.symbol = argv[ i + 1 ];
+                i++;
+            } else {
+                fputs( "-find needs the name of an identifier.\n", stderr );
+                exit( 1 );
+            }
+        } else if ( !strcmp( argv[ i ], "-cache" ) ) {
+            if ( i + 1 < argc ) {
+                options.cacheDirectory = argv[ i + 1 ];
+                i++;
+            } else {
+                fputs( "-cache needs the directory of the token cache.\n", stderr );
+                exit( 1 );
+            }
+        } else if ( !strcmp( argv[ i ], "-cachesize" ) ) {
+            // Megabytes, 0 for no limit.
+            if ( i + 1 < argc ) {
+                options.cacheLimit = ( size_t )strtoull( argv[ i + 1 ], NULL, 10 ) << 20;
+                i++;
+            }
+        } else if ( !strcmp( argv[ i ], "-watch" ) ) {
+            options.mode = WATCH;
+        } else if ( !strcmp( argv[ i ], "-serve" ) ) {
+            options.mode = SERVE;
+        } else if ( !strcmp( argv[ i ], "-client" ) ) {
+            if ( i + 1 < argc ) {
+                options.server = argv[ i + 1 ];
+                i++;
+            } else {
+                fputs( "-client needs the socket of the lexer server.\n", stderr );
+                exit( 1 );
+            }
+        } else if ( !strcmp( argv[ i ], "-stop" ) ) {
+            options.mode = STOP;
+        } else if ( !strcmp( argv[ i ], "-list" ) ) {
+            options.mode = LIST;
+        // Extra inputs, for archives. They are kept next to each other at the start of argv.
+        } else if ( argv[ i ][ 0 ] != '-' ) {
+            argv[ 1 + options.inputCount++ ] = argv[ i ];
         // More options may be added here if needed.
         } else {
             fprintf( stderr, "Warning: unrecognized argument ignored: \"%s\".", argv[ i ] );
         }
     }
 
-    if ( options.mode == DECOMPOSE ) {
+    // Batches go to a directory, everything else to a file.
+    if ( options.output == NULL ) {
+        options.output = options.mode == BATCH || options.mode == WATCH ? "tokens" : "a.tok";
+    }
+
+    if ( options.threads <= 0 ) {
+        options.threads = ThreadCount();
+    }
+
+    options.fileOptions.threads = options.threads;
+
+    // -lines counts the lines of recomposed output, there is none when decomposing.
+    if ( options.fileOptions.firstLine > 0 && options.mode != RECOMPOSE ) {
+        fputs( "-lines selects lines of the recomposed output, use -sourcelines for lines of a source file.\n", stderr );
+        exit( 1 );
+    }
+
+    if ( options.mode != ARCHIVE ) {
+        for ( int i = 1; i < options.inputCount; i++ ) {
+            fprintf( stderr, "Warning: unrecognized argument ignored: \"%s\".", options.inputs[ i ] );
+        }
+    }
+
+    if ( options.cacheDirectory != NULL ) {
+        cache = OpenTokenCache( options.cacheDirectory, options.cacheLimit );
+        tokenCache = &cache;
+    }
+
+    // The lexing is done by a running server, the request carries every option that changes the output.
+    if ( options.server != NULL && ( options.mode == DECOMPOSE || options.mode == RECOMPOSE ) ) {
+        requestHeader_t request = { .type = options.mode == DECOMPOSE ? LEX_REQUEST : RECOMPOSE_REQUEST, .revision = options.fileOptions.revision };
+
+        request.flags = ( options.punchCardExtention ? PUNCH_CARD_FLAG : 0 ) | ( options.recover ? RECOVER_FLAG : 0 )
+                      | ( options.fileOptions.compress ? COMPRESS_FLAG : 0 ) | ( options.fileOptions.sortSymbols ? SORT_FLAG : 0 );
+
+        clean = RequestServer( options.server, &request, options.input, options.output ) == LEXER_SUCCESS;
+    } else if ( options.mode == SERVE ) {
+        ServeLexer( options.input, options.threads, options.cacheLimit );
+    } else if ( options.mode == STOP ) {
+        requestHeader_t request = { .type = SHUTDOWN_REQUEST };
+
+        RequestServer( options.input, &request, NULL, NULL );
+    } else if ( options.mode == DECOMPOSE ) {
         tokenList_t    tokens;
         symbolTable_t  symbolTable;
+        char           key[ TOKEN_CACHE_KEY_SIZE ];
+        // Token files written to stdout are left out of the cache, they can't be read back to publish them.
+        bool           cacheable = tokenCache != NULL && options.firstSourceLine == 0 && strcmp( options.output, "-" );
         
-        Decompose( options.input, options.punchCardExtention, &tokens, &symbolTable );
-        ExportTokenFile( options.output, &tokens, &symbolTable );
+        // A file that was decomposed before with the same options is copied from the cache, the source is only hashed.
+        if ( cacheable && FetchTokenFile( tokenCache, options.input, options.output, options.punchCardExtention, options.recover, &options.fileOptions, key ) ) {
+            cacheable = false;
+        // Streams are written as the file is decomposed, unless errors are recovered from or only some lines are.
+        } else if ( options.fileOptions.revision == 3 && !options.recover && options.firstSourceLine == 0 ) {
+            DecomposeToStream( options.input, options.output, options.punchCardExtention, &options.fileOptions );
+        } else {
+            if ( options.firstSourceLine > 0 ) {
+                DecomposeLines( options.input, options.punchCardExtention, options.firstSourceLine, options.lastSourceLine, tokenCache, &tokens, &symbolTable );
+            } else if ( options.recover ) {
+                clean = DecomposeRecovering( options.input, options.punchCardExtention, &tokens, &symbolTable );
+            } else {
+                DecomposeParallel( options.input, options.punchCardExtention, options.threads, &tokens, &symbolTable );
+            }
 
-        DestroySymbolTable( symbolTable );
-        DestroyTokenList( tokens );
+            ExportTokenFile( options.output, &tokens, &symbolTable, &options.fileOptions );
+
+            DestroySymbolTable( symbolTable );
+            DestroyTokenList( tokens );
+        }
+
+        // Files with errors are left out of the cache, so that their diagnostics are printed again the next time.
+        if ( cacheable && clean ) {
+            PublishTokenFile( tokenCache, key, options.output );
+        }
     } else if ( options.mode == RECOMPOSE ) {
-        RecomposeFromFile( options.input, options.output, options.yolo );
+        // Streams coming from a pipe can't be read whole first.
+        if ( !strcmp( options.input, "-" ) ) {
+            RecomposeStream( options.input, options.output );
+        } else {
+            RecomposeFromFile( options.input, options.output, options.yolo, options.threads, &options.fileOptions );
+        }
+    } else if ( options.mode == BATCH ) {
+        clean = DecomposeBatch( options.input, options.output, options.threads, options.pipeline, options.punchCardExtention, options.recover, &options.fileOptions, tokenCache ) == 0;
+    } else if ( options.mode == WATCH ) {
+        WatchBatch( options.input, options.output, options.threads, options.punchCardExtention, options.recover, &options.fileOptions, tokenCache );
+    } else if ( options.mode == ARCHIVE ) {
+        ExportTokenArchive( options.output, options.inputs, options.inputCount, options.threads, options.punchCardExtention, &options.fileOptions );
+    } else if ( options.mode == EXTRACT ) {
+        RecomposeFromArchive( options.input, options.member, options.output, &options.fileOptions );
+    } else if ( options.mode == LIST ) {
+        tokenArchive_t   archive = OpenTokenArchive( options.input, !options.fileOptions.skipChecksums );
+        archiveMember_t  member;
+        const uint8_t *  position = archive.directory;
+
+        while ( ReadArchiveMember( &archive, &position, &member ) ) {
+            printf( "%.*s\t%" PRIu64 " tokens\t%" PRIu64 " symbols\t%" PRIu64 " bytes\n", ( int )member.nameLength, member.name, member.tokenCount, member.symbolCount, member.tokenSize + member.symbolSize );
+        }
+
+        CloseTokenArchive( &archive );
+    } else if ( options.mode == FIND ) {
+        token_t hash;
+
+        if ( !FindTokenFileSymbol( options.input, options.symbol, &hash ) ) {
+            printf( "%s: not used\n", options.symbol );
+            return 1;
+        }
+
+        printf( "%s: %" PRIu32 "\n", options.symbol, hash );
     } else if ( options.mode == ROUNDTRIP ) {
         tokenList_t    tokens;
         symbolTable_t  symbolTable;
         
         // Decompose
-        Decompose( options.input, options.punchCardExtention, &tokens, &symbolTable );
+        if ( options.firstSourceLine > 0 ) {
+            DecomposeLines( options.input, options.punchCardExtention, options.firstSourceLine, options.lastSourceLine, tokenCache, &tokens, &symbolTable );
+        } else if ( options.recover ) {
+            clean = DecomposeRecovering( options.input, options.punchCardExtention, &tokens, &symbolTable );
+        } else {
+            DecomposeParallel( options.input, options.punchCardExtention, options.threads, &tokens, &symbolTable );
+        }
 
         // Turn symbol chart into symbol meaning.
+        chartCursor_t chart = InitializeChartCursor( symbolTable.chart );
         token_t hash;
-        while ( ReadChart( symbolTable.chart, &hash ) ) {
-            tokenMeaning[ hash ] = malloc( strlen( symbolTable.table[ hash ] ) + 1 );
-            strcpy( tokenMeaning[ hash ], symbolTable.table[ hash ] );
+        while ( ReadChart( &chart, 1, &hash ) ) {
+            SetTokenMeaning( hash, symbolTable.table[ hash ], strlen( symbolTable.table[ hash ] ) );
         }
 
         // Symbol table is no longer needed after turning it into symbolMeaning.
@@ -94,5 +354,10 @@ int main( int argc, char *argv[] ) {
         DestroyTokenMeaning();
     }
 
-    return 0;
+    if ( tokenCache != NULL ) {
+        CloseTokenCache( tokenCache );
+    }
+
+    // Errors that were recovered from still make for a failure.
+    return clean ? 0 : 1;
 }
\ No newline at end of file